@@ -66,6 +66,7 @@ namespace gbe
       gen7_insn->header.predicate_inverse = this->curr.inversePredicate;
     }
     gen7_insn->header.saturate = this->curr.saturate;
+    gen7_insn->header.dependency_control = this->curr.noDDClr | (this->curr.noDDChk << 1);
   }
 
   void Gen75Encoder::setDPUntypedRW(GenNativeInstruction *insn,
@@ -61,6 +61,7 @@ namespace gbe
       gen8_insn->header.predicate_inverse = this->curr.inversePredicate;
     }
     gen8_insn->header.saturate = this->curr.saturate;
+    gen8_insn->header.dependency_control = this->curr.noDDClr | (this->curr.noDDChk << 1);
   }
 
   void Gen8Encoder::setDPUntypedRW(GenNativeInstruction *insn,
@@ -98,6 +98,112 @@ namespace gbe
 #define SET_GENINSN_DBGINFO(I) \
   if(OCL_DEBUGINFO) p->DBGInfo = I.DBGInfo;
       
+  /*! Byte mask of the (at most two) registers written by a selection
+   *  instruction. Only simple ALU instructions that the encoder emits as a
+   *  single native instruction are considered
+   */
+  static bool getDstFootprint(const SelectionInstruction &insn, GenRegAllocator &ra,
+                              uint32_t &grf, uint64_t &mask) {
+    switch (insn.opcode) {
+      case SEL_OP_MOV: case SEL_OP_NOT:
+      case SEL_OP_AND: case SEL_OP_OR: case SEL_OP_XOR:
+        if (insn.extra.function != 0) // conditional modifier
+          return false;
+        break;
+      case SEL_OP_ADD: case SEL_OP_SHL: case SEL_OP_SHR: case SEL_OP_ASR:
+        break;
+      default:
+        return false;
+    }
+    const uint32_t execWidth = insn.state.execWidth;
+    if (insn.dstNum != 1 || execWidth > 8 ||
+        insn.state.predicate != GEN_PREDICATE_NONE)
+      return false;
+    const GenRegister dst = ra.genReg(insn.dst(0));
+    if (dst.file != GEN_GENERAL_REGISTER_FILE ||
+        dst.address_mode != GEN_ADDRESS_DIRECT)
+      return false;
+    for (uint32_t srcID = 0; srcID < insn.srcNum; ++srcID)
+      if (typeSize(insn.src(srcID).type) > 4)
+        return false;
+    const uint32_t elemSize = typeSize(dst.type);
+    uint32_t stride;
+    switch (dst.hstride) {
+      case GEN_HORIZONTAL_STRIDE_0: stride = 0; break;
+      case GEN_HORIZONTAL_STRIDE_1: stride = 1; break;
+      case GEN_HORIZONTAL_STRIDE_2: stride = 2; break;
+      case GEN_HORIZONTAL_STRIDE_4: stride = 4; break;
+      default: return false;
+    }
+    if (elemSize > 4 || (stride == 0 && execWidth != 1))
+      return false;
+    grf = dst.nr;
+    mask = 0;
+    for (uint32_t i = 0; i < execWidth; ++i) {
+      const uint32_t offset = dst.subnr + i * stride * elemSize;
+      if (offset + elemSize > 2 * GEN_REG_SIZE)
+        return false;
+      mask |= ((1ull << elemSize) - 1) << offset;
+    }
+    // Writing a whole register does not need the hints
+    return mask != ~0ull && mask != 0xffffffffull && mask != 0xffffffff00000000ull;
+  }
+
+  /*! Conservatively check if the instruction may read one of the two registers
+   *  starting at grf. Sources never span more than two registers here */
+  static bool mayReadGRF(const SelectionInstruction &insn, GenRegAllocator &ra, uint32_t grf) {
+    for (uint32_t srcID = 0; srcID < insn.srcNum; ++srcID) {
+      const GenRegister src = ra.genReg(insn.src(srcID));
+      if (src.file != GEN_GENERAL_REGISTER_FILE)
+        continue;
+      if (src.address_mode != GEN_ADDRESS_DIRECT)
+        return true;
+      if ((uint32_t)src.nr + 1 >= grf && (uint32_t)src.nr <= grf + 1)
+        return true;
+    }
+    return false;
+  }
+
+  // Consecutive instructions writing disjoint parts of the same register
+  // (scalar header setups, strided packing...) wait for each other on the
+  // destination scoreboard. The first one of such a chain does not clear
+  // the dependency, the following ones do not check it and the last one
+  // clears it. An instruction reading the register breaks the chain.
+  void GenContext::setDependencyControl(void) {
+    vector<SelectionInstruction*> chain;
+    uint32_t chainGRF = 0;
+    uint64_t chainMask = 0;
+    auto flushChain = [&chain](void) {
+      if (chain.size() > 1) {
+        for (uint32_t i = 0; i < chain.size(); ++i) {
+          chain[i]->state.noDDClr = i != chain.size() - 1;
+          chain[i]->state.noDDChk = i != 0;
+        }
+      }
+      chain.clear();
+    };
+    for (auto &block : *sel->blockList) {
+      for (auto &insn : block.insnList) {
+        uint32_t grf;
+        uint64_t mask;
+        const bool partialWrite = getDstFootprint(insn, *ra, grf, mask);
+        if (!chain.empty() && partialWrite && grf == chainGRF &&
+            (mask & chainMask) == 0 && !mayReadGRF(insn, *ra, chainGRF)) {
+          chain.push_back(&insn);
+          chainMask |= mask;
+          continue;
+        }
+        flushChain();
+        if (partialWrite) {
+          chain.push_back(&insn);
+          chainGRF = grf;
+          chainMask = mask;
+        }
+      }
+      flushChain();
+    }
+  }
+
   void GenContext::emitInstructionStream(void) {
     // Emit Gen ISA
     for (auto &block : *sel->blockList)
@@ -3648,6 +3754,7 @@ namespace gbe
   BVAR(OCL_OUTPUT_SEL_IR, false);
   BVAR(OCL_OPTIMIZE_SEL_IR, true);
   BVAR(OCL_OPTIMIZE_IF_BLOCK, true);
+  BVAR(OCL_DEPENDENCY_CONTROL, false);
   bool GenContext::emitCode(void) {
     GenKernel *genKernel = static_cast<GenKernel*>(this->kernel);
     sel->select();
@@ -3668,6 +3775,8 @@ namespace gbe
     if (UNLIKELY(ra->allocate(*this->sel) == false))
       return false;
     schedulePostRegAllocation(*this, *this->sel);
+    if (OCL_DEPENDENCY_CONTROL)
+      this->setDependencyControl();
     if (OCL_OUTPUT_REG_ALLOC)
       ra->outputAllocation();
     if (inProfilingMode) { // add the profiling prolog before do anything.
@@ -92,6 +92,8 @@ namespace gbe
     GenRegister checkFlagRegister(GenRegister flagReg);
     /*! Emit the per-lane stack pointer computation */
     virtual void emitStackPointer(void);
+    /*! Set the NoDDClr/NoDDChk hints on consecutive partial writes of a register */
+    void setDependencyControl(void);
     /*! Emit the instructions */
     void emitInstructionStream(void);
     /*! Set the correct target values for the branches */
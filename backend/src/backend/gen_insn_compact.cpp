@@ -523,6 +523,7 @@ namespace gbe {
     b.saturate = s->saturate;
     b.flag_sub_reg_nr = s->subFlag;
     b.flag_reg_nr = s->flag;
+    b.dependency_control = s->noDDClr | (s->noDDChk << 1);
 
     compact_table_entry key;
     key.bit_pattern = b.data;
@@ -566,6 +567,7 @@ namespace gbe {
     b.mask_control = s->noMask;
     b.quarter_control = quarter;
     b.access_mode = 1;
+    b.dependency_control = s->noDDClr | (s->noDDChk << 1);
 
     compact_table_entry key;
     key.bit_pattern = b.data;
@@ -1006,7 +1006,8 @@ namespace gbe
     map <uint32_t, struct SpillReg> SpillRegs;
 
     for (auto &block : blockList)
-      for (auto &insn : block.insnList) {
+      for (auto insnIt = block.insnList.begin(); insnIt != block.insnList.end();) {
+        SelectionInstruction &insn = *insnIt++;
         // spill / unspill insn should be skipped when do spilling
         if(insn.opcode == SEL_OP_SPILL_REG
            || insn.opcode == SEL_OP_UNSPILL_REG)
@@ -1016,8 +1017,10 @@ namespace gbe
         const uint32_t srcNum = insn.srcNum, dstNum = insn.dstNum;
         struct RegSlot {
           RegSlot(ir::Register _reg, uint8_t _srcID,
-                   uint8_t _poolOffset, bool _isTmp, uint32_t _addr)
-                 : reg(_reg), srcID(_srcID), poolOffset(_poolOffset), isTmpReg(_isTmp), addr(_addr)
+                   uint8_t _poolOffset, bool _isTmp, uint32_t _addr,
+                   const SelectionInstruction *_remat)
+                 : reg(_reg), srcID(_srcID), poolOffset(_poolOffset), isTmpReg(_isTmp), addr(_addr),
+                   remat(_remat)
           {};
           ir::Register reg;
           union {
@@ -1027,6 +1030,7 @@ namespace gbe
           uint8_t poolOffset;
           bool isTmpReg;
           int32_t addr;
+          const SelectionInstruction *remat;
         };
         uint8_t poolOffset = 1; // keep one for scratch message header
         vector <struct RegSlot> regSet;
@@ -1043,7 +1047,8 @@ namespace gbe
             }
             struct RegSlot regSlot(reg, srcID, poolOffset,
                                    it->second.isTmpReg,
-                                   it->second.addr);
+                                   it->second.addr,
+                                   it->second.remat);
             if(family == ir::FAMILY_QWORD) {
               poolOffset += 2 * simdWidth / 8;
             } else {
@@ -1063,7 +1068,25 @@ namespace gbe
           struct RegSlot regSlot = regSet.back();
           regSet.pop_back();
           const GenRegister selReg = insn.src(regSlot.srcID);
-          if (!regSlot.isTmpReg) {
+          if (regSlot.remat != NULL) {
+            /* Cheap value, recompute it in the pool instead of reading the scratch. */
+            const SelectionInstruction *def = regSlot.remat;
+            SelectionInstruction *remat = this->create((SelectionOpcode)def->opcode,
+                                                       1, def->srcNum);
+            remat->state = def->state;
+            remat->state.noMask = 1;
+            remat->extra = def->extra;
+            const GenRegister defDst = def->dst(0);
+            GenRegister dst0 = GenRegister(GEN_GENERAL_REGISTER_FILE,
+                                           registerPool + regSlot.poolOffset, 0,
+                                           defDst.type, defDst.vstride,
+                                           defDst.width, defDst.hstride);
+            dst0.value.reg = defDst.value.reg;
+            remat->dst(0) = dst0;
+            for (uint32_t i = 0; i < def->srcNum; ++i)
+              remat->src(i) = def->src(i);
+            insn.prepend(*remat);
+          } else if (!regSlot.isTmpReg) {
           /* For temporary registers, we don't need to unspill. */
             SelectionInstruction *unspill = this->create(SEL_OP_UNSPILL_REG,
                                             1 + (ctx.reservedSpillRegs * 8) / ctx.getSimdWidth(), 0);
@@ -1110,6 +1133,7 @@ namespace gbe
           instruction. Thus the registerPool + 1 still contain valid
           data.
          */
+        bool isRematDef = false;
         for (uint32_t dstID = 0; dstID < dstNum; ++dstID) {
           const GenRegister selReg = insn.dst(dstID);
           const ir::Register reg = selReg.reg();
@@ -1117,13 +1141,19 @@ namespace gbe
           if(it != spilledRegs.end()
              && selReg.file == GEN_GENERAL_REGISTER_FILE
              && selReg.physical == 0) {
+            // The definition is cloned before each use, drop the original
+            if (it->second.remat == &insn) {
+              isRematDef = true;
+              continue;
+            }
             ir::RegisterFamily family = getRegisterFamily(reg);
             if(family == ir::FAMILY_QWORD && poolOffset == 1) {
               poolOffset += simdWidth / 8; // qword register spill could not share the scratch write message payload register
             }
             struct RegSlot regSlot(reg, dstID, poolOffset,
                                    it->second.isTmpReg,
-                                   it->second.addr);
+                                   it->second.addr,
+                                   NULL);
             if (family == ir::FAMILY_QWORD) poolOffset += 2 * simdWidth / 8;
             else poolOffset += simdWidth / 8;
             regSet.push_back(regSlot);
@@ -1171,6 +1201,8 @@ namespace gbe
           dst.physical =1; dst.nr = registerPool + regSlot.poolOffset; dst.subnr = 0;
           insn.dst(regSlot.dstID)= dst;
         }
+        if (isRematDef)
+          block.insnList.erase(&insn);
       }
     return true;
   }
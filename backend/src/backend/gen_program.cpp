@@ -73,14 +73,18 @@
 namespace gbe {
 
   GenKernel::GenKernel(const std::string &name, uint32_t deviceID) :
-    Kernel(name), deviceID(deviceID), insns(NULL), insnNum(0)
+    Kernel(name), deviceID(deviceID), insns(NULL), insnNum(0), insnsMapped(false)
   {}
-  GenKernel::~GenKernel(void) { GBE_SAFE_DELETE_ARRAY(insns); }
+  GenKernel::~GenKernel(void) { if (!insnsMapped) GBE_SAFE_DELETE_ARRAY(insns); }
   const char *GenKernel::getCode(void) const { return (const char*) insns; }
   void GenKernel::setCode(const char * ins, size_t size) {
     insns = (GenInstruction *)ins;
     insnNum = size / sizeof(GenInstruction);
   }
+  void GenKernel::mapCode(const char * ins, size_t size) {
+    this->setCode(ins, size);
+    insnsMapped = true;
+  }
   uint32_t GenKernel::getCodeSize(void) const { return insnNum * sizeof(GenInstruction); }
 
   void GenKernel::printStatus(int indent, std::ostream& outs) {
@@ -331,6 +335,10 @@ namespace gbe {
                                       (IS_GEMINILAKE(deviceID) && MATCH_GLK_HEADER(binary)) \
                                       )
 
+  static bool genProgramMatchBinary(uint32_t deviceID, const char *header) {
+    return MATCH_DEVICE(deviceID, (const unsigned char*)header);
+  }
+
   static gbe_program genProgramNewFromBinary(uint32_t deviceID, const char *binary, size_t size) {
     using namespace gbe;
     std::string binary_content;
@@ -343,8 +351,23 @@ namespace gbe {
       return NULL;
     }
 
-    binary_content.assign(binary+GEN_BINARY_HEADER_LENGTH, size-GEN_BINARY_HEADER_LENGTH);
     GenProgram *program = GBE_NEW(GenProgram, deviceID);
+    const char *content = binary+GEN_BINARY_HEADER_LENGTH;
+    const size_t content_size = size-GEN_BINARY_HEADER_LENGTH;
+    uint32_t magic = 0;
+
+    // Image binaries are used in place, their kernels are read on first use
+    if (content_size >= sizeof(magic))
+      memcpy(&magic, content, sizeof(magic));
+    if (magic == Program::magic_image) {
+      if (!program->deserializeFromImage(content, content_size)) {
+        delete program;
+        return NULL;
+      }
+      return reinterpret_cast<gbe_program>(program);
+    }
+
+    binary_content.assign(binary+GEN_BINARY_HEADER_LENGTH, size-GEN_BINARY_HEADER_LENGTH);
     std::istringstream ifs(binary_content, std::ostringstream::binary);
 
     if (!program->deserializeFromBin(ifs)) {
@@ -631,6 +654,7 @@ namespace gbe {
 void genSetupCallBacks(void)
 {
   gbe_program_new_from_binary = gbe::genProgramNewFromBinary;
+  gbe_program_match_binary = gbe::genProgramMatchBinary;
   gbe_program_new_from_llvm_binary = gbe::genProgramNewFromLLVMBinary;
   gbe_program_serialize_to_binary = gbe::genProgramSerializeToBinary;
   gbe_program_new_from_llvm = gbe::genProgramNewFromLLVM;
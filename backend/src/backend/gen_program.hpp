@@ -45,6 +45,8 @@ namespace gbe
     virtual const char *getCode(void) const;
     /*! Set the instruction stream (to be implemented) */
     virtual void setCode(const char *, size_t size);
+    /*! Use an instruction stream we do not own */
+    virtual void mapCode(const char *, size_t size);
     /*! Implements get the code size */
     virtual uint32_t getCodeSize(void) const;
     /*! Implements printStatus*/
@@ -52,6 +54,7 @@ namespace gbe
     uint32_t deviceID;      //!< Current device ID
     GenInstruction *insns; //!< Instruction stream
     uint32_t insnNum;      //!< Number of instructions
+    bool insnsMapped;      //!< Instruction stream lives in a binary image
     GBE_CLASS(GenKernel);  //!< Use custom allocators
   };
 
@@ -74,6 +77,8 @@ namespace gbe
     virtual Kernel *allocateKernel(const std::string &name) {
       return GBE_NEW(GenKernel, name, deviceID);
     }
+    /*! The assembly dump file name does not outlive the build */
+    virtual bool canDeferKernels(void) const { return asm_file_name == NULL; }
     void* module;
     void* llvm_ctx;
     const char* asm_file_name;
@@ -36,6 +36,8 @@
 
 
 #define HALF_REGISTER_FILE_OFFSET (32*64)
+/*! The GRFs are interleaved in two banks: even and odd register numbers */
+#define GRF_BANK(offset) (((offset) / GEN_REG_SIZE) & 1)
 namespace gbe
 {
   /////////////////////////////////////////////////////////////////////////////
@@ -50,13 +52,15 @@ namespace gbe
   struct GenRegInterval {
     INLINE GenRegInterval(ir::Register reg) :
       reg(reg), minID(INT_MAX), maxID(-INT_MAX), accessCount(0),
-      blockID(-1), conflictReg(0), b3OpAlign(0), usedHole(false), isHole(false){}
+      blockID(-1), conflictReg(0), b3OpAlign(0), usedHole(false), isHole(false),
+      canRemat(false) {}
     ir::Register reg;     //!< (virtual) register of the interval
     int32_t minID, maxID; //!< Starting and ending points
     int32_t accessCount;
     int32_t blockID; //!< blockID for in-block regs that can reuse hole
     ir::Register conflictReg; // < has banck conflict with this register
     bool b3OpAlign, usedHole, isHole;
+    bool canRemat; //!< Value can be recomputed at its uses instead of spilled
   };
 
   struct SpillInterval {
@@ -112,6 +116,12 @@ namespace gbe
     /*! calculate the spill cost, what we store here is 'use count',
      * we use [use count]/[live range] as spill cost */
     void calculateSpillCost(Selection &selection);
+    /*! Find the registers cheap enough to be recomputed before each use */
+    void findRematCandidates(Selection &selection,
+                             const vector<uint32_t> &defNum,
+                             const set<ir::Register> &splitUses);
+    /*! Drop the rematerializations whose operands did not get a GRF */
+    void validateRemat(void);
     /*! validated flags which contains valid value in the physical flag register */
     set<uint32_t> validatedFlags;
     /*! validated temp flag register which indicate the flag 0,1 contains which virtual flag register. */
@@ -160,6 +170,8 @@ namespace gbe
     vector<GenRegInterval*> ending;
     /*! registers that are spilled */
     SpilledRegs spilledRegs;
+    /*! Defining instruction of the registers that can be rematerialized */
+    map<ir::Register, const SelectionInstruction*> rematDefs;
     /*! register which could be spilled.*/
     std::set<GenRegInterval*> spillCandidate;
     /*! BBs last instruction ID map */
@@ -176,6 +188,10 @@ namespace gbe
     INLINE bool findNextSpillCandidate(std::vector<SpillInterval> &candidate,
                 int &remainSize, int &offset, SpillIntervalIter &nextCand);
     INLINE uint32_t allocateReg(GenRegInterval interval, uint32_t size, uint32_t alignment);
+    INLINE int32_t avoidBankConflict(const GenRegInterval &interval, int32_t grfOffset,
+                                     uint32_t size, uint32_t alignment, bool direction);
+    /*! Number of 3-source instructions reading two sources from the same bank */
+    uint32_t countBankConflicts(uint32_t &threeSrcNum);
     INLINE bool spillReg(GenRegInterval interval, bool isAllocated = false);
     INLINE bool spillReg(ir::Register reg, bool isAllocated = false);
     INLINE bool vectorCanSpill(SelectionVector *vector);
@@ -849,8 +865,14 @@ namespace gbe
     }
     if (!spilledRegs.empty()) {
       GBE_ASSERT(reservedReg != 0);
+      this->validateRemat();
+      // Rematerialized registers do not produce any scratch traffic
+      uint32_t scratchSpillNum = 0;
+      for (auto &it : spilledRegs)
+        if (it.second.remat == NULL)
+          scratchSpillNum++;
       if (ctx.getSimdWidth() == 16) {
-        if (spilledRegs.size() > (unsigned int)OCL_SIMD16_SPILL_THRESHOLD) {
+        if (scratchSpillNum > (unsigned int)OCL_SIMD16_SPILL_THRESHOLD) {
           ctx.errCode = REGISTER_SPILL_EXCEED_THRESHOLD;
           return false;
         }
@@ -871,14 +893,15 @@ namespace gbe
 
   INLINE bool GenRegAllocator::Opaque::allocateScratchForSpilled()
   {
-    const uint32_t regNum = spilledRegs.size();
-    this->starting.resize(regNum);
-    this->ending.resize(regNum);
-    uint32_t regID = 0;
+    this->starting.clear();
+    this->ending.clear();
     for(auto it = spilledRegs.begin(); it != spilledRegs.end(); ++it) {
-      this->starting[regID] = this->ending[regID] = &intervals[it->first];
-      regID++;
+      if (it->second.remat != NULL)
+        continue;
+      this->starting.push_back(&intervals[it->first]);
+      this->ending.push_back(&intervals[it->first]);
     }
+    const uint32_t regNum = this->starting.size();
     std::sort(this->starting.begin(), this->starting.end(), cmp<true>);
     std::sort(this->ending.begin(), this->ending.end(), cmp<false>);
     int toExpire = 0;
@@ -984,6 +1007,9 @@ namespace gbe
     SpillRegTag spillTag;
     spillTag.isTmpReg = interval.maxID == interval.minID;
     spillTag.addr = -1;
+    spillTag.remat = NULL;
+    if (intervals[interval.reg].canRemat && !spillTag.isTmpReg)
+      spillTag.remat = rematDefs.find(interval.reg)->second;
 
     if (isAllocated) {
       // If this register is allocated, we need to expire it and erase it
@@ -1015,6 +1041,10 @@ namespace gbe
       return 1.0f;
     // FIXME some register may get access count of 0, need to be fixed.
     float count = v.accessCount == 0 ? (float)2 : (float)v.accessCount;
+    // Recomputing the value is one ALU instruction per use while a spill
+    // costs a scratch write and one scratch read per use. Prefer those.
+    if (v.canRemat)
+      count *= 0.125f;
     return count / (float)(v.maxID - v.minID);
   }
 
@@ -1232,9 +1262,71 @@ namespace gbe
           return 0;
       }
     }
+    if (interval.conflictReg != 0)
+      grfOffset = avoidBankConflict(interval, grfOffset, size, alignment, direction);
     return grfOffset;
   }
 
+  // The two last sources of MAD/LRP are read in the same cycle. When they sit
+  // in the same bank the read is serialized. If the offset we got shares the
+  // bank of the conflicting register, look for a free slot in the other bank
+  // and keep the first fit otherwise.
+  INLINE int32_t GenRegAllocator::Opaque::avoidBankConflict(const GenRegInterval &interval,
+                                                            int32_t grfOffset,
+                                                            uint32_t size,
+                                                            uint32_t alignment,
+                                                            bool direction) {
+    auto it = RA.find(interval.conflictReg);
+    if (it == RA.end())
+      return grfOffset;
+    const uint32_t bank = GRF_BANK(it->second);
+    // SIMD16 registers are aligned on register pairs and always start in the
+    // even bank, nothing to choose there
+    if (GRF_BANK(grfOffset) != bank || alignment > GEN_REG_SIZE)
+      return grfOffset;
+    const uint32_t maxTry = 2;
+    int32_t tried[maxTry];
+    uint32_t triedNum = 0;
+    int32_t bestOffset = grfOffset;
+    while (triedNum < maxTry) {
+      const int32_t offset = ctx.allocate(size, alignment, direction);
+      if (offset == -1)
+        break;
+      if (GRF_BANK(offset) != bank) {
+        bestOffset = offset;
+        break;
+      }
+      tried[triedNum++] = offset;
+    }
+    for (uint32_t i = 0; i < triedNum; ++i)
+      ctx.deallocate(tried[i]);
+    if (bestOffset != grfOffset)
+      ctx.deallocate(grfOffset);
+    return bestOffset;
+  }
+
+  uint32_t GenRegAllocator::Opaque::countBankConflicts(uint32_t &threeSrcNum) {
+    uint32_t conflictNum = 0;
+    threeSrcNum = 0;
+    for (auto &block : *ctx.sel->blockList)
+      for (auto &insn : block.insnList) {
+        if (insn.opcode != SEL_OP_MAD && insn.opcode != SEL_OP_LRP)
+          continue;
+        threeSrcNum++;
+        const GenRegister &src1 = insn.src(1), &src2 = insn.src(2);
+        if (src1.file != GEN_GENERAL_REGISTER_FILE ||
+            src2.file != GEN_GENERAL_REGISTER_FILE)
+          continue;
+        if ((!src1.physical && !RA.contains(src1.reg())) ||
+            (!src2.physical && !RA.contains(src2.reg())))
+          continue;
+        const GenRegister r1 = genReg(src1), r2 = genReg(src2);
+        if (r1.nr != r2.nr && (r1.nr & 1) == (r2.nr & 1))
+          conflictNum++;
+      }
+    return conflictNum;
+  }
+
   int UseCountApproximate(int loopDepth) {
     int ret = 1;
     for (int i = 0; i < loopDepth; i++) {
@@ -1243,8 +1335,11 @@ namespace gbe
     return ret;
   }
 
+  BVAR(OCL_REMATERIALIZE, true);
   void GenRegAllocator::Opaque::calculateSpillCost(Selection &selection) {
     int BlockIndex = 0;
+    vector<uint32_t> defNum(intervals.size(), 0);
+    set<ir::Register> splitUses;
     for (auto &block : *selection.blockList) {
       int LoopDepth = ctx.fn.getLoopDepth(ir::LabelIndex(BlockIndex));
       for (auto &insn : block.insnList) {
@@ -1252,18 +1347,102 @@ namespace gbe
         for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
           const GenRegister &selReg = insn.src(srcID);
           const ir::Register reg = selReg.reg();
-          if (selReg.file == GEN_GENERAL_REGISTER_FILE)
+          if (selReg.file == GEN_GENERAL_REGISTER_FILE) {
             this->intervals[reg].accessCount += UseCountApproximate(LoopDepth);
+            if (selReg.physical == 0 && selReg.quarter != 0)
+              splitUses.insert(reg);
+          }
         }
         for (uint32_t dstID = 0; dstID < dstNum; ++dstID) {
           const GenRegister &selReg = insn.dst(dstID);
           const ir::Register reg = selReg.reg();
-          if (selReg.file == GEN_GENERAL_REGISTER_FILE)
+          if (selReg.file == GEN_GENERAL_REGISTER_FILE) {
             this->intervals[reg].accessCount += UseCountApproximate(LoopDepth);
+            if (selReg.physical == 0 && reg < defNum.size()) {
+              defNum[reg]++;
+              rematDefs[reg] = &insn;
+            }
+          }
         }
       }
       BlockIndex++;
     }
+    if (OCL_REMATERIALIZE && reservedReg != 0)
+      this->findRematCandidates(selection, defNum, splitUses);
+    else
+      rematDefs.clear();
+  }
+
+  void GenRegAllocator::Opaque::findRematCandidates(Selection &selection,
+                                                    const vector<uint32_t> &defNum,
+                                                    const set<ir::Register> &splitUses) {
+    // A register is rematerialized by cloning its single definition in front
+    // of each of its uses. The definition must be a simple full width ALU
+    // instruction whose operands are immediates or payload registers (curbe
+    // values, ids...) that are never written and that stay alive at least as
+    // long as the register itself.
+    for (auto it = rematDefs.begin(); it != rematDefs.end();) {
+      const ir::Register reg = it->first;
+      const SelectionInstruction &insn = *it->second;
+      const GenRegInterval &interval = intervals[reg];
+      bool canRemat = defNum[reg] == 1 && !splitUses.contains(reg);
+      canRemat = canRemat && ctx.sel->getRegisterFamily(reg) == ir::FAMILY_DWORD
+                          && !ctx.sel->isScalarReg(reg)
+                          && !selection.isPartialWrite(reg)
+                          && vectorMap.find(reg) == vectorMap.end();
+      switch (insn.opcode) {
+        case SEL_OP_MOV: case SEL_OP_ADD: case SEL_OP_SHL:
+        case SEL_OP_SHR: case SEL_OP_AND: case SEL_OP_OR:
+          break;
+        default: canRemat = false;
+      }
+      canRemat = canRemat && insn.dstNum == 1
+                          && insn.state.execWidth == ctx.getSimdWidth()
+                          && insn.state.predicate == GEN_PREDICATE_NONE
+                          && insn.state.physicalFlag == 1
+                          && insn.state.accWrEnable == 0
+                          && insn.state.saturate == GEN_MATH_SATURATE_NONE;
+      const GenRegister &dst = insn.dst(0);
+      canRemat = canRemat && dst.quarter == 0 && dst.nr == 0 && dst.subnr == 0
+                          && dst.hstride == GEN_HORIZONTAL_STRIDE_1;
+      for (uint32_t srcID = 0; canRemat && srcID < insn.srcNum; ++srcID) {
+        const GenRegister &src = insn.src(srcID);
+        if (src.file == GEN_IMMEDIATE_VALUE)
+          continue;
+        if (src.file != GEN_GENERAL_REGISTER_FILE || src.physical != 0) {
+          canRemat = false;
+          break;
+        }
+        const ir::Register srcReg = src.reg();
+        gbe_curbe_type curbeType;
+        int subType;
+        ctx.getRegPayloadType(srcReg, curbeType, subType);
+        canRemat = curbeType != GBE_GEN_REG
+                   && defNum[srcReg] == 0
+                   && !intervals[srcReg].isHole
+                   && intervals[srcReg].maxID >= interval.maxID;
+      }
+      if (canRemat) {
+        intervals[reg].canRemat = true;
+        ++it;
+      } else
+        it = rematDefs.erase(it);
+    }
+  }
+
+  void GenRegAllocator::Opaque::validateRemat(void) {
+    for (auto &it : spilledRegs) {
+      const SelectionInstruction *insn = it.second.remat;
+      if (insn == NULL)
+        continue;
+      for (uint32_t srcID = 0; srcID < insn->srcNum; ++srcID) {
+        const GenRegister &src = insn->src(srcID);
+        if (src.file == GEN_GENERAL_REGISTER_FILE && !RA.contains(src.reg())) {
+          it.second.remat = NULL;
+          break;
+        }
+      }
+    }
   }
 
   INLINE bool GenRegAllocator::Opaque::allocate(Selection &selection) {
@@ -1308,7 +1487,7 @@ namespace gbe
       for (auto &insn : block.insnList) {
         const uint32_t srcNum = insn.srcNum, dstNum = insn.dstNum;
         assert(insnID == (int32_t)insn.ID);
-        bool is3SrcOp = insn.opcode == SEL_OP_MAD;
+        bool is3SrcOp = insn.opcode == SEL_OP_MAD || insn.opcode == SEL_OP_LRP;
         for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
           const GenRegister &selReg = insn.src(srcID);
           const ir::Register reg = selReg.reg();
@@ -1558,21 +1737,34 @@ do { \
              << " -> " << setw(8) << this->intervals[(uint)vReg].maxID
              << "]" << setw(8) << "use count: " << this->intervals[(uint)vReg].accessCount << endl;
     }
+    uint32_t rematNum = 0;
+    for(auto it = spilledRegs.begin(); it != spilledRegs.end(); it++)
+      if (it->second.remat != NULL)
+        rematNum++;
     if (!spilledRegs.empty())
-      cout << "## spilled registers: " << spilledRegs.size() << endl;
+      cout << "## spilled registers: " << spilledRegs.size()
+           << " (" << rematNum << " rematerialized)" << endl;
     for(auto it = spilledRegs.begin(); it != spilledRegs.end(); it++) {
       ir::Register vReg = it->first;
       ir::RegisterFamily family;
       uint32_t regSize;
       getRegAttrib(vReg, regSize, &family);
-      cout << "%" << setiosflags(ios::left) << setw(8) << vReg
-           << "@" << setw(8) << it->second.addr
-           << "  " << ir::getFamilyName(family)
+      cout << "%" << setiosflags(ios::left) << setw(8) << vReg;
+      if (it->second.remat != NULL)
+        cout << "remat    ";
+      else
+        cout << "@" << setw(8) << it->second.addr;
+      cout << "  " << ir::getFamilyName(family)
            <<  "  " << setw(-3) << regSize << "B\t"
            << "[  " << setw(8) << this->intervals[(uint)vReg].minID
            << " -> " << setw(8) << this->intervals[(uint)vReg].maxID
            << "]" << setw(8) << "use count: " << this->intervals[(uint)vReg].accessCount << endl;
     }
+    uint32_t threeSrcNum;
+    const uint32_t conflictNum = countBankConflicts(threeSrcNum);
+    if (threeSrcNum != 0)
+      cout << "## 3-source instructions with bank conflict: " << conflictNum
+           << " / " << threeSrcNum << endl;
     cout << endl;
   }
 
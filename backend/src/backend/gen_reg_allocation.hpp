@@ -31,6 +31,7 @@
 namespace gbe
 {
   class Selection;      // Pre-register allocation code generation
+  class SelectionInstruction; // Pre-register allocation instruction
   class GenRegister;    // Pre-register allocation Gen register
   struct GenRegInterval; // Liveness interval for each register
   class GenContext;     // Gen specific context
@@ -38,6 +39,9 @@ namespace gbe
   typedef struct SpillRegTag {
     bool isTmpReg;
     int32_t addr;
+    /*! Defining instruction cloned before each use instead of going through
+     *  the scratch space. NULL for a regular spill */
+    const SelectionInstruction *remat;
   } SpillRegTag;
 
   typedef struct HoleRegTag {
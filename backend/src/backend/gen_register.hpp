@@ -129,6 +129,8 @@ namespace gbe
       this->physicalFlag = 1;
       this->flagIndex = 0;
       this->saturate = GEN_MATH_SATURATE_NONE;
+      this->noDDClr = 0;
+      this->noDDChk = 0;
     }
     uint32_t physicalFlag:1; //!< Physical or virtual flag register
     uint32_t flag:1;         //!< Only if physical flag,
@@ -146,6 +148,8 @@ namespace gbe
     uint32_t predicate:4;
     uint32_t inversePredicate:1;
     uint32_t saturate:1;
+    uint32_t noDDClr:1;      //!< Do not clear the destination dependency
+    uint32_t noDDChk:1;      //!< Do not check the destination dependency
     uint32_t flagIndex;   //!< Only if virtual flag (index of the register)
     void chooseNib(int nib) {
       switch (nib) {
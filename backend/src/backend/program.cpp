@@ -100,12 +100,50 @@ namespace gbe {
 
   Program::Program(uint32_t fast_relaxed_math) : fast_relaxed_math(fast_relaxed_math), 
                                constantSet(NULL),
-                               relocTable(NULL) {}
+                               relocTable(NULL),
+                               deferredUnit(NULL),
+                               deferredRelaxMath(false),
+                               image(NULL) {}
   Program::~Program(void) {
     for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it)
-      GBE_DELETE(it->second);
+      if (it->second) GBE_DELETE(it->second);
     if (constantSet) delete constantSet;
     if (relocTable) delete relocTable;
+    if (deferredUnit) delete deferredUnit;
+  }
+
+  Kernel *Program::getDeferredKernel(const std::string &name) {
+    std::lock_guard<std::mutex> lock(deferredMutex);
+    map<std::string, Kernel*>::iterator it = kernels.find(name);
+    if (it == kernels.end())
+      return NULL;
+    if (it->second == NULL && image != NULL) {
+      const std::pair<uint32_t, uint32_t> &loc = imageKernels.find(name)->second;
+      Kernel *kernel = this->allocateKernel(name);
+      if (kernel->deserializeFromImage(image + loc.first, loc.second) &&
+          kernel->getName() == name)
+        it->second = kernel;
+      else
+        GBE_DELETE(kernel);
+    }
+#ifdef GBE_COMPILER_AVAILABLE
+    if (it->second == NULL && deferredUnit != NULL) {
+      std::string error;
+      it->second = this->buildKernel(*deferredUnit, name, deferredRelaxMath, error);
+      if (it->second == NULL)
+        std::cerr << error;
+    }
+#endif
+    return it->second;
+  }
+
+  bool Program::getDeferredKernels(void) {
+    if (!this->isDeferred())
+      return true;
+    for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it)
+      if (this->getDeferredKernel(it->first) == NULL)
+        return false;
+    return true;
   }
 
 #ifdef GBE_COMPILER_AVAILABLE
@@ -113,6 +151,7 @@ namespace gbe {
   BVAR(OCL_STRICT_CONFORMANCE, true);
   IVAR(OCL_PROFILING_LOG, 0, 0, 1); // Int for different profiling types.
   BVAR(OCL_OUTPUT_BUILD_LOG, false);
+  BVAR(OCL_DEFER_KERNEL_COMPILE, false);
 
   bool Program::buildFromLLVMModule(const void* module,
                                               std::string &error,
@@ -138,15 +177,41 @@ namespace gbe {
     }
     if(unit->getValid()){
       std::string error2;
+      // The unit is kept to compile each kernel on its first use
+      if (OCL_DEFER_KERNEL_COMPILE && this->canDeferKernels()) {
+        deferredUnit = unit;
+        deferredRelaxMath = !strictMath;
+      }
       if (this->buildFromUnit(*unit, error2)){
         ret = true;
       }
       error = error + error2;
     }
-    delete unit;
+    if (unit != deferredUnit)
+      delete unit;
     return ret;
   }
 
+  Kernel *Program::buildKernel(const ir::Unit &unit, const std::string &name,
+                               bool relaxMath, std::string &error) {
+    const ir::Function *fn = unit.getFunction(name);
+    Kernel *kernel = this->compileKernel(unit, name, relaxMath, OCL_PROFILING_LOG);
+    if (!kernel) {
+      error +=  name;
+      error += ":(GBE): error: failed in Gen backend.\n";
+      if (OCL_OUTPUT_BUILD_LOG)
+        llvm::errs() << error;
+      return NULL;
+    }
+    kernel->setSamplerSet(fn->getSamplerSet());
+    kernel->setProfilingInfo(new ir::ProfilingInfo(*unit.getProfilingInfo()));
+    kernel->setImageSet(fn->getImageSet());
+    kernel->setPrintfSet(fn->getPrintfSet());
+    kernel->setCompileWorkGroupSize(fn->getCompileWorkGroupSize());
+    kernel->setFunctionAttributes(fn->getFunctionAttributes());
+    return kernel;
+  }
+
   bool Program::buildFromUnit(const ir::Unit &unit, std::string &error) {
     constantSet = new ir::ConstantSet(unit.getConstantSet());
     relocTable = new ir::RelocTable(unit.getRelocTable());
@@ -162,20 +227,14 @@ namespace gbe {
 
     for (const auto &pair : set) {
       const std::string &name = pair.first;
-      Kernel *kernel = this->compileKernel(unit, name, !strictMath, OCL_PROFILING_LOG);
-      if (!kernel) {
-        error +=  name;
-        error += ":(GBE): error: failed in Gen backend.\n";
-        if (OCL_OUTPUT_BUILD_LOG)
-          llvm::errs() << error;
-        return false;
+      // Deferred kernels are only named here, see getDeferredKernel
+      if (deferredUnit == &unit) {
+        kernels.insert(std::make_pair(name, (Kernel *) NULL));
+        continue;
       }
-      kernel->setSamplerSet(pair.second->getSamplerSet());
-      kernel->setProfilingInfo(new ir::ProfilingInfo(*unit.getProfilingInfo()));
-      kernel->setImageSet(pair.second->getImageSet());
-      kernel->setPrintfSet(pair.second->getPrintfSet());
-      kernel->setCompileWorkGroupSize(pair.second->getCompileWorkGroupSize());
-      kernel->setFunctionAttributes(pair.second->getFunctionAttributes());
+      Kernel *kernel = this->buildKernel(unit, name, !strictMath, error);
+      if (!kernel)
+        return false;
       kernels.insert(std::make_pair(name, kernel));
     }
     return true;
@@ -188,47 +247,74 @@ namespace gbe {
   uint32_t Program::serializeToBin(std::ostream& outs) {
     uint32_t ret_size = 0;
     uint32_t ker_num = kernels.size();
-    uint32_t has_constset = 0;
-    uint32_t has_relocTable = 0;
+    std::ostringstream constStream, relocStream;
+    std::vector<std::string> records;
 
-    OUT_UPDATE_SZ(magic_begin);
+    // The binary holds every kernel, finish the deferred compilation
+    if (!this->getDeferredKernels())
+      return 0;
 
-    if (constantSet) {
-      has_constset = 1;
-      OUT_UPDATE_SZ(has_constset);
-      uint32_t sz = constantSet->serializeToBin(outs);
-      if (!sz)
+    if (constantSet && constantSet->serializeToBin(constStream) == 0)
+      return 0;
+    if (relocTable && relocTable->serializeToBin(relocStream) == 0)
+      return 0;
+    for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it) {
+      std::ostringstream kernelStream;
+      if (it->second->serializeToBin(kernelStream) == 0)
         return 0;
-
-      ret_size += sz;
-    } else {
-      OUT_UPDATE_SZ(has_constset);
+      records.push_back(kernelStream.str());
     }
+    const std::string constData = constStream.str();
+    const std::string relocData = relocStream.str();
 
-    if(relocTable) {
-      has_relocTable = 1;
-      OUT_UPDATE_SZ(has_relocTable);
-      uint32_t sz = relocTable->serializeToBin(outs);
-      if (!sz)
-        return 0;
+    // Lay out the image: header, kernel table, names, then the data blocks
+    uint32_t offset = 7 * sizeof(uint32_t) + ker_num * 4 * sizeof(uint32_t);
+    for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it)
+      offset += it->first.size();
+    const uint32_t const_offset = offset;
+    offset += constData.size();
+    const uint32_t reloc_offset = offset;
+    offset += relocData.size();
+    const uint32_t kernel_offset = offset;
+    for (size_t i = 0; i < records.size(); ++i)
+      offset += records[i].size();
+    const uint32_t image_size = offset + sizeof(magic_end);
+
+    OUT_UPDATE_SZ(magic_image);
+    OUT_UPDATE_SZ(image_size);
+    OUT_UPDATE_SZ(const_offset);
+    OUT_UPDATE_SZ(uint32_t(constData.size()));
+    OUT_UPDATE_SZ(reloc_offset);
+    OUT_UPDATE_SZ(uint32_t(relocData.size()));
+    OUT_UPDATE_SZ(ker_num);
 
-      ret_size += sz;
-    } else {
-      OUT_UPDATE_SZ(has_relocTable);
+    uint32_t name_offset = 7 * sizeof(uint32_t) + ker_num * 4 * sizeof(uint32_t);
+    uint32_t record_offset = kernel_offset;
+    uint32_t i = 0;
+    for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it, ++i) {
+      OUT_UPDATE_SZ(name_offset);
+      OUT_UPDATE_SZ(uint32_t(it->first.size()));
+      OUT_UPDATE_SZ(record_offset);
+      OUT_UPDATE_SZ(uint32_t(records[i].size()));
+      name_offset += it->first.size();
+      record_offset += records[i].size();
     }
 
-    OUT_UPDATE_SZ(ker_num);
     for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it) {
-      uint32_t sz = it->second->serializeToBin(outs);
-      if (!sz)
-        return 0;
-
-      ret_size += sz;
+      outs.write(it->first.c_str(), it->first.size());
+      ret_size += it->first.size();
+    }
+    outs.write(constData.c_str(), constData.size());
+    ret_size += constData.size();
+    outs.write(relocData.c_str(), relocData.size());
+    ret_size += relocData.size();
+    for (size_t i = 0; i < records.size(); ++i) {
+      outs.write(records[i].c_str(), records[i].size());
+      ret_size += records[i].size();
     }
 
     OUT_UPDATE_SZ(magic_end);
-
-    OUT_UPDATE_SZ(ret_size);
+    GBE_ASSERT(ret_size == image_size);
     return ret_size;
   }
 
@@ -291,6 +377,102 @@ namespace gbe {
     return total_size;
   }
 
+  /*! Read only stream buffer over memory we do not own. Nothing is copied
+   *  and the position in the image is available with tellg */
+  class ImageStreamBuf : public std::streambuf
+  {
+  public:
+    ImageStreamBuf(const char *data, size_t size) {
+      char *begin = const_cast<char *>(data);
+      this->setg(begin, begin, begin + size);
+    }
+  protected:
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                             std::ios_base::openmode which) {
+      char *pos = this->gptr() + off;
+      if (dir == std::ios_base::beg)
+        pos = this->eback() + off;
+      else if (dir == std::ios_base::end)
+        pos = this->egptr() + off;
+      if (pos < this->eback() || pos > this->egptr())
+        return pos_type(off_type(-1));
+      this->setg(this->eback(), pos, this->egptr());
+      return pos_type(pos - this->eback());
+    }
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+      return this->seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+  };
+
+  /*! True if [offset, offset+size) lies in an image of image_size bytes */
+  static bool inImage(uint32_t offset, uint32_t size, uint32_t image_size) {
+    return offset <= image_size && size <= image_size - offset;
+  }
+
+  uint32_t Program::deserializeFromImage(const char *data, size_t size) {
+    uint32_t total_size = 0;
+    uint32_t magic, image_size, ker_num;
+    uint32_t const_offset, const_size, reloc_offset, reloc_size;
+
+    if (size < 7 * sizeof(uint32_t))
+      return 0;
+    ImageStreamBuf buf(data, size);
+    std::istream ins(&buf);
+
+    IN_UPDATE_SZ(magic);
+    if (magic != magic_image)
+      return 0;
+    IN_UPDATE_SZ(image_size);
+    if (image_size > size || image_size < 8 * sizeof(uint32_t))
+      return 0;
+    memcpy(&magic, data + image_size - sizeof(magic), sizeof(magic));
+    if (magic != magic_end)
+      return 0;
+
+    IN_UPDATE_SZ(const_offset);
+    IN_UPDATE_SZ(const_size);
+    if (!inImage(const_offset, const_size, image_size))
+      return 0;
+    if (const_size) {
+      ImageStreamBuf constBuf(data + const_offset, const_size);
+      std::istream constIns(&constBuf);
+      constantSet = new ir::ConstantSet;
+      if (constantSet->deserializeFromBin(constIns) == 0)
+        return 0;
+    }
+
+    IN_UPDATE_SZ(reloc_offset);
+    IN_UPDATE_SZ(reloc_size);
+    if (!inImage(reloc_offset, reloc_size, image_size))
+      return 0;
+    if (reloc_size) {
+      ImageStreamBuf relocBuf(data + reloc_offset, reloc_size);
+      std::istream relocIns(&relocBuf);
+      relocTable = new ir::RelocTable;
+      if (relocTable->deserializeFromBin(relocIns) == 0)
+        return 0;
+    }
+
+    // Only the kernel table is read, the kernels are parsed on first use
+    IN_UPDATE_SZ(ker_num);
+    for (uint32_t i = 0; i < ker_num; i++) {
+      uint32_t name_offset, name_size, kernel_offset, kernel_size;
+      IN_UPDATE_SZ(name_offset);
+      IN_UPDATE_SZ(name_size);
+      IN_UPDATE_SZ(kernel_offset);
+      IN_UPDATE_SZ(kernel_size);
+      if (!ins || !inImage(name_offset, name_size, image_size) ||
+          !inImage(kernel_offset, kernel_size, image_size))
+        return 0;
+      const std::string name(data + name_offset, name_size);
+      imageKernels[name] = std::make_pair(kernel_offset, kernel_size);
+      kernels.insert(std::make_pair(name, (Kernel *) NULL));
+    }
+
+    image = data;
+    return image_size;
+  }
+
   uint32_t Kernel::serializeToBin(std::ostream& outs) {
     unsigned int i;
     uint32_t ret_size = 0;
@@ -399,6 +581,16 @@ namespace gbe {
   }
 
   uint32_t Kernel::deserializeFromBin(std::istream& ins) {
+    return this->deserialize(ins, NULL);
+  }
+
+  uint32_t Kernel::deserializeFromImage(const char *image, size_t size) {
+    ImageStreamBuf buf(image, size);
+    std::istream ins(&buf);
+    return this->deserialize(ins, image);
+  }
+
+  uint32_t Kernel::deserialize(std::istream& ins, const char *image) {
     uint32_t total_size = 0;
     int has_samplerset = 0;
     int has_imageset = 0;
@@ -519,7 +711,14 @@ namespace gbe {
       imageSet = NULL;
 
     IN_UPDATE_SZ(code_size);
-    if (code_size) {
+    if (code_size && image) {
+      // Use the code in place, the image outlives the kernel
+      const std::streamoff pos = ins.tellg();
+      if (pos < 0 || !ins.seekg(code_size, std::ios_base::cur))
+        return 0;
+      total_size += sizeof(char)*code_size;
+      mapCode(image + pos, code_size);
+    } else if (code_size) {
       char* code = GBE_NEW_ARRAY_NO_ARG(char, code_size);
       ins.read(code, code_size*sizeof(char));
       total_size += sizeof(char)*code_size;
@@ -552,7 +751,8 @@ namespace gbe {
     }
 
     for (map<std::string, Kernel*>::iterator it = kernels.begin(); it != kernels.end(); ++it) {
-      it->second->printStatus(indent + 4, outs);
+      if (it->second)
+        it->second->printStatus(indent + 4, outs);
     }
 
     outs << spaces << "================ End Program ================" << "\n";
@@ -1283,16 +1483,28 @@ EXTEND_QUOTE:
 
   static gbe_kernel programGetKernelByName(gbe_program gbeProgram, const char *name) {
     if (gbeProgram == NULL) return NULL;
-    const gbe::Program *program = (gbe::Program*) gbeProgram;
+    gbe::Program *program = (gbe::Program*) gbeProgram;
     return (gbe_kernel) program->getKernel(std::string(name));
   }
 
   static gbe_kernel programGetKernel(const gbe_program gbeProgram, uint32_t ID) {
     if (gbeProgram == NULL) return NULL;
-    const gbe::Program *program = (gbe::Program*) gbeProgram;
+    gbe::Program *program = (gbe::Program*) gbeProgram;
     return (gbe_kernel) program->getKernel(ID);
   }
 
+  static const char *programGetKernelName(gbe_program gbeProgram, uint32_t ID) {
+    if (gbeProgram == NULL) return NULL;
+    const gbe::Program *program = (const gbe::Program*) gbeProgram;
+    return program->getKernelName(ID);
+  }
+
+  static int programIsDeferred(gbe_program gbeProgram) {
+    if (gbeProgram == NULL) return 0;
+    const gbe::Program *program = (const gbe::Program*) gbeProgram;
+    return program->isDeferred() ? 1 : 0;
+  }
+
   static const char *kernelGetName(gbe_kernel genKernel) {
     if (genKernel == NULL) return NULL;
     const gbe::Kernel *kernel = (const gbe::Kernel*) genKernel;
@@ -1470,11 +1682,11 @@ EXTEND_QUOTE:
     delete ps;
   }
 
-  static void kernelOutputPrintf(void * printf_info, void* buf_addr)
+  static uint32_t kernelOutputPrintf(void * printf_info, void* buf_addr, uint32_t buf_size)
   {
-    if (printf_info == NULL) return;
+    if (printf_info == NULL) return 0;
     ir::PrintfSet *ps = (ir::PrintfSet *)printf_info;
-    ps->outputPrintf(buf_addr);
+    return ps->outputPrintf(buf_addr, buf_size);
   }
 
   static void kernelGetCompileWorkGroupSize(gbe_kernel gbeKernel, size_t wg_size[3]) {
@@ -1523,6 +1735,7 @@ GBE_EXPORT_SYMBOL gbe_program_compile_from_source_cb *gbe_program_compile_from_s
 GBE_EXPORT_SYMBOL gbe_program_link_program_cb *gbe_program_link_program = NULL;
 GBE_EXPORT_SYMBOL gbe_program_check_opt_cb *gbe_program_check_opt = NULL;
 GBE_EXPORT_SYMBOL gbe_program_new_from_binary_cb *gbe_program_new_from_binary = NULL;
+GBE_EXPORT_SYMBOL gbe_program_match_binary_cb *gbe_program_match_binary = NULL;
 GBE_EXPORT_SYMBOL gbe_program_new_from_llvm_binary_cb *gbe_program_new_from_llvm_binary = NULL;
 GBE_EXPORT_SYMBOL gbe_program_serialize_to_binary_cb *gbe_program_serialize_to_binary = NULL;
 GBE_EXPORT_SYMBOL gbe_program_new_from_llvm_cb *gbe_program_new_from_llvm = NULL;
@@ -1538,6 +1751,8 @@ GBE_EXPORT_SYMBOL gbe_program_delete_cb *gbe_program_delete = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_kernel_num_cb *gbe_program_get_kernel_num = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_kernel_by_name_cb *gbe_program_get_kernel_by_name = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_kernel_cb *gbe_program_get_kernel = NULL;
+GBE_EXPORT_SYMBOL gbe_program_get_kernel_name_cb *gbe_program_get_kernel_name = NULL;
+GBE_EXPORT_SYMBOL gbe_program_is_deferred_cb *gbe_program_is_deferred = NULL;
 GBE_EXPORT_SYMBOL gbe_program_get_device_enqueue_kernel_name_cb *gbe_program_get_device_enqueue_kernel_name = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_name_cb *gbe_kernel_get_name = NULL;
 GBE_EXPORT_SYMBOL gbe_kernel_get_attributes_cb *gbe_kernel_get_attributes = NULL;
@@ -1595,6 +1810,8 @@ namespace gbe
       gbe_program_get_device_enqueue_kernel_name = gbe::programGetDeviceEnqueueKernelName;
       gbe_program_get_kernel_by_name = gbe::programGetKernelByName;
       gbe_program_get_kernel = gbe::programGetKernel;
+      gbe_program_get_kernel_name = gbe::programGetKernelName;
+      gbe_program_is_deferred = gbe::programIsDeferred;
       gbe_kernel_get_name = gbe::kernelGetName;
       gbe_kernel_get_attributes = gbe::kernelGetAttributes;
       gbe_kernel_get_code = gbe::kernelGetCode;
@@ -177,7 +177,9 @@ extern gbe_release_printf_info_cb *gbe_release_printf_info;
 typedef void* (gbe_dup_printfset_cb)(gbe_kernel gbeKernel);
 extern gbe_dup_printfset_cb *gbe_dup_printfset;
 
-typedef void (gbe_output_printf_cb) (void* printf_info, void* buf_addr);
+/*! Output the printf logs of a buffer of buf_size bytes. Returns the number
+ *  of bytes the kernel wrote past the end of the buffer, which are lost */
+typedef uint32_t (gbe_output_printf_cb) (void* printf_info, void* buf_addr, uint32_t buf_size);
 extern gbe_output_printf_cb* gbe_output_printf;
 
 
@@ -226,10 +228,15 @@ typedef gbe_program (gbe_program_new_gen_program_cb)(uint32_t deviceID,
                                                      const char *asm_file_name);
 extern gbe_program_new_gen_program_cb *gbe_program_new_gen_program;
 
-/*! Create a new program from the given blob */
+/*! Create a new program from the given blob. Gen binaries in the image
+ *  format are used in place: the blob must outlive the program */
 typedef gbe_program (gbe_program_new_from_binary_cb)(uint32_t deviceID, const char *binary, size_t size);
 extern gbe_program_new_from_binary_cb *gbe_program_new_from_binary;
 
+/*! Tell if the 8 bytes Gen binary header was generated for the device */
+typedef bool (gbe_program_match_binary_cb)(uint32_t deviceID, const char *header);
+extern gbe_program_match_binary_cb *gbe_program_match_binary;
+
 /*! Create a new program from the llvm bitcode*/
 typedef gbe_program (gbe_program_new_from_llvm_binary_cb)(uint32_t deviceID, const char *binary, size_t size);
 extern gbe_program_new_from_llvm_binary_cb *gbe_program_new_from_llvm_binary;
@@ -310,6 +317,14 @@ extern gbe_program_get_kernel_by_name_cb *gbe_program_get_kernel_by_name;
 typedef gbe_kernel (gbe_program_get_kernel_cb)(gbe_program, uint32_t ID);
 extern gbe_program_get_kernel_cb *gbe_program_get_kernel;
 
+/*! Get the name of the kernel from its ID, without compiling it */
+typedef const char* (gbe_program_get_kernel_name_cb)(gbe_program, uint32_t ID);
+extern gbe_program_get_kernel_name_cb *gbe_program_get_kernel_name;
+
+/*! Non zero when the kernels are compiled by their first gbe_program_get_kernel */
+typedef int (gbe_program_is_deferred_cb)(gbe_program);
+extern gbe_program_is_deferred_cb *gbe_program_is_deferred;
+
 typedef const char* (gbe_program_get_device_enqueue_kernel_name_cb)(gbe_program, uint32_t ID);
 extern gbe_program_get_device_enqueue_kernel_name_cb *gbe_program_get_device_enqueue_kernel_name;
 
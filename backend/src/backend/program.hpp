@@ -34,6 +34,7 @@
 #include "ir/sampler.hpp"
 #include "sys/vector.hpp"
 #include <string>
+#include <mutex>
 
 namespace gbe {
 namespace ir {
@@ -90,6 +91,8 @@ namespace gbe {
     virtual const char *getCode(void) const = 0;
     /*! Set the instruction stream.*/
     virtual void setCode(const char *, size_t size) = 0;
+    /*! Use an instruction stream owned by someone else (a binary image) */
+    virtual void mapCode(const char *, size_t size) = 0;
     /*! Return the instruction stream size (to be implemented) */
     virtual uint32_t getCodeSize(void) const = 0;
     /*! Get the kernel name */
@@ -231,6 +234,9 @@ namespace gbe {
     /*! Implements the serialization. */
     virtual uint32_t serializeToBin(std::ostream& outs);
     virtual uint32_t deserializeFromBin(std::istream& ins);
+    /*! Deserialize from memory which outlives the kernel, the code is used
+     *  in place */
+    uint32_t deserializeFromImage(const char *image, size_t size);
     virtual void printStatus(int indent, std::ostream& outs);
     /*! Does kernel use device enqueue */
     INLINE bool getUseDeviceEnqueue(void) const { return this->useDeviceEnqueue; }
@@ -240,6 +246,9 @@ namespace gbe {
     }
 
   protected:
+    /*! Common deserialization. With a non NULL image, ins reads the image and
+     *  the code is mapped instead of copied */
+    uint32_t deserialize(std::istream& ins, const char *image);
     friend class Context;      //!< Owns the kernels
     friend class GenContext;
     std::string name;    //!< Kernel name
@@ -276,27 +285,37 @@ namespace gbe {
     virtual void CleanLlvmResource() = 0;
     /*! Get the number of kernels in the program */
     uint32_t getKernelNum(void) const { return kernels.size(); }
-    /*! Get the kernel from its name */
-    Kernel *getKernel(const std::string &name) const {
+    /*! Get the kernel from its name. A deferred kernel is compiled or
+     *  loaded here */
+    Kernel *getKernel(const std::string &name) {
+      if (this->isDeferred())
+        return this->getDeferredKernel(name);
       map<std::string, Kernel*>::const_iterator it = kernels.find(name);
       if (it == kernels.end())
         return NULL;
       else
         return it->second;
     }
-    /*! Get the kernel from its ID */
-    Kernel *getKernel(uint32_t ID) const {
+    /*! Get the kernel from its ID. A deferred kernel is compiled or loaded
+     *  here */
+    Kernel *getKernel(uint32_t ID) {
+      const char *name = this->getKernelName(ID);
+      if (name == NULL)
+        return NULL;
+      return this->getKernel(std::string(name));
+    }
+    /*! Get the name of the kernel from its ID, without compiling it */
+    const char *getKernelName(uint32_t ID) const {
       uint32_t currID = 0;
-      Kernel *kernel = NULL;
       for (map<std::string, Kernel*>::const_iterator it = kernels.begin(); it != kernels.end(); ++it) {
-        if (currID == ID) {
-          kernel = it->second;
-          break;
-        }
+        if (currID == ID)
+          return it->first.c_str();
         currID++;
       }
-      return kernel;
+      return NULL;
     }
+    /*! True if the kernels are only compiled or loaded when first requested */
+    bool isDeferred(void) const { return deferredUnit != NULL || image != NULL; }
 
     const char *getDeviceEnqueueKernelName(uint32_t index) const {
       if(index >= blockFuncs.size())
@@ -318,8 +337,9 @@ namespace gbe {
     void getGlobalRelocTable(char *p) const { relocTable->getData(p); }
     static const uint32_t magic_begin = TO_MAGIC('P', 'R', 'O', 'G');
     static const uint32_t magic_end = TO_MAGIC('G', 'O', 'R', 'P');
+    static const uint32_t magic_image = TO_MAGIC('P', 'R', 'G', '2');
 
-    /* format:
+    /* Stream format, still read but not written anymore:
        magic_begin       |
        constantSet_flag  |
        constSet_data     |
@@ -329,11 +349,33 @@ namespace gbe {
        kernel_n          |
        magic_end         |
        total_size
+
+       Image format. All the offsets are relative to magic_image so the image
+       can be mapped and used in place; a kernel is only parsed when it is
+       first requested:
+       magic_image       |
+       image_size        |
+       constSet_offset   |
+       constSet_size     | 0 if there is no constant set
+       relocTable_offset |
+       relocTable_size   | 0 if there is no relocation table
+       kernel_num        |
+       kernel_table      | kernel_num * (name_offset, name_size,
+                         |               kernel_offset, kernel_size)
+       names             |
+       constSet_data     |
+       relocTable_data   |
+       kernel_1          | same as the stream format of the kernels
+       ........          |
+       kernel_n          |
+       magic_end
     */
 
-    /*! Implements the serialization. */
+    /*! Implements the serialization, the image format is written */
     virtual uint32_t serializeToBin(std::ostream& outs);
     virtual uint32_t deserializeFromBin(std::istream& ins);
+    /*! Read an image in place. The memory must outlive the program */
+    uint32_t deserializeFromImage(const char *image, size_t size);
     virtual void printStatus(int indent, std::ostream& outs);
     uint32_t fast_relaxed_math : 1;
 
@@ -341,6 +383,17 @@ namespace gbe {
     /*! Compile a kernel */
     virtual Kernel *compileKernel(const ir::Unit &unit, const std::string &name,
                                   bool relaxMath, int profiling) = 0;
+    /*! Compile a kernel and attach the function information to it */
+    Kernel *buildKernel(const ir::Unit &unit, const std::string &name,
+                        bool relaxMath, std::string &error);
+    /*! Compile the kernel, or load it from the image, on first request. The
+     *  call is virtual so that the interpreter library reaches the compiler
+     *  which created the program */
+    virtual Kernel *getDeferredKernel(const std::string &name);
+    /*! Compile or load all the deferred kernels. Returns false on failure */
+    bool getDeferredKernels(void);
+    /*! Whether the kernel compilation may be deferred to their first use */
+    virtual bool canDeferKernels(void) const { return true; }
     /*! Allocate an empty kernel. */
     virtual Kernel *allocateKernel(const std::string &name) = 0;
     /*! Kernels sorted by their name */
@@ -351,6 +404,16 @@ namespace gbe {
     ir::RelocTable *relocTable;
     /*! device enqueue functions */
     vector<std::string> blockFuncs;
+    /*! Gen IR kept to compile the deferred kernels, NULL if none */
+    ir::Unit *deferredUnit;
+    /*! Math mode the deferred kernels are compiled with */
+    bool deferredRelaxMath;
+    /*! Binary image the kernels are loaded from, NULL if none */
+    const char *image;
+    /*! Location of each kernel in the image */
+    map<std::string, std::pair<uint32_t, uint32_t>> imageKernels;
+    /*! Serializes the compilation or loading of the deferred kernels */
+    std::mutex deferredMutex;
     /*! Use custom allocators */
     GBE_CLASS(Program);
   };
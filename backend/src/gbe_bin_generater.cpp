@@ -32,6 +32,7 @@
 #include <fstream>
 #include <deque>
 #include <vector>
+#include <map>
 #include <algorithm>
 #include <stdlib.h>
 #include <stdio.h>
@@ -48,7 +49,19 @@ using namespace std;
 #define FILE_BUILD_FAILED 3
 #define FILE_SERIALIZATION_FAILED 4
 
-static uint32_t gen_pci_id = 0;
+/* Target devices. With more than one, a fat binary holding one Gen binary
+   per target is written. */
+static vector<uint32_t> gen_pci_ids;
+
+/* Fat binary layout, read back by cl_program_create_from_binary:
+     header      "\1GENF" and 3 padding bytes
+     entry_num   uint32_t
+     entries     entry_num * (8 bytes Gen binary header, uint32_t offset,
+                              uint32_t size)
+     programs    serialized programs, without their Gen binary header
+   The offsets are relative to the start of the fat binary. Targets with an
+   identical ISA share the same program. */
+static const char fat_header[9] = "\1GENF\0\0\0";
 
 class program_build_instance {
 
@@ -61,6 +74,7 @@ protected:
     int file_len;
     const char* code;
     gbe::Program* gbe_prog;
+    vector<gbe::Program*> gen_progs; //!< One per target in gen_pci_ids
 
 public:
     program_build_instance (void) : fd(-1), file_len(0), code(NULL), gbe_prog(NULL) { }
@@ -79,6 +93,10 @@ public:
 
         if (gbe_prog)
             gbe_program_delete(reinterpret_cast<gbe_program>(gbe_prog));
+
+        for (auto prog : gen_progs)
+            if (prog)
+                gbe_program_delete(reinterpret_cast<gbe_program>(prog));
     }
 
     program_build_instance(program_build_instance&& other) = default;
@@ -151,63 +169,107 @@ public:
 string program_build_instance::bin_path;
 bool program_build_instance::str_fmt_out = false;
 #define OUTS_UPDATE_SZ(elt) SERIALIZE_OUT(elt, oss, header_sz)
-#define OUTF_UPDATE_SZ(elt) SERIALIZE_OUT(elt, ofs, header_sz)
+
+/* The 8 bytes header of a Gen binary for the given device. The 5 first bytes
+   differentiate it from llvm bitcode: 1 byte for the binary version and 4
+   bytes 'GENC'. The 3 last ones are the hardware family. */
+static void get_gen_header(uint32_t pci_id, char gen_header[8])
+{
+    const char *hw_info = "\0\0\0";
+    if(IS_IVYBRIDGE(pci_id)){
+      hw_info = "IVB";
+      if(IS_BAYTRAIL_T(pci_id))
+        hw_info = "BYT";
+    }else if(IS_HASWELL(pci_id)){
+      hw_info = "HSW";
+    }else if(IS_BROADWELL(pci_id)){
+      hw_info = "BDW";
+    }else if(IS_CHERRYVIEW(pci_id)){
+      hw_info = "CHV";
+    }else if(IS_SKYLAKE(pci_id)){
+      hw_info = "SKL";
+    }else if(IS_BROXTON(pci_id)){
+      hw_info = "BXT";
+    }else if(IS_KABYLAKE(pci_id)){
+      hw_info = "KBT";
+    }else if(IS_GEMINILAKE(pci_id)){
+      hw_info = "GLK";
+    }
+    memcpy(gen_header, "\1GENC", 5);
+    memcpy(gen_header + 5, hw_info, 3);
+}
 
 void program_build_instance::serialize_program(void) throw(int)
 {
     ofstream ofs;
     ostringstream oss;
     size_t sz = 0, header_sz = 0;
-    ofs.open(bin_path, ofstream::out | ofstream::trunc | ofstream::binary);
 
-    char src_hw_info[4]="";
-    if(IS_IVYBRIDGE(gen_pci_id)){
-      src_hw_info[0]='I';
-      src_hw_info[1]='V';
-      src_hw_info[2]='B';
-      if(IS_BAYTRAIL_T(gen_pci_id)){
-        src_hw_info[0]='B';
-        src_hw_info[1]='Y';
-        src_hw_info[2]='T';
-      }
-    }else if(IS_HASWELL(gen_pci_id)){
-        src_hw_info[0]='H';
-        src_hw_info[1]='S';
-        src_hw_info[2]='W';
-    }else if(IS_BROADWELL(gen_pci_id)){
-        src_hw_info[0]='B';
-        src_hw_info[1]='D';
-        src_hw_info[2]='W';
-    }else if(IS_CHERRYVIEW(gen_pci_id)){
-        src_hw_info[0]='C';
-        src_hw_info[1]='H';
-        src_hw_info[2]='V';
-    }else if(IS_SKYLAKE(gen_pci_id)){
-        src_hw_info[0]='S';
-        src_hw_info[1]='K';
-        src_hw_info[2]='L';
-    }else if(IS_BROXTON(gen_pci_id)){
-        src_hw_info[0]='B';
-        src_hw_info[1]='X';
-        src_hw_info[2]='T';
+    if (gen_pci_ids.size() == 1) {
+        char gen_header[8];
+        get_gen_header(gen_pci_ids[0], gen_header);
+        for (int i = 0; i < 8; i++)
+            OUTS_UPDATE_SZ(gen_header[i]);
+        sz = gen_progs[0]->serializeToBin(oss);
+        if (sz)
+            sz += header_sz;
+    } else if (gen_pci_ids.size() > 1) {
+        vector<string> bins;
+        vector<uint32_t> entry_bin;
+        map<string, uint32_t> bin_index;
+
+        for (auto prog : gen_progs) {
+            ostringstream bin;
+            if (prog->serializeToBin(bin) == 0)
+                throw FILE_SERIALIZATION_FAILED;
+            auto it = bin_index.find(bin.str());
+            if (it == bin_index.end()) {
+                it = bin_index.insert(make_pair(bin.str(), bins.size())).first;
+                bins.push_back(bin.str());
+            }
+            entry_bin.push_back(it->second);
+        }
+
+        uint32_t entry_num = gen_pci_ids.size();
+        for (int i = 0; i < 8; i++)
+            OUTS_UPDATE_SZ(fat_header[i]);
+        OUTS_UPDATE_SZ(entry_num);
+
+        vector<uint32_t> offsets;
+        uint32_t offset = header_sz + entry_num * (8 + 2 * sizeof(uint32_t));
+        for (auto& bin : bins) {
+            offsets.push_back(offset);
+            offset += bin.size();
+        }
+        for (uint32_t i = 0; i < entry_num; i++) {
+            char gen_header[8];
+            get_gen_header(gen_pci_ids[i], gen_header);
+            for (int j = 0; j < 8; j++)
+                OUTS_UPDATE_SZ(gen_header[j]);
+            uint32_t bin_offset = offsets[entry_bin[i]];
+            uint32_t bin_size = bins[entry_bin[i]].size();
+            OUTS_UPDATE_SZ(bin_offset);
+            OUTS_UPDATE_SZ(bin_size);
+        }
+        for (auto& bin : bins)
+            oss.write(bin.c_str(), bin.size());
+        sz = offset;
+    } else {
+        char *llvm_binary;
+        size_t bin_length = gbe_program_serialize_to_binary((gbe_program)gbe_prog, &llvm_binary, 1);
+        oss.write(llvm_binary, bin_length);
+        sz += bin_length;
+        free(llvm_binary);
     }
 
-    if (str_fmt_out) {
+    if (!sz) {
+        throw FILE_SERIALIZATION_FAILED;
+    }
 
-      if(gen_pci_id){
-        //add header to differeciate from llvm bitcode binary.
-        // (5 bytes: 1 byte for binary version, 4 byte for bc code, 'GENC' is for gen binary.)
-        char gen_header[6] = "\1GENC";
-        OUTS_UPDATE_SZ(gen_header[0]);
-        OUTS_UPDATE_SZ(gen_header[1]);
-        OUTS_UPDATE_SZ(gen_header[2]);
-        OUTS_UPDATE_SZ(gen_header[3]);
-        OUTS_UPDATE_SZ(gen_header[4]);
-        OUTS_UPDATE_SZ(src_hw_info[0]);
-        OUTS_UPDATE_SZ(src_hw_info[1]);
-        OUTS_UPDATE_SZ(src_hw_info[2]);
-      }
+    const string bin = oss.str();
+    ofs.open(bin_path, ofstream::out | ofstream::trunc | ofstream::binary);
 
+    if (str_fmt_out) {
       string array_name = "Unknown_name_array";
       unsigned long last_slash = bin_path.rfind("/");
       unsigned long last_dot = bin_path.rfind(".");
@@ -218,19 +280,8 @@ void program_build_instance::serialize_program(void) throw(int)
       ofs << "#include <stddef.h>" << "\n";
       ofs << "char " << array_name << "[] = {" << "\n";
 
-      if(gen_pci_id){
-        sz = gbe_prog->serializeToBin(oss);
-        sz += header_sz;
-      }else{
-        char *llvm_binary;
-        size_t bin_length = gbe_program_serialize_to_binary((gbe_program)gbe_prog, &llvm_binary, 1);
-        oss.write(llvm_binary, bin_length);
-        sz += bin_length;
-        free(llvm_binary);
-      }
-
       for (size_t i = 0; i < sz; i++) {
-        unsigned char c = oss.str().c_str()[i];
+        unsigned char c = bin[i];
         char asic_str[9];
         sprintf(asic_str, "%2.2x", c);
         ofs << "0x";
@@ -241,51 +292,36 @@ void program_build_instance::serialize_program(void) throw(int)
       string array_size = array_name + "_size";
       ofs << "size_t " << array_size << " = " << sz << ";" << "\n";
     } else {
-      if(gen_pci_id){
-        //add header to differeciate from llvm bitcode binary.
-        // (5 bytes: 1 byte for binary version, 4 byte for bc code, 'GENC' is for gen binary.)
-        char gen_header[6] = "\1GENC";
-        OUTF_UPDATE_SZ(gen_header[0]);
-        OUTF_UPDATE_SZ(gen_header[1]);
-        OUTF_UPDATE_SZ(gen_header[2]);
-        OUTF_UPDATE_SZ(gen_header[3]);
-        OUTF_UPDATE_SZ(gen_header[4]);
-        OUTF_UPDATE_SZ(src_hw_info[0]);
-        OUTF_UPDATE_SZ(src_hw_info[1]);
-        OUTF_UPDATE_SZ(src_hw_info[2]);
-        sz = gbe_prog->serializeToBin(ofs);
-      }else{
-        char *llvm_binary;
-        size_t bin_length = gbe_program_serialize_to_binary((gbe_program)gbe_prog, &llvm_binary, 1);
-        ofs.write(llvm_binary, bin_length);
-        sz+=bin_length;
-        free(llvm_binary);
-      }
+      ofs.write(bin.c_str(), sz);
     }
 
     ofs.close();
-
-    if (!sz) {
-        throw FILE_SERIALIZATION_FAILED;
-    }
 }
 
 
 void program_build_instance::build_program(void) throw(int)
 {
-    gbe_program  opaque = NULL;
-    if(gen_pci_id){
-      opaque = gbe_program_new_from_source(gen_pci_id, code, 0, build_opt.c_str(), NULL, NULL);
-    }else{
-      opaque = gbe_program_compile_from_source(0, code, NULL, 0, build_opt.c_str(), NULL, NULL);
+    if(gen_pci_ids.empty()){
+      gbe_program opaque = gbe_program_compile_from_source(0, code, NULL, 0, build_opt.c_str(), NULL, NULL);
+      if (!opaque)
+          throw FILE_BUILD_FAILED;
+      gbe_prog = reinterpret_cast<gbe::Program*>(opaque);
+      return;
     }
-    if (!opaque)
-        throw FILE_BUILD_FAILED;
 
-    gbe_prog = reinterpret_cast<gbe::Program*>(opaque);
+    /* The targets are compiled one after the other: the backend shares its
+       llvm state between builds and only serializes them when llvm is not
+       multithreaded. */
+    gen_progs.assign(gen_pci_ids.size(), NULL);
+    for (size_t i = 0; i < gen_pci_ids.size(); i++) {
+      gbe_program opaque = gbe_program_new_from_source(gen_pci_ids[i], code, 0, build_opt.c_str(), NULL, NULL);
+      gen_progs[i] = reinterpret_cast<gbe::Program*>(opaque);
+    }
 
-    if(gen_pci_id){
-      assert(gbe_program_get_kernel_num(opaque));
+    for (auto prog : gen_progs) {
+      if (!prog)
+          throw FILE_BUILD_FAILED;
+      assert(gbe_program_get_kernel_num(reinterpret_cast<gbe_program>(prog)));
     }
 }
 
@@ -324,7 +360,7 @@ int main (int argc, const char **argv)
     deque<int> used_index;
 
     if (argc < 2) {
-        cout << "Usage: kernel_path [-pbuild_parameter] [-obin_path] [-tgen_pci_id]" << endl;
+        cout << "Usage: kernel_path [-pbuild_parameter] [-obin_path] [-tgen_pci_id[,gen_pci_id...]]" << endl;
         return 0;
     }
 
@@ -371,18 +407,25 @@ int main (int argc, const char **argv)
 
         case 't':
         {
-            char *s = optarg;
-            if (optarg[0] == '0' && (optarg[1] == 'x' || optarg[1] == 'X'))
-            s += 2;
-
-            if (s[0] < '0' || s[0] > '9') {
-                cout << "Invalid target option argument" << endl;
-                return 1;
+            /* Several targets may be given, comma separated or with several -t */
+            std::stringstream targets(optarg);
+            string target;
+            while (getline(targets, target, ',')) {
+                const char *s = target.c_str();
+                uint32_t gen_pci_id = 0;
+                if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+                s += 2;
+
+                if (s[0] < '0' || s[0] > '9') {
+                    cout << "Invalid target option argument" << endl;
+                    return 1;
+                }
+
+                std::stringstream str(s);
+                str >> std::hex >> gen_pci_id;
+                gen_pci_ids.push_back(gen_pci_id);
             }
 
-            std::stringstream str(s);
-            str >> std::hex >> gen_pci_id;
-
             used_index[optind-1] = 1;
             break;
         }
@@ -37,9 +37,12 @@ struct BinInterpCallBackInitializer
 {
   BinInterpCallBackInitializer() {
     gbe_program_new_from_binary = gbe::genProgramNewFromBinary;
+    gbe_program_match_binary = gbe::genProgramMatchBinary;
     gbe_program_get_kernel_num = gbe::programGetKernelNum;
     gbe_program_get_kernel_by_name = gbe::programGetKernelByName;
     gbe_program_get_kernel = gbe::programGetKernel;
+    gbe_program_get_kernel_name = gbe::programGetKernelName;
+    gbe_program_is_deferred = gbe::programIsDeferred;
     gbe_program_get_device_enqueue_kernel_name = gbe::programGetDeviceEnqueueKernelName;
     gbe_kernel_get_code_size = gbe::kernelGetCodeSize;
     gbe_kernel_get_code = gbe::kernelGetCode;
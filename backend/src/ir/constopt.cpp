@@ -22,6 +22,8 @@
 #include "ir/value.hpp"
 #include "ir/constopt.hpp"
 #include "sys/set.hpp"
+#include "sys/map.hpp"
+#include "sys/vector.hpp"
 
 namespace gbe {
 namespace ir {
@@ -140,5 +142,253 @@ namespace ir {
     folder.folding(functionName);
   }
 
+  /*! Fold the instructions whose sources are all immediates */
+  class ConstantFolder : public Context
+  {
+  public:
+    /*! Build the helper structure */
+    ConstantFolder(Unit &unit) : Context(unit), foldedNum(0) {}
+    /*! Fold the given function and return the number of folded instructions */
+    uint32_t folding(const std::string &name);
+
+  private:
+    /*! Count the definitions of every register (arguments, pushed and special
+     *  registers count as one definition)
+     */
+    void countDefinitions(void);
+    /*! Get the constant held by reg if it is only written by one LOADI */
+    bool getConstant(Register reg, Type &type, uint64_t &value) const;
+    /*! Try to fold one instruction. Return true if it was replaced */
+    bool fold(Instruction &insn);
+    /*! Replace insn by a LOADI of the given value */
+    void replaceByImmediate(Instruction &insn, Type type, uint64_t value);
+    vector<uint32_t> defNum;                               //!< Definitions per register
+    map<Register, std::pair<Type, uint64_t>> constants;    //!< Single-definition immediates
+    uint32_t foldedNum;                                    //!< Statistics
+  };
+
+  /*! Size in bits of the integer types we fold (0 if we do not fold it) */
+  static uint32_t getFoldBits(Type type) {
+    switch (type) {
+      case TYPE_BOOL: return 1;
+      case TYPE_S8: case TYPE_U8: return 8;
+      case TYPE_S16: case TYPE_U16: return 16;
+      case TYPE_S32: case TYPE_U32: return 32;
+      case TYPE_S64: case TYPE_U64: return 64;
+      default: return 0;
+    }
+  }
+
+  static bool isSignedFoldType(Type type) {
+    return type == TYPE_S8 || type == TYPE_S16 || type == TYPE_S32 || type == TYPE_S64;
+  }
+
+  /*! Normalize the value to the given type: truncate and sign extend */
+  static uint64_t normalize(Type type, uint64_t value) {
+    const uint32_t bits = getFoldBits(type);
+    if (bits == 64) return value;
+    const uint64_t mask = (1ull << bits) - 1ull;
+    value &= mask;
+    if (isSignedFoldType(type) && (value >> (bits - 1)))
+      value |= ~mask;
+    return value;
+  }
+
+  static Immediate makeImmediate(Type type, uint64_t value) {
+    switch (type) {
+      case TYPE_BOOL: return Immediate(bool(value != 0));
+      case TYPE_S8:   return Immediate(int8_t(value));
+      case TYPE_U8:   return Immediate(uint8_t(value));
+      case TYPE_S16:  return Immediate(int16_t(value));
+      case TYPE_U16:  return Immediate(uint16_t(value));
+      case TYPE_S32:  return Immediate(int32_t(value));
+      case TYPE_U32:  return Immediate(uint32_t(value));
+      case TYPE_S64:  return Immediate(int64_t(value));
+      default:        return Immediate(uint64_t(value));
+    }
+  }
+
+  void ConstantFolder::countDefinitions(void) {
+    defNum.clear();
+    defNum.resize(fn->regNum(), 0u);
+    for (uint32_t argID = 0; argID < fn->argNum(); ++argID)
+      defNum[fn->getArg(argID).reg]++;
+    for (const auto &pushed : fn->getPushMap())
+      defNum[pushed.first]++;
+    const uint32_t firstID = fn->getFirstSpecialReg();
+    for (uint32_t regID = firstID; regID < firstID + fn->getSpecialRegNum(); ++regID)
+      defNum[regID]++;
+    fn->foreachInstruction([&](Instruction &insn) {
+      for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID)
+        defNum[insn.getDst(dstID)]++;
+    });
+  }
+
+  bool ConstantFolder::getConstant(Register reg, Type &type, uint64_t &value) const {
+    auto it = constants.find(reg);
+    if (it == constants.end())
+      return false;
+    type = it->second.first;
+    value = it->second.second;
+    return true;
+  }
+
+  void ConstantFolder::replaceByImmediate(Instruction &insn, Type type, uint64_t value) {
+    const Register dst = insn.getDst(0);
+    const ImmediateIndex index = fn->newImmediate(makeImmediate(type, value));
+    const Instruction loadImm = ir::LOADI(type, dst, index);
+    loadImm.replace(&insn);
+    constants.insert(std::make_pair(dst, std::make_pair(type, normalize(type, value))));
+  }
+
+  bool ConstantFolder::fold(Instruction &insn) {
+    if (insn.getDstNum() != 1 || defNum[insn.getDst(0)] != 1)
+      return false;
+    const Opcode opcode = insn.getOpcode();
+
+    // A select with a known predicate is just a move of one of its sources
+    if (opcode == OP_SEL) {
+      Type predType;
+      uint64_t pred;
+      if (!getConstant(insn.getSrc(0), predType, pred))
+        return false;
+      const SelectInstruction &sel = cast<SelectInstruction>(insn);
+      const Register src = pred ? insn.getSrc(SelectInstruction::src0Index)
+                                : insn.getSrc(SelectInstruction::src1Index);
+      const Instruction mov = ir::MOV(sel.getType(), insn.getDst(0), src);
+      mov.replace(&insn);
+      return true;
+    }
+
+    Type type[2];
+    uint64_t src[2];
+    const uint32_t srcNum = insn.getSrcNum();
+    if (srcNum == 0 || srcNum > 2)
+      return false;
+    for (uint32_t srcID = 0; srcID < srcNum; ++srcID)
+      if (!getConstant(insn.getSrc(srcID), type[srcID], src[srcID]))
+        return false;
+
+    if (insn.isMemberOf<UnaryInstruction>()) {
+      const Type insnType = cast<UnaryInstruction>(insn).getType();
+      if (opcode != OP_MOV || getFoldBits(insnType) == 0)
+        return false;
+      replaceByImmediate(insn, insnType, normalize(insnType, src[0]));
+      return true;
+    }
+
+    if (opcode == OP_CVT) {
+      const ConvertInstruction &cvt = cast<ConvertInstruction>(insn);
+      const Type dstType = cvt.getDstType(), srcType = cvt.getSrcType();
+      if (getFoldBits(dstType) == 0 || getFoldBits(srcType) == 0)
+        return false;
+      if (dstType == TYPE_BOOL || srcType == TYPE_BOOL)
+        return false;
+      replaceByImmediate(insn, dstType, normalize(dstType, normalize(srcType, src[0])));
+      return true;
+    }
+
+    if (insn.isMemberOf<CompareInstruction>()) {
+      const Type cmpType = cast<CompareInstruction>(insn).getType();
+      if (getFoldBits(cmpType) == 0)
+        return false;
+      const uint64_t x = normalize(cmpType, src[0]), y = normalize(cmpType, src[1]);
+      const bool isSigned = isSignedFoldType(cmpType);
+      const bool lt = isSigned ? int64_t(x) < int64_t(y) : x < y;
+      bool result;
+      switch (opcode) {
+        case OP_EQ: result = x == y; break;
+        case OP_NE: result = x != y; break;
+        case OP_LT: result = lt; break;
+        case OP_LE: result = lt || x == y; break;
+        case OP_GT: result = !lt && x != y; break;
+        case OP_GE: result = !lt; break;
+        default: return false;
+      }
+      replaceByImmediate(insn, TYPE_BOOL, result);
+      return true;
+    }
+
+    if (insn.isMemberOf<BinaryInstruction>()) {
+      const Type insnType = cast<BinaryInstruction>(insn).getType();
+      const uint32_t bits = getFoldBits(insnType);
+      if (bits == 0)
+        return false;
+      const uint64_t x = normalize(insnType, src[0]), y = normalize(insnType, src[1]);
+      const bool isSigned = isSignedFoldType(insnType);
+      // Shift counts are masked by the hardware like any Gen shift
+      const uint32_t shift = uint32_t(y) & (bits == 64 ? 63 : 31);
+      uint64_t result;
+      if (insnType == TYPE_BOOL && opcode != OP_AND && opcode != OP_OR && opcode != OP_XOR)
+        return false;
+      switch (opcode) {
+        case OP_ADD: result = x + y; break;
+        case OP_SUB: result = x - y; break;
+        case OP_MUL: result = x * y; break;
+        case OP_AND: result = x & y; break;
+        case OP_OR:  result = x | y; break;
+        case OP_XOR: result = x ^ y; break;
+        case OP_SHL: result = shift >= bits ? 0 : x << shift; break;
+        case OP_SHR:
+          result = shift >= bits ? 0 : (x & (bits == 64 ? ~0ull : (1ull << bits) - 1ull)) >> shift;
+          break;
+        case OP_ASR:
+          result = uint64_t(int64_t(x) >> (shift >= bits ? bits - 1 : shift));
+          break;
+        case OP_DIV:
+        case OP_REM:
+          if (y == 0 || (isSigned && int64_t(y) == -1))
+            return false;
+          if (isSigned)
+            result = opcode == OP_DIV ? uint64_t(int64_t(x) / int64_t(y))
+                                      : uint64_t(int64_t(x) % int64_t(y));
+          else
+            result = opcode == OP_DIV ? x / y : x % y;
+          break;
+        default: return false;
+      }
+      replaceByImmediate(insn, insnType, normalize(insnType, result));
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t ConstantFolder::folding(const std::string &name) {
+    if ((this->fn = unit.getFunction(name)) == NULL)
+      return 0;
+
+    this->countDefinitions();
+    fn->foreachInstruction([&](Instruction &insn) {
+      if (insn.getOpcode() != OP_LOADI || defNum[insn.getDst(0)] != 1)
+        return;
+      const LoadImmInstruction &loadImm = cast<LoadImmInstruction>(insn);
+      const Immediate imm = loadImm.getImmediate();
+      const Type type = loadImm.getType();
+      if (imm.isCompType() || imm.getElemNum() != 1 || getFoldBits(type) == 0)
+        return;
+      constants.insert(std::make_pair(insn.getDst(0),
+                       std::make_pair(type, uint64_t(imm.getIntegerValue()))));
+    });
+
+    // Newly created immediates may feed instructions we already visited (loops
+    // carry uses upward), so iterate up to the fix point
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      fn->foreachInstruction([&](Instruction &insn) {
+        if (this->fold(insn)) {
+          foldedNum++;
+          changed = true;
+        }
+      });
+    }
+    return foldedNum;
+  }
+
+  uint32_t foldConstant(Unit &unit, const std::string &functionName) {
+    ConstantFolder folder(unit);
+    return folder.folding(functionName);
+  }
+
 } /* namespace ir */
 }
@@ -26,9 +26,14 @@ namespace ir {
   // Structure to update
   class Unit;
 
-  // TODO
-  void foldConstant(Unit &unit, const std::string &functionName);
-  void propagateConstant(Unit &unit, const std::string &functionName);
+  /*! Evaluate at compile time the integer ALU, compare and conversion
+   *  instructions whose sources are all loaded from immediates (LOADI with a
+   *  single definition) and replace them by a LOADI of the result. A SEL with
+   *  a constant predicate is replaced by a MOV of the selected source.
+   *  Folding is iterated so that chains of constants collapse. Returns the
+   *  number of folded instructions
+   */
+  uint32_t foldConstant(Unit &unit, const std::string &functionName);
 
   // for the following GEN IR, %41 is kernel argument (struct)
   // the first LOAD will be mov, and the second LOAD will be indirect move
@@ -51,4 +56,4 @@ namespace ir {
 } /* namespace ir */
 } /* namespace gbe */
 
-#endif /* __GBE_IR_LOWERING_HPP__ */
+#endif /* __GBE_IR_CONSTOPT_HPP__ */
@@ -0,0 +1,385 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file gvn.cpp
+ */
+#include <algorithm>
+#include <iostream>
+#include "ir/context.hpp"
+#include "ir/unit.hpp"
+#include "ir/value.hpp"
+#include "ir/liveness.hpp"
+#include "ir/constopt.hpp"
+#include "ir/gvn.hpp"
+#include "sys/cvar.hpp"
+#include "sys/map.hpp"
+#include "sys/vector.hpp"
+
+namespace gbe {
+namespace ir {
+
+  /*! Dominator tree computed on the reverse post order of the CFG with the
+   *  iterative algorithm of Cooper, Harvey and Kennedy
+   */
+  class DominatorTree
+  {
+  public:
+    /*! Compute the immediate dominators of all reachable blocks */
+    DominatorTree(const Function &fn);
+    /*! Blocks reachable from the entry in reverse post order */
+    INLINE const vector<BasicBlock*> &getRPO(void) const { return rpo; }
+    /*! Return true if a dominates b (both must be reachable) */
+    bool dominates(const BasicBlock *a, const BasicBlock *b) const;
+  private:
+    /*! Walk up the tree from both nodes up to their common dominator */
+    uint32_t intersect(uint32_t a, uint32_t b) const;
+    vector<BasicBlock*> rpo;                  //!< Reachable blocks
+    map<const BasicBlock*, uint32_t> order;   //!< Index of each block in rpo
+    vector<uint32_t> idom;                    //!< Immediate dominator per index
+    static const uint32_t undef = 0xffffffffu;
+  };
+
+  /*! Successors sorted by label to get a deterministic traversal */
+  static vector<BasicBlock*> getSortedSuccessors(const BasicBlock *bb) {
+    const BlockSet &succs = bb->getSuccessorSet();
+    vector<BasicBlock*> sorted(succs.begin(), succs.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const BasicBlock *a, const BasicBlock *b) {
+                return a->getLabelIndex() < b->getLabelIndex();
+              });
+    return sorted;
+  }
+
+  DominatorTree::DominatorTree(const Function &fn) {
+    if (fn.blockNum() == 0)
+      return;
+
+    // Iterative DFS to get the post order
+    vector<BasicBlock*> postOrder;
+    vector<std::pair<BasicBlock*, vector<BasicBlock*>>> stack;
+    set<const BasicBlock*> visited;
+    BasicBlock *entry = &fn.getTopBlock();
+    visited.insert(entry);
+    stack.push_back(std::make_pair(entry, getSortedSuccessors(entry)));
+    while (stack.empty() == false) {
+      auto &top = stack.back();
+      if (top.second.empty()) {
+        postOrder.push_back(top.first);
+        stack.pop_back();
+        continue;
+      }
+      BasicBlock *succ = top.second.front();
+      top.second.erase(top.second.begin());
+      if (visited.contains(succ))
+        continue;
+      visited.insert(succ);
+      stack.push_back(std::make_pair(succ, getSortedSuccessors(succ)));
+    }
+    rpo.assign(postOrder.rbegin(), postOrder.rend());
+    for (uint32_t i = 0; i < rpo.size(); ++i)
+      order.insert(std::make_pair(rpo[i], i));
+
+    // Iterate up to the fix point
+    idom.resize(rpo.size(), undef);
+    idom[0] = 0;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (uint32_t i = 1; i < rpo.size(); ++i) {
+        uint32_t newIdom = undef;
+        for (auto pred : rpo[i]->getPredecessorSet()) {
+          auto it = order.find(pred);
+          if (it == order.end() || idom[it->second] == undef)
+            continue;
+          newIdom = newIdom == undef ? it->second : intersect(it->second, newIdom);
+        }
+        if (newIdom != idom[i]) {
+          idom[i] = newIdom;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  uint32_t DominatorTree::intersect(uint32_t a, uint32_t b) const {
+    while (a != b) {
+      while (a > b) a = idom[a];
+      while (b > a) b = idom[b];
+    }
+    return a;
+  }
+
+  bool DominatorTree::dominates(const BasicBlock *a, const BasicBlock *b) const {
+    auto ita = order.find(a), itb = order.find(b);
+    if (ita == order.end() || itb == order.end())
+      return false;
+    uint32_t node = itb->second;
+    while (node > ita->second)
+      node = idom[node];
+    return node == ita->second;
+  }
+
+  /*! Count the definitions of every register. Function arguments, pushed
+   *  and special registers are implicitly defined once at the entry
+   */
+  static void countDefinitions(const Function &fn, vector<uint32_t> &defNum) {
+    defNum.clear();
+    defNum.resize(fn.regNum(), 0u);
+    for (uint32_t argID = 0; argID < fn.argNum(); ++argID)
+      defNum[fn.getArg(argID).reg]++;
+    for (const auto &pushed : fn.getPushMap())
+      defNum[pushed.first]++;
+    const uint32_t firstID = fn.getFirstSpecialReg();
+    for (uint32_t regID = firstID; regID < firstID + fn.getSpecialRegNum(); ++regID)
+      defNum[regID]++;
+    fn.foreachInstruction([&](const Instruction &insn) {
+      for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID)
+        defNum[insn.getDst(dstID)]++;
+    });
+  }
+
+  /*! Registers that are visible outside of the instruction stream */
+  static bool isPinnedRegister(const Function &fn, Register reg) {
+    if (fn.isSpecialReg(reg) || fn.getRegisterData(reg).isPayloadType())
+      return true;
+    if (fn.getArg(reg) != NULL)
+      return true;
+    for (uint32_t outID = 0; outID < fn.outputNum(); ++outID)
+      if (fn.getOutput(outID) == reg)
+        return true;
+    return false;
+  }
+
+  /*! Number redundant pure instructions */
+  class ValueNumbering : public Context
+  {
+  public:
+    /*! Build the helper structure */
+    ValueNumbering(Unit &unit) : Context(unit), removedNum(0) {}
+    /*! Number the given function and return the number of removed instructions */
+    uint32_t numbering(const std::string &name);
+  private:
+    /*! Opcode, types and sources of an instruction */
+    typedef vector<uint32_t> Key;
+    /*! Build the key of a numberable instruction. Return false otherwise */
+    bool buildKey(const Instruction &insn, Key &key) const;
+    /*! Replace the sources that were renamed by the numbering */
+    void renameSources(Instruction &insn) const;
+    vector<uint32_t> defNum;                  //!< Definitions per register
+    map<Register, Register> renamed;          //!< Removed dst -> kept dst
+    map<Key, vector<Instruction*>> available; //!< Already seen expressions
+    uint32_t removedNum;                      //!< Statistics
+  };
+
+  bool ValueNumbering::buildKey(const Instruction &insn, Key &key) const {
+    const Opcode opcode = insn.getOpcode();
+    if (insn.getDstNum() != 1)
+      return false;
+    // Cross lane operations depend on the execution mask where they run
+    if (opcode == OP_SIMD_ANY || opcode == OP_SIMD_ALL)
+      return false;
+
+    key.push_back(opcode);
+    if (insn.isMemberOf<UnaryInstruction>())
+      key.push_back(cast<UnaryInstruction>(insn).getType());
+    else if (insn.isMemberOf<BinaryInstruction>())
+      key.push_back(cast<BinaryInstruction>(insn).getType());
+    else if (insn.isMemberOf<TernaryInstruction>())
+      key.push_back(cast<TernaryInstruction>(insn).getType());
+    else if (insn.isMemberOf<SelectInstruction>())
+      key.push_back(cast<SelectInstruction>(insn).getType());
+    else if (insn.isMemberOf<CompareInstruction>())
+      key.push_back(cast<CompareInstruction>(insn).getType());
+    else if (insn.isMemberOf<ConvertInstruction>()) {
+      key.push_back(cast<ConvertInstruction>(insn).getDstType());
+      key.push_back(cast<ConvertInstruction>(insn).getSrcType());
+    } else
+      return false;
+
+    const Register dst = insn.getDst(0);
+    if (defNum[dst] != 1 || isPinnedRegister(*fn, dst))
+      return false;
+    const uint32_t srcNum = insn.getSrcNum();
+    for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
+      const Register src = insn.getSrc(srcID);
+      if (defNum[src] != 1)
+        return false;
+      key.push_back(src.value());
+    }
+    if (insn.isMemberOf<BinaryInstruction>() &&
+        cast<BinaryInstruction>(insn).commutes() &&
+        key[key.size() - 2] > key[key.size() - 1])
+      std::swap(key[key.size() - 2], key[key.size() - 1]);
+    return true;
+  }
+
+  void ValueNumbering::renameSources(Instruction &insn) const {
+    const uint32_t srcNum = insn.getSrcNum();
+    for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
+      auto it = renamed.find(insn.getSrc(srcID));
+      if (it != renamed.end())
+        insn.setSrc(srcID, it->second);
+    }
+  }
+
+  uint32_t ValueNumbering::numbering(const std::string &name) {
+    if ((this->fn = unit.getFunction(name)) == NULL)
+      return 0;
+
+    countDefinitions(*fn, defNum);
+    const DominatorTree domTree(*fn);
+
+    // Dominators are visited first in reverse post order, so the first
+    // available dominating expression is always already recorded
+    for (auto bb : domTree.getRPO()) {
+      bb->foreach([&](Instruction &insn) {
+        this->renameSources(insn);
+        Key key;
+        if (this->buildKey(insn, key) == false)
+          return;
+        const Register dst = insn.getDst(0);
+        const RegisterData dstData = fn->getRegisterData(dst);
+        vector<Instruction*> &exprs = available[key];
+        for (auto expr : exprs) {
+          const Register value = expr->getDst(0);
+          const RegisterData valueData = fn->getRegisterData(value);
+          if (valueData.family != dstData.family ||
+              valueData.isUniform() != dstData.isUniform())
+            continue;
+          if (domTree.dominates(expr->getParent(), bb) == false)
+            continue;
+          renamed.insert(std::make_pair(dst, value));
+          insn.remove();
+          removedNum++;
+          return;
+        }
+        exprs.push_back(&insn);
+      });
+    }
+
+    // Uses reached through loop back edges were visited before their
+    // definition was renamed
+    if (removedNum != 0)
+      fn->foreachInstruction([&](Instruction &insn) { this->renameSources(insn); });
+    return removedNum;
+  }
+
+  /*! Remove the instructions that produce unused values */
+  class DeadCodeEliminator : public Context
+  {
+  public:
+    /*! Build the helper structure */
+    DeadCodeEliminator(Unit &unit) : Context(unit), removedNum(0) {}
+    /*! Eliminate dead code and return the number of removed instructions */
+    uint32_t eliminate(const std::string &name);
+  private:
+    /*! Pure instructions only write their destinations */
+    bool isRemovable(const Instruction &insn) const;
+    uint32_t removedNum; //!< Statistics
+  };
+
+  bool DeadCodeEliminator::isRemovable(const Instruction &insn) const {
+    if (insn.hasSideEffect() || insn.getDstNum() == 0)
+      return false;
+    if (!insn.isMemberOf<NullaryInstruction>() &&
+        !insn.isMemberOf<UnaryInstruction>() &&
+        !insn.isMemberOf<BinaryInstruction>() &&
+        !insn.isMemberOf<TernaryInstruction>() &&
+        !insn.isMemberOf<SelectInstruction>() &&
+        !insn.isMemberOf<CompareInstruction>() &&
+        !insn.isMemberOf<ConvertInstruction>() &&
+        !insn.isMemberOf<BitCastInstruction>() &&
+        !insn.isMemberOf<LoadImmInstruction>() &&
+        !insn.isMemberOf<SimdShuffleInstruction>())
+      return false;
+    for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID)
+      if (isPinnedRegister(*fn, insn.getDst(dstID)))
+        return false;
+    return true;
+  }
+
+  uint32_t DeadCodeEliminator::eliminate(const std::string &name) {
+    if ((this->fn = unit.getFunction(name)) == NULL)
+      return 0;
+
+    Liveness liveness(*fn);
+    FunctionDAG dag(liveness);
+
+    // Number of uses reached by the definitions of each removable instruction
+    map<const Instruction*, uint32_t> useNum;
+    vector<Instruction*> deadInsns;
+    fn->foreachInstruction([&](Instruction &insn) {
+      if (this->isRemovable(insn) == false)
+        return;
+      uint32_t uses = 0;
+      for (uint32_t dstID = 0; dstID < insn.getDstNum(); ++dstID)
+        uses += dag.getUse(&insn, dstID).size();
+      useNum.insert(std::make_pair(&insn, uses));
+      if (uses == 0)
+        deadInsns.push_back(&insn);
+    });
+
+    // Removing an instruction releases the uses of the values it reads
+    while (deadInsns.empty() == false) {
+      Instruction *insn = deadInsns.back();
+      deadInsns.pop_back();
+      const uint32_t srcNum = insn->getSrcNum();
+      for (uint32_t srcID = 0; srcID < srcNum; ++srcID) {
+        for (auto def : dag.getDef(insn, srcID)) {
+          if (def->getType() != ValueDef::DEF_INSN_DST)
+            continue;
+          auto it = useNum.find(def->getInstruction());
+          if (it == useNum.end() || it->second == 0)
+            continue;
+          if (--it->second == 0)
+            deadInsns.push_back(const_cast<Instruction*>(def->getInstruction()));
+        }
+      }
+      insn->remove();
+      removedNum++;
+    }
+    return removedNum;
+  }
+
+  uint32_t valueNumbering(Unit &unit, const std::string &functionName) {
+    ValueNumbering gvn(unit);
+    return gvn.numbering(functionName);
+  }
+
+  uint32_t eliminateDeadCode(Unit &unit, const std::string &functionName) {
+    DeadCodeEliminator dce(unit);
+    return dce.eliminate(functionName);
+  }
+
+  BVAR(OCL_OUTPUT_GEN_IR_OPT, false);
+
+  ScalarOptStatistics optimizeScalar(Unit &unit, const std::string &functionName) {
+    ScalarOptStatistics stats;
+    stats.folded = foldConstant(unit, functionName);
+    stats.numbered = valueNumbering(unit, functionName);
+    stats.dead = eliminateDeadCode(unit, functionName);
+    if (OCL_OUTPUT_GEN_IR_OPT)
+      std::cout << "Gen IR optimization of " << functionName << ": "
+                << stats.folded << " folded, "
+                << stats.numbered << " redundant, "
+                << stats.dead << " dead instructions removed" << std::endl;
+    return stats;
+  }
+
+} /* namespace ir */
+} /* namespace gbe */
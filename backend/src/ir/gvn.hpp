@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file gvn.hpp
+ *  Redundancy elimination on Gen IR. Scalarization, large integer expansion,
+ *  integer promotion and the phi copies of the GenWriter all introduce
+ *  redundant computations after the LLVM optimizations ran. The passes here
+ *  clean them up before instruction selection.
+ */
+
+#ifndef __GBE_IR_GVN_HPP__
+#define __GBE_IR_GVN_HPP__
+
+#include <string>
+#include "sys/platform.hpp"
+
+namespace gbe {
+namespace ir {
+
+  // Structure to update
+  class Unit;
+
+  /*! Global value numbering. Gen IR is not in strict SSA form (phis are
+   *  lowered to copies), so we only number instructions whose destination and
+   *  sources are written once in the function. A pure instruction is replaced
+   *  by an identical one located in a dominating position; all the uses of its
+   *  destination are renamed. Immediate loads are left alone: they are cheaper
+   *  to rematerialize than to keep alive across blocks. Returns the number of
+   *  removed instructions
+   */
+  uint32_t valueNumbering(Unit &unit, const std::string &functionName);
+
+  /*! Remove the pure instructions whose definitions reach no use. The DU
+   *  chains of the FunctionDAG drive a work list so that whole dead
+   *  expression trees go away. Returns the number of removed instructions
+   */
+  uint32_t eliminateDeadCode(Unit &unit, const std::string &functionName);
+
+  /*! Number of instructions removed by each scalar optimization */
+  struct ScalarOptStatistics {
+    ScalarOptStatistics(void) : folded(0), numbered(0), dead(0) {}
+    uint32_t folded;   //!< Instructions replaced by an immediate or a move
+    uint32_t numbered; //!< Redundant instructions removed by the GVN
+    uint32_t dead;     //!< Dead instructions removed
+  };
+
+  /*! Run constant folding, value numbering and dead code elimination on the
+   *  function. Statistics are printed with OCL_OUTPUT_GEN_IR_OPT
+   */
+  ScalarOptStatistics optimizeScalar(Unit &unit, const std::string &functionName);
+
+} /* namespace ir */
+} /* namespace gbe */
+
+#endif /* __GBE_IR_GVN_HPP__ */
@@ -189,19 +189,24 @@ namespace gbe
       }
     }
 
-    void PrintfSet::outputPrintf(void* buf_addr)
+    uint32_t PrintfSet::outputPrintf(void* buf_addr, uint32_t buf_size)
     {
       LockOutput lock;
       uint32_t totalSZ = ((uint32_t *)buf_addr)[0];
       char* p = (char*)buf_addr + sizeof(uint32_t);
+      uint32_t parsed = 4;
 
-      for (uint32_t parsed = 4; parsed < totalSZ; ) {
+      // A log only partly written at the end of the buffer is lost too
+      while (parsed < totalSZ && parsed + 3 * sizeof(uint32_t) <= buf_size) {
         PrintfLog log(p);
+        if (parsed + log.size > buf_size)
+          break;
         GBE_ASSERT(fmts.find(log.statementNum) != fmts.end());
         printOutOneStatement(fmts[log.statementNum], log);
         parsed += log.size;
         p += log.size;
       }
+      return totalSZ > parsed ? totalSZ - parsed : 0;
     }
   } /* namespace ir */
 } /* namespace gbe */
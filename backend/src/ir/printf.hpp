@@ -243,7 +243,10 @@ namespace gbe
         return 0;
       }
 
-      void outputPrintf(void* buf_addr);
+      /*! Print the logs of the buffer in their order. The kernels keep on
+       *  bumping the length when the buffer is full: returns the number of
+       *  bytes which did not fit */
+      uint32_t outputPrintf(void* buf_addr, uint32_t buf_size);
 
     private:
       std::map<uint32_t, PrintfFmt> fmts;
@@ -33,14 +33,67 @@
     *(dst + offset * DST_STRIDE) = *(src + offset * SRC_STRIDE); \
   return 0;
 
+/* Contiguous copies move 16 or 4 bytes per access when both pointers allow
+ * it. Each work item issues four loads before the matching stores so that
+ * their latencies overlap. */
+#define COPY_CHUNKS(CHUNK) \
+  { \
+    DST_SPACE CHUNK *d = (DST_SPACE CHUNK *)dst; \
+    const SRC_SPACE CHUNK *s = (const SRC_SPACE CHUNK *)src; \
+    size_t n = bytes / sizeof(CHUNK); \
+    size_t i = lid; \
+    for(; i + 3 * wg_size < n; i += 4 * wg_size) { \
+      CHUNK c0 = s[i]; \
+      CHUNK c1 = s[i + wg_size]; \
+      CHUNK c2 = s[i + 2 * wg_size]; \
+      CHUNK c3 = s[i + 3 * wg_size]; \
+      d[i] = c0; \
+      d[i + wg_size] = c1; \
+      d[i + 2 * wg_size] = c2; \
+      d[i + 3 * wg_size] = c3; \
+    } \
+    for(; i < n; i += wg_size) \
+      d[i] = s[i]; \
+    done = n * sizeof(CHUNK); \
+  }
+
+#define COPY_BYTES(NAME) \
+static INLINE void NAME(DST_SPACE char *dst, const SRC_SPACE char *src, size_t bytes) \
+{ \
+  size_t wg_size = get_local_size(2) * get_local_size(1) * get_local_size(0); \
+  size_t lid = get_local_linear_id(); \
+  size_t done = 0; \
+  if((((size_t)dst | (size_t)src) & 15) == 0) \
+    COPY_CHUNKS(uint4) \
+  else if((((size_t)dst | (size_t)src) & 3) == 0) \
+    COPY_CHUNKS(uint) \
+  for(size_t i = done + lid; i < bytes; i += wg_size) \
+    dst[i] = src[i]; \
+}
+
+#define DST_SPACE local
+#define SRC_SPACE global
+COPY_BYTES(__gen_async_copy_to_local)
+#undef DST_SPACE
+#undef SRC_SPACE
+#define DST_SPACE global
+#define SRC_SPACE local
+COPY_BYTES(__gen_async_copy_to_global)
+#undef DST_SPACE
+#undef SRC_SPACE
+#undef COPY_BYTES
+#undef COPY_CHUNKS
+
 #define DEFN(TYPE) \
 OVERLOADABLE event_t async_work_group_copy (local TYPE *dst,  const global TYPE *src, \
 							 size_t num, event_t event) { \
-  BODY(1, 1); \
+  __gen_async_copy_to_local((local char *)dst, (const global char *)src, num * sizeof(TYPE)); \
+  return 0; \
 } \
 OVERLOADABLE event_t async_work_group_copy (global TYPE *dst,  const local TYPE *src, \
 							  size_t num, event_t event) { \
-  BODY(1, 1); \
+  __gen_async_copy_to_global((global char *)dst, (const local char *)src, num * sizeof(TYPE)); \
+  return 0; \
 } \
 OVERLOADABLE event_t async_work_group_strided_copy (local TYPE *dst,  const global TYPE *src, \
 								 size_t num, size_t src_stride, event_t event) { \
@@ -70,8 +123,22 @@ OVERLOADABLE void wait_group_events (int num_events, event_t *event_list) {
   barrier(CLK_LOCAL_MEM_FENCE | CLK_GLOBAL_MEM_FENCE);
 }
 
+/* Touch the 64 bytes cache line of the start of the range with a volatile
+ * read which nothing waits for, so it is brought to the caches while the work
+ * item goes on. One line per work item keeps the hint cheap; the work items of
+ * a group usually prefetch neighbouring ranges. */
+static INLINE void __gen_prefetch(const global char *p, size_t bytes)
+{
+  if(bytes == 0)
+    return;
+  const volatile global uint *line = (const volatile global uint *)((size_t)p & ~(size_t)63);
+  (void)*line;
+}
+
 #define DEFN(TYPE) \
-OVERLOADABLE void prefetch(const global TYPE *p, size_t num) { }
+OVERLOADABLE void prefetch(const global TYPE *p, size_t num) { \
+  __gen_prefetch((const global char *)p, num * sizeof(TYPE)); \
+}
 #define DEF(TYPE) \
 DEFN(TYPE); DEFN(TYPE##2); DEFN(TYPE##3); DEFN(TYPE##4); DEFN(TYPE##8); DEFN(TYPE##16)
 DEF(char);
@@ -17,10 +17,25 @@
  */
 #include "ocl_memset.h"
 
+/* Like memcpy, 16 bytes aligned destinations are filled with vector stores */
 #define DECL_MEMSET_FN(NAME, DST_SPACE) \
 void __gen_memset_ ##NAME## _align (DST_SPACE uchar* dst, uchar val, size_t size) { \
   size_t index = 0; \
   uint v = (val << 24) | (val << 16) | (val << 8) | val; \
+  if(((size_t)dst & 15) == 0) { \
+    uint4 v4 = (uint4)(v); \
+    while((index + 64) <= size) { \
+      *((DST_SPACE uint4 *)(dst + index)) = v4; \
+      *((DST_SPACE uint4 *)(dst + index + 16)) = v4; \
+      *((DST_SPACE uint4 *)(dst + index + 32)) = v4; \
+      *((DST_SPACE uint4 *)(dst + index + 48)) = v4; \
+      index += 64; \
+    } \
+    while((index + 16) <= size) { \
+      *((DST_SPACE uint4 *)(dst + index)) = v4; \
+      index += 16; \
+    } \
+  } \
   while((index + 4) <= size) { \
     *((DST_SPACE uint *)(dst + index)) = v; \
     index += 4; \
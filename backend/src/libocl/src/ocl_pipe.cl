@@ -27,30 +27,115 @@
 #define PIPE_RESERVE_FAIL -5
 #define RID_MAGIC 0xDE
 #define RIDT ushort
-#define DEAD_PTR 0xFFFFFFFF
 
 PURE CONST __global void* __gen_ocl_get_pipe(pipe int p);
 PURE CONST ulong __gen_ocl_get_rid(reserve_id_t rid);
 PURE CONST reserve_id_t __gen_ocl_make_rid(ulong rid);
 
+/* Header: pheader[0] is the number of packets, pheader[1] the packet size,
+ * pheader[2] and pheader[3] the write and read pointers and pheader[6] the
+ * number of packets in the pipe. */
+
+/* Take up to num packets from the pipe, returns how many were taken */
+static INLINE int __pipe_take_packets(__global int* pheader, int num)
+{
+  int data_size = atomic_sub(pheader + 6, num);
+  int taken = data_size < 0 ? 0 : (data_size < num ? data_size : num);
+  if(taken < num)
+    atomic_add(pheader + 6, num - taken);
+  return taken;
+}
+
+/* Take up to num free slots in the pipe, returns how many were taken */
+static INLINE int __pipe_take_slots(__global int* pheader, int num)
+{
+  int pack_num = pheader[0];
+  int data_size = atomic_add(pheader + 6, num);
+  int free_size = pack_num - data_size;
+  int taken = free_size < 0 ? 0 : (free_size < num ? free_size : num);
+  if(taken < num)
+    atomic_sub(pheader + 6, num - taken);
+  return taken;
+}
+
+/* Move a read or write pointer by num packets and return the first slot. The
+ * pointer is brought back by pack_num each time it goes over a multiple of it
+ * so that it never overflows. */
+static INLINE int __pipe_advance(__global int* ptr, int num, int pack_num)
+{
+  int slot = atomic_add(ptr, num) % pack_num;
+  int wraps = (slot + num) / pack_num;
+  if(wraps)
+    atomic_sub(ptr, wraps * pack_num);
+  return slot;
+}
+
+/* Reserve num packets or slots at once, returns the first slot or -1 */
+static INLINE int __pipe_reserve(__global int* pheader, int num, bool read)
+{
+  int pack_num = pheader[0];
+  int taken = read ? __pipe_take_packets(pheader, num) : __pipe_take_slots(pheader, num);
+  if(taken < num){
+    if(taken)
+      atomic_add(pheader + 6, read ? taken : -taken);
+    return -1;
+  }
+  return __pipe_advance(pheader + (read ? 3 : 2), num, pack_num);
+}
+
+/* Copy a packet with 16 or 4 bytes moves when the alignment allows it */
+static INLINE void __pipe_copy(__generic char* dst, const __generic char* src, int size)
+{
+  int i = 0;
+  if(((size_t)dst & 15) == 0 && ((size_t)src & 15) == 0)
+    for(; i + 16 <= size; i += 16)
+      *(__generic uint4*)(dst + i) = *(const __generic uint4*)(src + i);
+  if(((size_t)dst & 3) == 0 && ((size_t)src & 3) == 0)
+    for(; i + 4 <= size; i += 4)
+      *(__generic uint*)(dst + i) = *(const __generic uint*)(src + i);
+  for(; i < size; i++)
+    dst[i] = src[i];
+}
+
+/* Build the reserve id of num packets starting at slot, slot < 0 means the
+ * reservation failed */
+static INLINE reserve_id_t __pipe_make_rid(int slot, uint num)
+{
+  ulong uid = 0l;
+  RIDT* pid = (RIDT*)&uid;
+  if(slot < 0)
+    return __gen_ocl_make_rid(0l);
+  pid[0] = slot;
+  pid[1] = num;
+  pid[2] = RID_MAGIC ;
+  return __gen_ocl_make_rid(uid);
+}
+
+/* read_pipe and write_pipe of the active lanes of a sub group are served by
+ * a single reservation done by the first active lane. The lanes which do not
+ * get a packet or a slot fail. */
 int __read_pipe_2(pipe int p, __generic void* dst)
 {
   __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-  int data_size = atomic_sub(pheader + 6, 1);
-  if(data_size < 0){
-    atomic_add(pheader + 6, 1);
-    return PIPE_EMPTY; //Check if element exist
-  }
   __global char* psrc = (__global char*)pheader + PIPE_HEADER_SZ;
   int pack_num = pheader[0];
   int pack_size = pheader[1];
-  int pipe_size = pack_num * pack_size;
-  int read_ptr = atomic_add(pheader + 3, 1);
-  if(read_ptr == pack_num - 1)
-    atomic_sub(pheader + 3, pack_num);
-  read_ptr = read_ptr % pack_num;
-  for(int i = 0; i < pack_size ; i++)
-    ((char*)dst)[i] = psrc[i + read_ptr*pack_size];
+  uint lane = get_sub_group_local_id();
+  uint leader = sub_group_reduce_min(lane);
+  int active = sub_group_reduce_add(1);
+  int rank = sub_group_scan_exclusive_add(1);
+  int taken = 0, slot = 0;
+  if(lane == leader){
+    taken = __pipe_take_packets(pheader, active);
+    if(taken)
+      slot = __pipe_advance(pheader + 3, taken, pack_num);
+  }
+  taken = sub_group_broadcast(taken, leader);
+  slot = sub_group_broadcast(slot, leader);
+  if(rank >= taken)
+    return PIPE_EMPTY;
+  slot = (slot + rank) % pack_num;
+  __pipe_copy((__generic char*)dst, psrc + slot * pack_size, pack_size);
   return 0;
 }
 
@@ -67,8 +152,7 @@ int __read_pipe_4(pipe int p, reserve_id_t id, uint index, void* dst)
   int pack_size = pheader[1];
   int read_ptr = (start_pt + index) % pack_num;
   int offset = read_ptr * pack_size;
-  for(int i = 0; i < pack_size ; i++)
-    ((char*)dst)[i] = psrc[i + offset];
+  __pipe_copy((__generic char*)dst, psrc + offset, pack_size);
   return 0;
 }
 
@@ -76,21 +160,25 @@ int __read_pipe_4(pipe int p, reserve_id_t id, uint index, void* dst)
 int __write_pipe_2(pipe int p, __generic void* src)
 {
   __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-  int pack_num = pheader[0];
-  int data_size = atomic_add(pheader + 6, 1);
-  if(data_size >= pack_num){
-    atomic_sub(pheader + 6, 1);
-    return PIPE_FULL; //Check if pipe full
-  }
   __global char* psrc = (__global char*)pheader + PIPE_HEADER_SZ;
+  int pack_num = pheader[0];
   int pack_size = pheader[1];
-  int pipe_size = pack_num * pack_size;
-  int write_ptr = atomic_add(pheader + 2, 1);
-  if(write_ptr == pack_num - 1)
-    atomic_sub(pheader + 2, pack_num);
-  write_ptr = write_ptr % pack_num;
-  for(int i = 0; i < pack_size ; i++)
-    psrc[i + write_ptr * pack_size] = ((char*)src)[i];
+  uint lane = get_sub_group_local_id();
+  uint leader = sub_group_reduce_min(lane);
+  int active = sub_group_reduce_add(1);
+  int rank = sub_group_scan_exclusive_add(1);
+  int taken = 0, slot = 0;
+  if(lane == leader){
+    taken = __pipe_take_slots(pheader, active);
+    if(taken)
+      slot = __pipe_advance(pheader + 2, taken, pack_num);
+  }
+  taken = sub_group_broadcast(taken, leader);
+  slot = sub_group_broadcast(slot, leader);
+  if(rank >= taken)
+    return PIPE_FULL;
+  slot = (slot + rank) % pack_num;
+  __pipe_copy(psrc + slot * pack_size, (__generic char*)src, pack_size);
   return 0;
 }
 
@@ -107,88 +195,40 @@ int __write_pipe_4(pipe int p, reserve_id_t id, uint index, void* src)
   int pack_size = pheader[1];
   int write_ptr = (start_pt + index) % pack_num;
   int offset = write_ptr * pack_size;
-  for(int i = 0; i < pack_size ; i++)
-    psrc[i + offset] = ((char*)src)[i];
+  __pipe_copy(psrc + offset, (__generic char*)src, pack_size);
   return pack_size;
 }
 
 reserve_id_t __reserve_read_pipe(pipe int p, uint num)
 {
   __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-  int data_size = atomic_sub(pheader + 6, num);
-  if(data_size < num){
-    atomic_add(pheader + 6, num);
-    return __gen_ocl_make_rid(0l);
-  }
-  int pack_num = pheader[0];
-  int pack_size = pheader[1];
-  int pipe_size = pack_num * pack_size;
-  int read_ptr = atomic_add(pheader + 3, num);
-  if(read_ptr == pack_num - num)
-    atomic_sub(pheader + 3, pack_num);
-  ulong uid = 0l;
-  RIDT* pid = (RIDT*)&uid;
-  pid[0] = read_ptr % pack_num;
-  pid[1] = num;
-  pid[2] = RID_MAGIC ;
-  return __gen_ocl_make_rid(uid);
+  return __pipe_make_rid(__pipe_reserve(pheader, num, true), num);
 }
 
 void __commit_read_pipe(pipe int p, reserve_id_t rid) {}
 
 reserve_id_t __work_group_reserve_read_pipe(pipe int p, uint num)
 {
-  uint rid_ptr = DEAD_PTR;
-  int ret0 = 0;
+  int slot = -1;
   if(get_local_linear_id()==0){
     __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-    int data_size = atomic_sub(pheader + 6, num);
-    if(data_size < num){
-      atomic_add(pheader + 6, num);
-      int ret0 = 1;
-    }
-    int pack_num = pheader[0];
-    int pack_size = pheader[1];
-    int pipe_size = pack_num * pack_size;
-    int read_ptr = atomic_add(pheader + 3, num);
-    if(read_ptr == pack_num - num && !ret0)
-      atomic_sub(pheader + 3, pack_num);
-    if(!ret0)
-      rid_ptr = read_ptr % pack_num;
+    slot = __pipe_reserve(pheader, num, true);
   }
-  ulong uid = 0l;
-  RIDT* pid = (RIDT*)&uid;
-  rid_ptr = work_group_broadcast(rid_ptr,0,0,0);
-  pid[0] = rid_ptr;
-  pid[1] = num;
-  pid[2] = RID_MAGIC ;
-  if(rid_ptr == DEAD_PTR)
-    uid = 0l;
-  return __gen_ocl_make_rid(uid);
+  slot = work_group_broadcast(slot,0,0,0);
+  return __pipe_make_rid(slot, num);
 }
 
 void __work_group_commit_read_pipe(pipe int p, reserve_id_t rid) {}
 
 reserve_id_t __sub_group_reserve_read_pipe(pipe int p, uint num)
 {
-  __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-  int data_size = atomic_sub(pheader + 6, num);
-  if(data_size < num){
-    atomic_add(pheader + 6, num);
-    return __gen_ocl_make_rid(0l);
+  int slot = -1;
+  if(get_sub_group_local_id()==0){
+    __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
+    slot = __pipe_reserve(pheader, num, true);
   }
-  int pack_num = pheader[0];
-  int pack_size = pheader[1];
-  int pipe_size = pack_num * pack_size;
-  int read_ptr = atomic_add(pheader + 3, num);
-  if(read_ptr == pack_num - num)
-    atomic_sub(pheader + 3, pack_num);
-  ulong uid = 0l;
-  RIDT* pid = (RIDT*)&uid;
-  pid[0] = read_ptr % pack_num;
-  pid[1] = num;
-  pid[2] = RID_MAGIC ;
-  return __gen_ocl_make_rid(uid);
+  slot = sub_group_broadcast(slot, 0);
+  return __pipe_make_rid(slot, num);
 }
 
 void __sub_group_commit_read_pipe(pipe int p, reserve_id_t rid) {}
@@ -196,79 +236,32 @@ void __sub_group_commit_read_pipe(pipe int p, reserve_id_t rid) {}
 reserve_id_t __reserve_write_pipe(pipe int p, uint num)
 {
   __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-  int pack_num = pheader[0];
-  int data_size = atomic_add(pheader + 6, num);
-  if(data_size > pack_num - num){
-    atomic_sub(pheader + 6, num);
-    return __gen_ocl_make_rid(0l);
-  }
-  int pack_size = pheader[1];
-  int pipe_size = pack_num * pack_size;
-  int write_ptr = atomic_add(pheader + 2, num);
-  if(write_ptr == pack_num - num)
-    atomic_sub(pheader + 2, pack_num);
-  ulong uid = 0l;
-  RIDT* pid = (RIDT*)&uid;
-  pid[0] = write_ptr % pack_num;
-  pid[1] = num;
-  pid[2] = RID_MAGIC ;
-  return __gen_ocl_make_rid(uid);
+  return __pipe_make_rid(__pipe_reserve(pheader, num, false), num);
 }
 void __commit_write_pipe(pipe int p, reserve_id_t rid) {}
 
 reserve_id_t __work_group_reserve_write_pipe(pipe int p, uint num)
 {
-  uint rid_ptr = DEAD_PTR;
-  int ret0 = 0;
+  int slot = -1;
   if(get_local_linear_id()==0){
     __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-    int pack_num = pheader[0];
-    int data_size = atomic_add(pheader + 6, num);
-    if(data_size > pack_num - num){
-      atomic_sub(pheader + 6, num);
-      ret0 = 1;
-    }
-    int pack_size = pheader[1];
-    int pipe_size = pack_num * pack_size;
-    int write_ptr = atomic_add(pheader + 2, num);
-    if(write_ptr == pack_num - num && !ret0)
-      atomic_sub(pheader + 2, pack_num);
-    if(!ret0)
-      rid_ptr = write_ptr % pack_num;
+    slot = __pipe_reserve(pheader, num, false);
   }
-  ulong uid = 0l;
-  RIDT* pid = (RIDT*)&uid;
-  rid_ptr = work_group_broadcast(rid_ptr,0,0,0);
-  pid[0] = rid_ptr;
-  pid[1] = num;
-  pid[2] = RID_MAGIC ;
-  if(rid_ptr == DEAD_PTR)
-    uid = 0l;
-  return __gen_ocl_make_rid(uid);
+  slot = work_group_broadcast(slot,0,0,0);
+  return __pipe_make_rid(slot, num);
 }
 void __work_group_commit_write_pipe(pipe int p, reserve_id_t rid) {}
 
 
 reserve_id_t __sub_group_reserve_write_pipe(pipe int p, uint num)
 {
-  __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
-  int pack_num = pheader[0];
-  int data_size = atomic_add(pheader + 6, num);
-  if(data_size > pack_num - num){
-    atomic_sub(pheader + 6, num);
-    return __gen_ocl_make_rid(0l);
+  int slot = -1;
+  if(get_sub_group_local_id()==0){
+    __global int* pheader = (__global int*)__gen_ocl_get_pipe(p);
+    slot = __pipe_reserve(pheader, num, false);
   }
-  int pack_size = pheader[1];
-  int pipe_size = pack_num * pack_size;
-  int write_ptr = atomic_add(pheader + 2, num);
-  if(write_ptr == pack_num - num)
-    atomic_sub(pheader + 2, pack_num);
-  ulong uid = 0l;
-  RIDT* pid = (RIDT*)&uid;
-  pid[0] = write_ptr % pack_num;
-  pid[1] = num;
-  pid[2] = RID_MAGIC ;
-  return __gen_ocl_make_rid(uid);
+  slot = sub_group_broadcast(slot, 0);
+  return __pipe_make_rid(slot, num);
 }
 
 void __sub_group_commit_write_pipe(pipe int p, reserve_id_t rid) {}
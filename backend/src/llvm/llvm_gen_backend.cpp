@@ -79,6 +79,7 @@
 #include "ir/half.hpp"
 #include "ir/liveness.hpp"
 #include "ir/value.hpp"
+#include "ir/gvn.hpp"
 #include "sys/set.hpp"
 #include "sys/cvar.hpp"
 #include "backend/program.h"
@@ -2948,6 +2949,7 @@ namespace gbe
 
   BVAR(OCL_OPTIMIZE_PHI_MOVES, true);
   BVAR(OCL_OPTIMIZE_LOADI, true);
+  BVAR(OCL_OPTIMIZE_GEN_IR, true);
 
   static const Instruction *getInstructionUseLocal(const Value *v) {
     // Local variable can only be used in one kernel function. So, if we find
@@ -3250,6 +3252,9 @@ namespace gbe
       this->postPhiCopyOptimization(liveness, fn, replaceMap, redundantPhiCopyMap);
       this->removeMOVs(liveness, fn);
     }
+    // Clean up what scalarization, legalization and the phi copies left
+    if (OCL_OPTIMIZE_GEN_IR)
+      ir::optimizeScalar(unit, fn.getName());
   }
 
   void GenWriter::regAllocateReturnInst(ReturnInst &I) {}
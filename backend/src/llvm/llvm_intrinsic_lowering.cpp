@@ -89,6 +89,83 @@ namespace gbe {
         CI->eraseFromParent();
         return NewCI;
       }
+      /*! Constant size memcpy and memset up to this many moves are expanded
+       *  inline instead of calling the libocl loops */
+      enum { MAX_INLINE_MOVES = 16 };
+      /*! Widest move allowed by the alignment: <4 x i32>, <2 x i32>, i32,
+       *  i16 or i8 */
+      static uint32_t getMoveSize(uint64_t align, uint64_t remaining) {
+        uint32_t size = 16;
+        while (size > 1 && (align % size != 0 || remaining < size))
+          size /= 2;
+        return size;
+      }
+      static Type *getMoveType(LLVMContext &Context, uint32_t size) {
+        switch (size) {
+          case 16: return VectorType::get(Type::getInt32Ty(Context), 4);
+          case 8: return VectorType::get(Type::getInt32Ty(Context), 2);
+          case 4: return Type::getInt32Ty(Context);
+          case 2: return Type::getInt16Ty(Context);
+          default: return Type::getInt8Ty(Context);
+        }
+      }
+      static uint32_t getMoveNum(uint64_t align, uint64_t size) {
+        uint32_t num = 0;
+        for (uint64_t offset = 0; offset < size; ++num)
+          offset += getMoveSize(align, size - offset);
+        return num;
+      }
+      static Value *getMovePtr(IRBuilder<> &Builder, Value *ptr, uint64_t offset, Type *ty) {
+        const uint32_t space = ptr->getType()->getPointerAddressSpace();
+        LLVMContext &Context = ptr->getContext();
+        Value *bytes = Builder.CreateBitCast(ptr, Type::getInt8PtrTy(Context, space));
+        if (offset != 0)
+          bytes = Builder.CreateConstGEP1_32(bytes, offset);
+        return Builder.CreateBitCast(bytes, ty->getPointerTo(space));
+      }
+      /*! Expand a small memcpy of a constant size into unrolled wide moves.
+       *  All the loads are issued before the stores */
+      static bool expandMemCpy(IRBuilder<> &Builder, CallInst *CI, uint64_t size, uint64_t align) {
+        if (size == 0 || getMoveNum(align, size) > MAX_INLINE_MOVES)
+          return false;
+        LLVMContext &Context = CI->getContext();
+        Value *dst = CI->getArgOperand(0), *src = CI->getArgOperand(1);
+        SmallVector<std::pair<uint64_t, Value *>, MAX_INLINE_MOVES> values;
+        for (uint64_t offset = 0; offset < size; ) {
+          const uint32_t moveSize = getMoveSize(align, size - offset);
+          Type *ty = getMoveType(Context, moveSize);
+          Value *ld = Builder.CreateAlignedLoad(getMovePtr(Builder, src, offset, ty), moveSize);
+          values.push_back(std::make_pair(offset, ld));
+          offset += moveSize;
+        }
+        for (auto &v : values)
+          Builder.CreateAlignedStore(v.second, getMovePtr(Builder, dst, v.first, v.second->getType()),
+                                     getMoveSize(align, size - v.first));
+        return true;
+      }
+      /*! Same for memset. The byte is replicated in each move */
+      static bool expandMemSet(IRBuilder<> &Builder, CallInst *CI, Value *val, uint64_t size, uint64_t align) {
+        if (size == 0 || getMoveNum(align, size) > MAX_INLINE_MOVES)
+          return false;
+        LLVMContext &Context = CI->getContext();
+        Value *dst = CI->getArgOperand(0);
+        Value *v32 = Builder.CreateMul(Builder.CreateZExt(val, Type::getInt32Ty(Context)),
+                                       ConstantInt::get(Type::getInt32Ty(Context), 0x01010101));
+        for (uint64_t offset = 0; offset < size; ) {
+          const uint32_t moveSize = getMoveSize(align, size - offset);
+          Type *ty = getMoveType(Context, moveSize);
+          Value *v;
+          if (moveSize > 4)
+            v = Builder.CreateVectorSplat(moveSize / 4, v32);
+          else if (moveSize == 4)
+            v = v32;
+          else
+            v = Builder.CreateTrunc(v32, ty);
+          Builder.CreateAlignedStore(v, getMovePtr(Builder, dst, offset, ty), moveSize);
+          offset += moveSize;
+        }
+        return true;
+      }
       virtual bool runOnBasicBlock(BasicBlock &BB)
       {
         bool changedBlock = false;
@@ -116,6 +193,14 @@ namespace gbe {
                 Value *align = Builder.CreateIntCast(CI->getArgOperand(3), IntPtr,
                                                     /* isSigned */ false);
                 ConstantInt *ci = dyn_cast<ConstantInt>(align);
+                ConstantInt *csize = dyn_cast<ConstantInt>(Size);
+                ConstantInt *isVolatile = dyn_cast<ConstantInt>(CI->getArgOperand(4));
+                if (ci && csize && isVolatile && isVolatile->isZero() &&
+                    expandMemCpy(Builder, CI, csize->getZExtValue(), std::max<uint64_t>(ci->getZExtValue(), 1))) {
+                  CI->eraseFromParent();
+                  changedBlock = true;
+                  break;
+                }
                 Value *Ops[3];
                 Ops[0] = CI->getArgOperand(0);
                 Ops[1] = CI->getArgOperand(1);
@@ -138,6 +223,14 @@ namespace gbe {
                 Value *align = Builder.CreateIntCast(CI->getArgOperand(3), IntPtr,
                                                     /* isSigned */ false);
                 ConstantInt *ci = dyn_cast<ConstantInt>(align);
+                ConstantInt *csize = dyn_cast<ConstantInt>(Size);
+                ConstantInt *isVolatile = dyn_cast<ConstantInt>(CI->getArgOperand(4));
+                if (ci && csize && isVolatile && isVolatile->isZero() &&
+                    expandMemSet(Builder, CI, val, csize->getZExtValue(), std::max<uint64_t>(ci->getZExtValue(), 1))) {
+                  CI->eraseFromParent();
+                  changedBlock = true;
+                  break;
+                }
                 Value *Ops[3];
                 Ops[0] = Op0;
                 // Extend the amount to i32.
@@ -1,3 +1,4 @@
+#include <string.h>
 #include "utests/utest_helper.hpp"
 #include <sys/time.h>
 
@@ -48,3 +49,40 @@ double benchmark_read_buffer(void)
 }
 
 MAKE_BENCHMARK_FROM_FUNCTION(benchmark_read_buffer, "GB/S");
+
+/* Host side transfers. Run with different OCL_PARALLEL_COPY_THRESHOLD values
+ * to find from which size splitting the copies across threads pays off */
+double benchmark_enqueue_read_write_buffer(void)
+{
+  struct timeval start,stop;
+  double best = 0;
+
+  for (size_t sz = 256 * 1024; sz <= 256 * 1024 * 1024; sz *= 4) {
+    const int iter = sz < 16 * 1024 * 1024 ? 100 : 10;
+    char *host = (char *)malloc(sz);
+    memset(host, 1, sz);
+    OCL_CREATE_BUFFER(buf[0], 0, sz, NULL);
+
+    gettimeofday(&start,0);
+    for (int i = 0; i < iter; i++) {
+      OCL_CALL (clEnqueueWriteBuffer, queue, buf[0], CL_FALSE, 0, sz, host, 0, NULL, NULL);
+      OCL_CALL (clEnqueueReadBuffer, queue, buf[0], CL_FALSE, 0, sz, host, 0, NULL, NULL);
+    }
+    OCL_FINISH();
+    gettimeofday(&stop,0);
+
+    double elapsed = time_subtract(&stop, &start, 0);
+    double bw = BANDWIDTH(sz * 2 * iter, elapsed);
+    printf("  %8zu KB: %.2f GB/S\n", sz / 1024, bw);
+    if (bw > best)
+      best = bw;
+
+    clReleaseMemObject(buf[0]);
+    buf[0] = NULL;
+    free(host);
+  }
+
+  return best;
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_enqueue_read_write_buffer, "GB/S");
@@ -0,0 +1,88 @@
+#include <string.h>
+#include <stdlib.h>
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+
+#define IMAGE_BPP 4
+
+/* Host reads and writes of a tiled image. OCL_CPU_TILING=0 makes them go
+ * through the GTT mapping instead of the software (de)tiling */
+static double read_write_image(bool cpu_tiling)
+{
+  struct timeval start,stop;
+  const size_t w = 1920;
+  const size_t h = 1080;
+  const size_t sz = IMAGE_BPP * w * h;
+  cl_image_format format;
+  cl_image_desc desc;
+
+  memset(&desc, 0x0, sizeof(cl_image_desc));
+  memset(&format, 0x0, sizeof(cl_image_format));
+
+  if (cpu_tiling)
+    unsetenv("OCL_CPU_TILING");
+  else
+    setenv("OCL_CPU_TILING", "0", 1);
+
+  buf_data[0] = malloc(sz);
+  buf_data[1] = malloc(sz);
+  for (uint32_t i = 0; i < w*h; ++i)
+    ((uint32_t*)buf_data[0])[i] = rand();
+
+  format.image_channel_order = CL_RGBA;
+  format.image_channel_data_type = CL_UNSIGNED_INT8;
+  desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+  desc.image_width = w;
+  desc.image_height = h;
+  OCL_CREATE_IMAGE(buf[0], 0, &format, &desc, NULL);
+
+  size_t origin[3] = {0, 0, 0};
+  size_t region[3] = {w, h, 1};
+
+  /* A partial region to check the tile borders */
+  size_t sub_origin[3] = {13, 7, 0};
+  size_t sub_region[3] = {w - 29, h - 45, 1};
+  OCL_CALL (clEnqueueWriteImage, queue, buf[0], CL_TRUE, origin, region,
+            0, 0, buf_data[0], 0, NULL, NULL);
+  OCL_CALL (clEnqueueReadImage, queue, buf[0], CL_TRUE, sub_origin, sub_region,
+            w * IMAGE_BPP, 0, buf_data[1], 0, NULL, NULL);
+  for (uint32_t y = 0; y < sub_region[1]; ++y)
+    for (uint32_t x = 0; x < sub_region[0]; ++x)
+      OCL_ASSERT(((uint32_t*)buf_data[1])[y * w + x] ==
+                 ((uint32_t*)buf_data[0])[(y + sub_origin[1]) * w + x + sub_origin[0]]);
+
+  gettimeofday(&start,0);
+  for (uint32_t i=0; i<100; i++) {
+    OCL_CALL (clEnqueueWriteImage, queue, buf[0], CL_FALSE, origin, region,
+              0, 0, buf_data[0], 0, NULL, NULL);
+    OCL_CALL (clEnqueueReadImage, queue, buf[0], CL_FALSE, origin, region,
+              0, 0, buf_data[1], 0, NULL, NULL);
+  }
+  OCL_FINISH();
+  gettimeofday(&stop,0);
+
+  OCL_ASSERT(memcmp(buf_data[0], buf_data[1], sz) == 0);
+  unsetenv("OCL_CPU_TILING");
+  free(buf_data[0]);
+  buf_data[0] = NULL;
+  free(buf_data[1]);
+  buf_data[1] = NULL;
+
+  double elapsed = time_subtract(&stop, &start, 0);
+
+  return BANDWIDTH(sz * 2 * 100, elapsed);
+}
+
+double benchmark_read_write_image_cpu_tiling(void)
+{
+  return read_write_image(true);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_read_write_image_cpu_tiling, "GB/S");
+
+double benchmark_read_write_image_gtt(void)
+{
+  return read_write_image(false);
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_read_write_image_gtt, "GB/S");
@@ -0,0 +1,54 @@
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+
+/* Latency of small clEnqueueCopyBuffer and clEnqueueFillBuffer, each one
+ * waited for, in thousands of operations per second. Run once with
+ * OCL_HOST_COPY_THRESHOLD=0 and once with a large value: the threshold is
+ * the largest size for which the CPU wins */
+#define BENCH_SMALL_TRANSFER(SZ) \
+double benchmark_small_copy_buffer_ ##SZ(void) \
+{ \
+  struct timeval start,stop; \
+  const size_t loop = 1000; \
+ \
+  OCL_CREATE_BUFFER(buf[0], 0, SZ, NULL); \
+  OCL_CREATE_BUFFER(buf[1], 0, SZ, NULL); \
+ \
+  gettimeofday(&start,0); \
+  for (size_t i=0; i<loop; i++) { \
+    OCL_CALL(clEnqueueCopyBuffer, queue, buf[0], buf[1], 0, 0, SZ, 0, NULL, NULL); \
+    OCL_FINISH(); \
+  } \
+  gettimeofday(&stop,0); \
+ \
+  double elapsed = time_subtract(&stop, &start, 0); \
+  return (double)loop / elapsed; \
+} \
+ \
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_small_copy_buffer_ ##SZ, "Kop/s"); \
+ \
+double benchmark_small_fill_buffer_ ##SZ(void) \
+{ \
+  struct timeval start,stop; \
+  const size_t loop = 1000; \
+  const uint32_t pattern = 0x5a5a5a5a; \
+ \
+  OCL_CREATE_BUFFER(buf[0], 0, SZ, NULL); \
+ \
+  gettimeofday(&start,0); \
+  for (size_t i=0; i<loop; i++) { \
+    OCL_CALL(clEnqueueFillBuffer, queue, buf[0], &pattern, sizeof(pattern), 0, SZ, 0, NULL, NULL); \
+    OCL_FINISH(); \
+  } \
+  gettimeofday(&stop,0); \
+ \
+  double elapsed = time_subtract(&stop, &start, 0); \
+  return (double)loop / elapsed; \
+} \
+ \
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_small_fill_buffer_ ##SZ, "Kop/s");
+
+BENCH_SMALL_TRANSFER(256)
+BENCH_SMALL_TRANSFER(4096)
+BENCH_SMALL_TRANSFER(16384)
+BENCH_SMALL_TRANSFER(65536)
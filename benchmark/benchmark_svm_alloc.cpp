@@ -0,0 +1,54 @@
+#include "utests/utest_helper.hpp"
+#include <sys/time.h>
+#include <stdlib.h>
+
+/* clSVMAlloc/clSVMFree rate for small allocations, in millions of
+ * alloc/free pairs per second. Half of the allocations stay alive, as in a
+ * linked data structure being built */
+static double svm_alloc_rate(const char *slab)
+{
+  struct timeval start, stop;
+  const int n = 4096, rounds = 16;
+  void *ptrs[n];
+  cl_int err;
+
+  setenv("OCL_SVM_SLAB_ALLOC", slab, 1);
+  cl_context c = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+
+  gettimeofday(&start, 0);
+  for (int r = 0; r < rounds; ++r) {
+    for (int i = 0; i < n; ++i) {
+      ptrs[i] = clSVMAlloc(c, CL_MEM_READ_WRITE, 16 << (i % 8), 0);
+      OCL_ASSERT(ptrs[i] != NULL);
+    }
+    for (int i = 0; i < n; i += 2)
+      clSVMFree(c, ptrs[i]);
+    for (int i = 1; i < n; i += 2)
+      clSVMFree(c, ptrs[i]);
+  }
+  gettimeofday(&stop, 0);
+
+  clReleaseContext(c);
+  unsetenv("OCL_SVM_SLAB_ALLOC");
+
+  double elapsed = time_subtract(&stop, &start, 0);
+  return (double)n * rounds / (elapsed * 1000);
+}
+
+double benchmark_svm_alloc(void)
+{
+  if (!cl_check_ocl20(false))
+    return 0;
+  return svm_alloc_rate("0");
+}
+
+double benchmark_svm_slab_alloc(void)
+{
+  if (!cl_check_ocl20(false))
+    return 0;
+  return svm_alloc_rate("1");
+}
+
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_svm_alloc, "Mop/s");
+MAKE_BENCHMARK_FROM_FUNCTION(benchmark_svm_slab_alloc, "Mop/s");
@@ -0,0 +1,43 @@
+/* Contiguous copies of any size and alignment: the bytes are staged in local
+ * memory and written back at another offset */
+kernel void
+compiler_async_copy_odd_uchar(global uchar *dst, global const uchar *src, local uchar *l,
+                              int num, int src_off, int dst_off)
+{
+  event_t e = async_work_group_copy(l, src + src_off, (size_t)num, 0);
+  wait_group_events(1, &e);
+  e = async_work_group_copy(dst + dst_off, l, (size_t)num, 0);
+  wait_group_events(1, &e);
+}
+
+kernel void
+compiler_async_copy_odd_uint(global uint *dst, global const uint *src, local uint *l,
+                             int num, int src_off, int dst_off)
+{
+  event_t e = async_work_group_copy(l, src + src_off, (size_t)num, 0);
+  wait_group_events(1, &e);
+  e = async_work_group_copy(dst + dst_off, l, (size_t)num, 0);
+  wait_group_events(1, &e);
+}
+
+/* Gather with src_stride then scatter with dst_stride */
+kernel void
+compiler_async_copy_odd_strided(global short *dst, global const short *src, local short *l,
+                                int num, int src_stride, int dst_stride)
+{
+  event_t e = async_work_group_strided_copy(l, src, (size_t)num, (size_t)src_stride, 0);
+  wait_group_events(1, &e);
+  e = async_work_group_strided_copy(dst, l, (size_t)num, (size_t)dst_stride, 0);
+  wait_group_events(1, &e);
+}
+
+/* prefetch is a hint: the data read afterwards is unchanged */
+kernel void
+compiler_async_copy_odd_prefetch(global int *dst, global const int *src, int num)
+{
+  int gid = get_global_id(0);
+  prefetch(src + gid * num, (size_t)num);
+  prefetch(src + gid * num, 0);
+  for (int i = 0; i < num; i++)
+    dst[gid * num + i] = src[gid * num + i] + 1;
+}
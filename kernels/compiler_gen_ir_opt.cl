@@ -0,0 +1,12 @@
+__kernel void
+compiler_gen_ir_opt(__global long *dst, __global const int2 *src, int n)
+{
+  int gid = get_global_id(0);
+  int2 v = src[gid];
+  long a = (long)v.x * v.y + gid;
+  long b = (long)v.y * v.x + gid;
+  long acc = (long)(3 * 5) << 2;
+  for (int i = 0; i < n; i++)
+    acc += ((long)v.x * v.y) >> (i & 7);
+  dst[gid] = a + b + acc;
+}
@@ -0,0 +1,33 @@
+/* Vector packing: the bytes and words of one dword are written one by one */
+kernel void
+compiler_partial_write_chain_pack(global uint *dst, global const uint *src)
+{
+  int id = get_global_id(0);
+  uint x = src[id];
+  uchar4 b = (uchar4)((uchar)(x >> 3), (uchar)(x * 7), (uchar)(x >> 17) ^ (uchar)0x5a, (uchar)(x + 11));
+  short2 h = (short2)((short)(x >> 9), (short)(x * 3));
+  dst[2 * id] = as_uint(b);
+  dst[2 * id + 1] = as_uint(h);
+}
+
+/* Strided packing: the even and the odd bytes are written apart */
+kernel void
+compiler_partial_write_chain_strided(global uchar *dst, global const uchar *src)
+{
+  int id = get_global_id(0);
+  uchar16 v = vload16(id, src);
+  uchar16 r;
+  r.even = v.odd + (uchar)1;
+  r.odd = v.even ^ (uchar)0xff;
+  vstore16(r, id, dst);
+}
+
+/* Uniform setup: scalar values written next to each other */
+kernel void
+compiler_partial_write_chain_uniform(global uint *dst, uint k)
+{
+  uint g = get_group_id(0);
+  uint4 u = (uint4)(g * 3 + k, g ^ k, g + 5, k * 7);
+  uint l = get_local_id(0);
+  dst[get_global_id(0)] = u.s0 * l + u.s1 + (u.s2 << 4) + u.s3 * (l & 3);
+}
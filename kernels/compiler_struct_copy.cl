@@ -0,0 +1,21 @@
+typedef struct { float4 v; int i[5]; char c[3]; } big_t;
+typedef struct { char c[13]; } odd_t;
+
+__kernel void
+compiler_struct_copy(__global big_t *dst, __global const big_t *src,
+                     __global odd_t *odst, __global const odd_t *osrc,
+                     __global int *sum)
+{
+  int id = (int)get_global_id(0);
+  big_t b = src[id];
+  b.i[id % 5] += 1;
+  dst[id] = b;
+
+  odd_t o = osrc[id];
+  o.c[id % 13] = 0;
+  odst[id] = o;
+
+  int a[24] = {0};
+  a[id % 24] = id;
+  sum[id] = a[id % 24] + a[(id + 1) % 24];
+}
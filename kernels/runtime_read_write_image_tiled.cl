@@ -0,0 +1,7 @@
+kernel void
+runtime_read_write_image_tiled(read_only image2d_t src, global uint *dst, int w)
+{
+  int2 coord = (int2)((int)get_global_id(0), (int)get_global_id(1));
+  uint4 c = read_imageui(src, coord);
+  dst[coord.y * w + coord.x] = c.x | (c.y << 8) | (c.z << 16) | (c.w << 24);
+}
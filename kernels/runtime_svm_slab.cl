@@ -0,0 +1,7 @@
+kernel void
+runtime_svm_slab(global int *p, int n)
+{
+  int i = get_global_id(0);
+  if (i < n)
+    p[i] += i;
+}
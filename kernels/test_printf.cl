@@ -90,3 +90,8 @@ test_printf_4(void)
     printf("@@ Long result is %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d\n",
 	   a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p, q, r, s, t);
 }
+
+kernel void test_printf_overflow(void)
+{
+  printf("%d\n", (int)get_global_id(0));
+}
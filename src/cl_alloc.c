@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <malloc.h>
+#include <string.h>
 
 static volatile int32_t cl_alloc_n = 0;
 
@@ -86,3 +87,67 @@ cl_report_set_all_freed(void)
   cl_alloc_n = 0;
 }
 
+
+LOCAL void
+cl_free_list_init(cl_free_list *list, size_t elem_size, uint32_t max)
+{
+  assert(elem_size >= sizeof(void *));
+  pthread_spin_init(&list->lock, PTHREAD_PROCESS_PRIVATE);
+  list->head = NULL;
+  list->elem_size = elem_size;
+  list->num = 0;
+  list->max = max;
+}
+
+LOCAL void
+cl_free_list_destroy(cl_free_list *list)
+{
+  void *p;
+
+  while (list->head) {
+    p = list->head;
+    list->head = *(void **)p;
+    cl_free(p);
+  }
+  list->num = 0;
+  pthread_spin_destroy(&list->lock);
+}
+
+LOCAL void*
+cl_free_list_get(cl_free_list *list)
+{
+  void *p;
+
+  pthread_spin_lock(&list->lock);
+  p = list->head;
+  if (p) {
+    list->head = *(void **)p;
+    list->num--;
+  }
+  pthread_spin_unlock(&list->lock);
+
+  if (p == NULL)
+    return cl_calloc(1, list->elem_size);
+
+  memset(p, 0, list->elem_size);
+  return p;
+}
+
+LOCAL void
+cl_free_list_put(cl_free_list *list, void *ptr)
+{
+  if (ptr == NULL)
+    return;
+
+  pthread_spin_lock(&list->lock);
+  if (list->num < list->max) {
+    *(void **)ptr = list->head;
+    list->head = ptr;
+    list->num++;
+    ptr = NULL;
+  }
+  pthread_spin_unlock(&list->lock);
+
+  if (ptr)
+    cl_free(ptr);
+}
@@ -22,6 +22,8 @@
 
 #include "cl_internals.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
 
 /* Return a valid pointer for the requested memory block size */
 extern void *cl_malloc(size_t sz);
@@ -43,5 +45,28 @@ extern void  cl_free(void *ptr);
  */
 extern size_t cl_report_unfreed(void);
 
+/* Free list of fixed size blocks. The objects created and destroyed on every
+ * enqueue (events, their callback records) are recycled through it instead of
+ * going back to malloc. The lock is only held to link or unlink one block.
+ */
+typedef struct _cl_free_list {
+  pthread_spinlock_t lock;
+  void *head;                 /* Singly linked through the first word of each block */
+  size_t elem_size;           /* Size of the blocks, at least a pointer */
+  uint32_t num;               /* Blocks currently on the list */
+  uint32_t max;               /* Blocks beyond this go back to cl_free */
+} cl_free_list;
+
+extern void cl_free_list_init(cl_free_list *list, size_t elem_size, uint32_t max);
+
+/* Release all the cached blocks */
+extern void cl_free_list_destroy(cl_free_list *list);
+
+/* Zeroed block, recycled when the list is not empty */
+extern void *cl_free_list_get(cl_free_list *list);
+
+/* Give a block back to the list */
+extern void cl_free_list_put(cl_free_list *list, void *ptr);
+
 #endif /* __CL_ALLOC_H__ */
 
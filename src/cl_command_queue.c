@@ -34,12 +34,14 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static cl_command_queue
 cl_command_queue_new(cl_context ctx)
 {
   cl_command_queue queue = NULL;
+  const char *env;
 
   assert(ctx);
   queue = cl_calloc(1, sizeof(_cl_command_queue));
@@ -47,6 +49,13 @@ cl_command_queue_new(cl_context ctx)
     return NULL;
 
   CL_OBJECT_INIT_BASE(queue, CL_OBJECT_COMMAND_QUEUE_MAGIC);
+
+  /* OCL_PRINTF_BUFFER_SIZE fixes the printf buffer size the launches start
+   * with instead of guessing it from the global size */
+  env = getenv("OCL_PRINTF_BUFFER_SIZE");
+  if (env != NULL)
+    sscanf(env, "%u", &queue->printf_size);
+
   if (cl_command_queue_init_enqueue(queue) != CL_SUCCESS) {
     cl_free(queue);
     return NULL;
@@ -90,6 +99,8 @@ cl_command_queue_delete(cl_command_queue queue)
   cl_command_queue_destroy_enqueue(queue);
 
   cl_mem_delete(queue->perf);
+  if (queue->printf_buf)
+    cl_buffer_unreference(queue->printf_buf);
   if (queue->barrier_events) {
     cl_free(queue->barrier_events);
   }
@@ -103,6 +114,86 @@ cl_command_queue_add_ref(cl_command_queue queue)
   CL_OBJECT_INC_REF(queue);
 }
 
+#define CL_PRINTF_MAX_SIZE (64 * 1024 * 1024)
+
+/* The launches take their printf buffer one after the other in a bo kept by
+ * the queue. It starts over once the output of all of them is printed, so
+ * that the bo is allocated once. When the launches in flight fill it, the
+ * new one gets a bo of its own. */
+LOCAL int
+cl_command_queue_bind_printf_buffer(cl_command_queue queue, cl_gpgpu gpgpu, uint32_t size, uint8_t bti)
+{
+  cl_buffer bo = NULL;
+  uint32_t offset = 0;
+  int ret;
+
+  CL_OBJECT_LOCK(queue);
+  size = ALIGN(MAX(size, queue->printf_min_size), 64);
+  if (queue->printf_users == 0) {
+    queue->printf_head = 0;
+    if (queue->printf_buf_size < size) {
+      if (queue->printf_buf)
+        cl_buffer_unreference(queue->printf_buf);
+      queue->printf_buf_size = ALIGN(size, 4096);
+      queue->printf_buf = cl_buffer_alloc(cl_context_get_bufmgr(queue->ctx), "Printf buffer",
+                                          queue->printf_buf_size, 4096);
+      if (queue->printf_buf == NULL)
+        queue->printf_buf_size = 0;
+    }
+  }
+  if (queue->printf_buf && queue->printf_head + size <= queue->printf_buf_size) {
+    bo = queue->printf_buf;
+    cl_buffer_reference(bo);
+    offset = queue->printf_head;
+    queue->printf_head += size;
+    queue->printf_users++;
+  }
+  CL_OBJECT_UNLOCK(queue);
+
+  if (bo == NULL)
+    bo = cl_buffer_alloc(cl_context_get_bufmgr(queue->ctx), "Printf buffer", size, 4096);
+  if (bo == NULL)
+    return -1;
+  ret = cl_gpgpu_set_printf_buffer(gpgpu, bo, offset, size, bti);
+  cl_buffer_unreference(bo);
+  return ret;
+}
+
+LOCAL void
+cl_command_queue_finish_printf(cl_command_queue queue, cl_gpgpu gpgpu, cl_bool output)
+{
+  void* printf_info = cl_gpgpu_get_printf_info(gpgpu);
+  cl_buffer bo = cl_gpgpu_get_printf_buffer(gpgpu);
+  uint32_t size = 0, lost = 0;
+  void *addr;
+
+  if (printf_info == NULL)
+    return;
+
+  if (bo && interp_get_printf_num(printf_info)) {
+    if (output) {
+      addr = cl_gpgpu_map_printf_buffer(gpgpu, &size);
+      lost = interp_output_printf(printf_info, addr, size);
+      cl_gpgpu_unmap_printf_buffer(gpgpu);
+    }
+
+    CL_OBJECT_LOCK(queue);
+    if (bo == queue->printf_buf && queue->printf_users)
+      queue->printf_users--;
+    /* The next launches get twice what this one needed */
+    if (lost)
+      queue->printf_min_size = MIN(MAX((uint64_t)queue->printf_min_size, 2 * ((uint64_t)size + lost)),
+                                   CL_PRINTF_MAX_SIZE);
+    CL_OBJECT_UNLOCK(queue);
+
+    if (lost)
+      fprintf(stderr, "Beignet: printf buffer overflow, %u bytes of output lost\n", lost);
+  }
+
+  interp_release_printf_info(printf_info);
+  cl_gpgpu_set_printf_info(gpgpu, NULL);
+}
+
 static void
 set_image_info(char *curbe,
                struct ImageInfo * image_info,
@@ -232,6 +323,9 @@ cl_command_queue_bind_exec_info(cl_command_queue queue, cl_kernel k, cl_gpgpu gp
 extern cl_int cl_command_queue_ND_range_gen7(cl_command_queue, cl_kernel, cl_event, 
                                              uint32_t, const size_t *, const size_t *,const size_t *,
                                              const size_t *, const size_t *, const size_t *);
+extern cl_int cl_command_queue_build_ND_range_gen7(cl_command_queue, cl_kernel, cl_gpgpu,
+                                                   uint32_t, const size_t *, const size_t *,const size_t *,
+                                                   const size_t *, const size_t *, const size_t *);
 
 static cl_int
 cl_kernel_check_args(cl_kernel k)
@@ -277,25 +371,38 @@ error:
   return err;
 }
 
-LOCAL int
-cl_command_queue_flush_gpgpu(cl_gpgpu gpgpu)
+LOCAL cl_int
+cl_command_queue_build_ND_range(cl_command_queue queue,
+                                cl_kernel k,
+                                cl_gpgpu gpgpu,
+                                const uint32_t work_dim,
+                                const size_t *global_wk_off,
+                                const size_t *global_dim_off,
+                                const size_t *global_wk_sz,
+                                const size_t *global_wk_sz_use,
+                                const size_t *local_wk_sz,
+                                const size_t *local_wk_sz_use)
 {
-  void* printf_info = cl_gpgpu_get_printf_info(gpgpu);
-  void* profiling_info;
+  const int32_t ver = cl_driver_get_ver(queue->ctx->drv);
+  cl_int err = CL_SUCCESS;
 
-  if (cl_gpgpu_flush(gpgpu) < 0)
-    return CL_OUT_OF_RESOURCES;
+  TRY (cl_kernel_check_args, k);
 
-  if (printf_info && interp_get_printf_num(printf_info)) {
-    void *addr = cl_gpgpu_map_printf_buffer(gpgpu);
-    interp_output_printf(printf_info, addr);
-    cl_gpgpu_unmap_printf_buffer(gpgpu);
-  }
+  if (ver == 7 || ver == 75 || ver == 8 || ver == 9)
+    TRY (cl_command_queue_build_ND_range_gen7, queue, k, gpgpu, work_dim,
+                                global_wk_off, global_dim_off, global_wk_sz,
+                                global_wk_sz_use, local_wk_sz, local_wk_sz_use);
+  else
+    FATAL ("Unknown Gen Device");
 
-  if (printf_info) {
-    interp_release_printf_info(printf_info);
-    cl_gpgpu_set_printf_info(gpgpu, NULL);
-  }
+error:
+  return err;
+}
+
+LOCAL void
+cl_command_queue_output_profiling(cl_gpgpu gpgpu)
+{
+  void* profiling_info;
 
   /* If have profiling info, output it. */
   profiling_info = cl_gpgpu_get_profiling_info(gpgpu);
@@ -303,7 +410,15 @@ cl_command_queue_flush_gpgpu(cl_gpgpu gpgpu)
     interp_output_profiling(profiling_info, cl_gpgpu_map_profiling_buffer(gpgpu));
     cl_gpgpu_unmap_profiling_buffer(gpgpu);
   }
+}
+
+LOCAL int
+cl_command_queue_flush_gpgpu(cl_gpgpu gpgpu)
+{
+  if (cl_gpgpu_flush(gpgpu) < 0)
+    return CL_OUT_OF_RESOURCES;
 
+  cl_command_queue_output_profiling(gpgpu);
   return CL_SUCCESS;
 }
 
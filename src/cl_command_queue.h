@@ -35,6 +35,8 @@ typedef struct _cl_command_queue_enqueue_worker {
   cl_bool quit;
   list_head enqueued_events;
   cl_uint in_exec_status; // Same value as CL_COMPLETE, CL_SUBMITTED ...
+  cl_ulong taken_seq;     // Number of events taken by the worker to be executed
+  cl_ulong retired_seq;   // Number of them completed, they retire in order
 } _cl_command_queue_enqueue_worker;
 
 typedef _cl_command_queue_enqueue_worker *cl_command_queue_enqueue_worker;
@@ -51,6 +53,12 @@ typedef struct _cl_command_queue {
   cl_command_queue_properties props;   /* Queue properties */
   cl_mem perf;                         /* Where to put the perf counters */
   cl_uint size;                        /* Store the specified size for queueu */
+  cl_buffer printf_buf;                /* printf output of the launches, reused across them */
+  uint32_t printf_buf_size;
+  uint32_t printf_head;                /* Next free byte of printf_buf */
+  uint32_t printf_users;               /* Launches whose output is still in printf_buf */
+  uint32_t printf_min_size;            /* Size the launches overflowing their part asked for */
+  uint32_t printf_size;                /* Printf buffer size of a launch, 0 to guess it */
 } _cl_command_queue;;
 
 #define CL_OBJECT_COMMAND_QUEUE_MAGIC 0x83650a12b79ce4efLL
@@ -77,11 +85,29 @@ extern cl_int cl_command_queue_ND_range(cl_command_queue queue,
                                         const size_t *global_wk_sz_use,
                                         const size_t *local_wk_sz,
                                         const size_t *local_wk_sz_use);
+/* Build the ND range into gpgpu without an event, the caller submits it */
+extern cl_int cl_command_queue_build_ND_range(cl_command_queue queue,
+                                              cl_kernel ker,
+                                              cl_gpgpu gpgpu,
+                                              const uint32_t work_dim,
+                                              const size_t *global_wk_off,
+                                              const size_t *global_dim_off,
+                                              const size_t *global_wk_sz,
+                                              const size_t *global_wk_sz_use,
+                                              const size_t *local_wk_sz,
+                                              const size_t *local_wk_sz_use);
 
 /* The memory object where to report the performance */
 extern cl_int cl_command_queue_set_report_buffer(cl_command_queue, cl_mem);
 /* Flush for the specified gpgpu */
 extern int cl_command_queue_flush_gpgpu(cl_gpgpu);
+/* Output the kernel profiling info of a submitted gpgpu, if any */
+extern void cl_command_queue_output_profiling(cl_gpgpu);
+/* Give the launch size bytes of the printf buffer of the queue */
+extern int cl_command_queue_bind_printf_buffer(cl_command_queue, cl_gpgpu, uint32_t size, uint8_t bti);
+/* Print the printf output of a finished launch if output is set, and give its
+ * part of the printf buffer back */
+extern void cl_command_queue_finish_printf(cl_command_queue, cl_gpgpu, cl_bool output);
 /* Bind all the surfaces in the GPGPU state */
 extern cl_int cl_command_queue_bind_surface(cl_command_queue, cl_kernel, cl_gpgpu, uint32_t *);
 /* Bind all the image surfaces in the GPGPU state */
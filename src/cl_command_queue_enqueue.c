@@ -22,6 +22,10 @@
 #include "cl_alloc.h"
 #include <stdio.h>
 
+/* How long the worker sleeps on a running batch before it looks for new
+ * ready events to submit */
+#define CL_WORKER_WAIT_SLICE_NS 1000000
+
 static void *
 worker_thread_function(void *Arg)
 {
@@ -32,86 +36,107 @@ worker_thread_function(void *Arg)
   list_node *pos;
   list_node *n;
   list_head ready_list;
+  list_head submitted_list;
   cl_int exec_status;
+  cl_bool rescan;
+
+  /* Events that went to SUBMITTED but did not complete yet, retired in order */
+  list_init(&submitted_list);
 
   CL_OBJECT_LOCK(queue);
 
   while (1) {
     /* Must have locked here. */
 
-    if (worker->quit == CL_TRUE) {
+    if (worker->quit == CL_TRUE && list_empty(&submitted_list)) {
       CL_OBJECT_UNLOCK(queue);
       return NULL;
     }
 
-    if (list_empty(&worker->enqueued_events)) {
-      CL_OBJECT_WAIT_ON_COND(queue);
-      continue;
-    }
+    list_init(&ready_list);
 
     /* The cookie will change when event status change or something happend to
        this command queue. If we already checked the event list and do not find
        anything to exec, we need to wait the cookie update, to avoid loop for ever. */
-    if (cookie == worker->cookie) {
-      CL_OBJECT_WAIT_ON_COND(queue);
-      continue;
-    }
-
-    /* Here we hold lock to check event status, to avoid missing the status notify*/
-    list_init(&ready_list);
-    list_for_each_safe(pos, n, &worker->enqueued_events)
-    {
-      e = list_entry(pos, _cl_event, enqueue_node);
-      if (cl_event_is_ready(e) <= CL_COMPLETE) {
-        list_node_del(&e->enqueue_node);
-        list_add_tail(&ready_list, &e->enqueue_node);
+    if (!list_empty(&worker->enqueued_events) && cookie != worker->cookie) {
+      /* Here we hold lock to check event status, to avoid missing the status notify*/
+      list_for_each_safe(pos, n, &worker->enqueued_events)
+      {
+        e = list_entry(pos, _cl_event, enqueue_node);
+        if (cl_event_is_ready(e) <= CL_COMPLETE) {
+          list_node_del(&e->enqueue_node);
+          list_add_tail(&ready_list, &e->enqueue_node);
+          worker->taken_seq++;
+        }
       }
+
+      if (list_empty(&ready_list)) /* Nothing to do, wait the next change. */
+        cookie = worker->cookie;
     }
 
-    if (list_empty(&ready_list)) { /* Nothing to do, just wait. */
-      cookie = worker->cookie;
+    if (list_empty(&ready_list) && list_empty(&submitted_list)) {
+      CL_OBJECT_WAIT_ON_COND(queue);
       continue;
     }
 
-    /* Notify waiters, we change the event list. */
-    CL_OBJECT_NOTIFY_COND(queue);
+    if (!list_empty(&ready_list)) {
+      /* Notify waiters, we change the event list. */
+      CL_OBJECT_NOTIFY_COND(queue);
 
-    worker->in_exec_status = CL_QUEUED;
-    CL_OBJECT_UNLOCK(queue);
+      worker->in_exec_status = CL_QUEUED;
+      CL_OBJECT_UNLOCK(queue);
 
-    /* Do the really job without lock.*/
-    exec_status = CL_SUBMITTED;
-    list_for_each_safe(pos, n, &ready_list)
-    {
-      e = list_entry(pos, _cl_event, enqueue_node);
-      cl_event_exec(e, exec_status, CL_FALSE);
+      /* Do the really job without lock.*/
+      exec_status = CL_SUBMITTED;
+      list_for_each_safe(pos, n, &ready_list)
+      {
+        e = list_entry(pos, _cl_event, enqueue_node);
+        cl_event_exec(e, exec_status, CL_FALSE);
+      }
+      list_merge(&submitted_list, &ready_list);
+
+      /* Notify all waiting for flush. */
+      CL_OBJECT_LOCK(queue);
+      worker->in_exec_status = CL_SUBMITTED;
+      CL_OBJECT_NOTIFY_COND(queue);
     }
 
-    /* Notify all waiting for flush. */
-    CL_OBJECT_LOCK(queue);
-    worker->in_exec_status = CL_SUBMITTED;
-    CL_OBJECT_NOTIFY_COND(queue);
     CL_OBJECT_UNLOCK(queue);
 
-    list_for_each_safe(pos, n, &ready_list)
+    /* Retire the submitted events in order. The GPU ones are waited on with a
+       timeout, so the events made ready meanwhile (user events, other queues)
+       get submitted behind a long running batch instead of after it. */
+    rescan = CL_FALSE;
+    list_for_each_safe(pos, n, &submitted_list)
     {
       e = list_entry(pos, _cl_event, enqueue_node);
-      cl_event_exec(e, CL_COMPLETE, CL_FALSE);
-    }
 
-    /* Clear and delete all the events. */
-    list_for_each_safe(pos, n, &ready_list)
-    {
-      e = list_entry(pos, _cl_event, enqueue_node);
+      while (!cl_enqueue_wait_gpu(&e->exec_data, CL_WORKER_WAIT_SLICE_NS)) {
+        CL_OBJECT_LOCK(queue);
+        rescan = (cookie != worker->cookie && !list_empty(&worker->enqueued_events));
+        CL_OBJECT_UNLOCK(queue);
+        if (rescan)
+          break;
+      }
+      if (rescan)
+        break;
+
+      /* Complete and delete the event, the callbacks fire here. */
       list_node_del(&e->enqueue_node);
+      cl_event_exec(e, CL_COMPLETE, CL_FALSE);
       cl_event_delete(e);
+
+      /* Wake up the finish waiters this event was the last one for */
+      CL_OBJECT_LOCK(queue);
+      worker->retired_seq++;
+      CL_OBJECT_NOTIFY_COND(queue);
+      CL_OBJECT_UNLOCK(queue);
     }
 
     CL_OBJECT_LOCK(queue);
-    worker->in_exec_status = CL_COMPLETE;
 
-    /* Notify finish waiters, we have done all the ready event. */
-    CL_OBJECT_NOTIFY_COND(queue);
+    if (list_empty(&submitted_list))
+      worker->in_exec_status = CL_COMPLETE;
   }
 }
 
@@ -151,6 +176,8 @@ cl_command_queue_init_enqueue(cl_command_queue queue)
   worker->quit = CL_FALSE;
   worker->in_exec_status = CL_COMPLETE;
   worker->cookie = 8;
+  worker->taken_seq = 0;
+  worker->retired_seq = 0;
   list_init(&worker->enqueued_events);
 
   if (pthread_create(&worker->tid, NULL, worker_thread_function, worker)) {
@@ -279,12 +306,18 @@ cl_command_queue_wait_flush(cl_command_queue queue)
   return CL_SUCCESS;
 }
 
+/* Wait for the events enqueued when it is called, not for the worker to be
+ * idle: the worker keeps taking the events enqueued meanwhile, and would
+ * never be idle under a steady stream of them. The events it already took
+ * are done once as many events as it had taken retired, the other ones are
+ * waited for one by one. */
 LOCAL cl_int
 cl_command_queue_wait_finish(cl_command_queue queue)
 {
   cl_command_queue_enqueue_worker worker = &queue->worker;
   cl_event *enqueued_list = NULL;
   cl_uint enqueued_num = 0;
+  cl_ulong taken_seq;
   int i;
 
   CL_OBJECT_LOCK(queue);
@@ -300,7 +333,8 @@ cl_command_queue_wait_finish(cl_command_queue queue)
     assert(enqueued_list);
   }
 
-  while (worker->in_exec_status > CL_COMPLETE) {
+  taken_seq = worker->taken_seq;
+  while (worker->retired_seq < taken_seq) {
     CL_OBJECT_WAIT_ON_COND(queue);
 
     if (worker->quit) { // already destroy the queue?
@@ -204,10 +204,9 @@ cl_upload_constant_buffer(cl_command_queue queue, cl_kernel ker, cl_gpgpu gpgpu)
         continue;
       *(uint32_t *) (ker->curbe + curbe_offset) = offset;
 
-      cl_buffer_map(mem->bo, 1);
-      void * addr = cl_buffer_get_virtual(mem->bo);
+      void * addr = cl_mem_map(mem, 0);
       memcpy(cst_addr + offset, addr, mem->size);
-      cl_buffer_unmap(mem->bo);
+      cl_mem_unmap(mem);
       offset += mem->size;
     }
   }
@@ -338,33 +337,34 @@ cl_bind_profiling(cl_gpgpu gpgpu, uint32_t simd_sz, cl_kernel ker, size_t global
 
 
 static int
-cl_alloc_printf(cl_gpgpu gpgpu, cl_kernel ker, void* printf_info, int printf_num, size_t global_sz) {
-  /* An guess size. */
+cl_alloc_printf(cl_command_queue queue, cl_gpgpu gpgpu, void* printf_info, int printf_num, size_t global_sz) {
+  /* An guess size, the queue grows it when the output overflows. */
   size_t buf_size = global_sz * sizeof(int) * 16 * printf_num;
   if (buf_size > 16*1024*1024) //at most.
     buf_size = 16*1024*1024;
   if (buf_size < 1*1024*1024) // at least.
     buf_size = 1*1024*1024;
+  if (queue->printf_size)
+    buf_size = queue->printf_size;
 
-  if (cl_gpgpu_set_printf_buffer(gpgpu, buf_size, interp_get_printf_buf_bti(printf_info)) != 0)
+  if (cl_command_queue_bind_printf_buffer(queue, gpgpu, buf_size, interp_get_printf_buf_bti(printf_info)) != 0)
 	return -1;
 
   return 0;
 }
 
 LOCAL cl_int
-cl_command_queue_ND_range_gen7(cl_command_queue queue,
-                               cl_kernel ker,
-                               cl_event event,
-                               const uint32_t work_dim,
-                               const size_t *global_wk_off,
-                               const size_t *global_dim_off,
-                               const size_t *global_wk_sz,
-                               const size_t *global_wk_sz_use,
-                               const size_t *local_wk_sz,
-                               const size_t *local_wk_sz_use)
+cl_command_queue_build_ND_range_gen7(cl_command_queue queue,
+                                     cl_kernel ker,
+                                     cl_gpgpu gpgpu,
+                                     const uint32_t work_dim,
+                                     const size_t *global_wk_off,
+                                     const size_t *global_dim_off,
+                                     const size_t *global_wk_sz,
+                                     const size_t *global_wk_sz_use,
+                                     const size_t *local_wk_sz,
+                                     const size_t *local_wk_sz_use)
 {
-  cl_gpgpu gpgpu = cl_gpgpu_new(queue->ctx->drv);
   cl_context ctx = queue->ctx;
   char *final_curbe = NULL;  /* Includes them and one sub-buffer per group */
   cl_gpgpu_kernel kernel;
@@ -427,7 +427,7 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
     goto error;
   printf_num = interp_get_printf_num(printf_info);
   if (printf_num) {
-    if (cl_alloc_printf(gpgpu, ker, printf_info, printf_num, global_size) != 0)
+    if (cl_alloc_printf(queue, gpgpu, printf_info, printf_num, global_size) != 0)
       goto error;
   }
   if (interp_get_profiling_bti(ker->opaque) != 0) {
@@ -441,8 +441,8 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
   /* Bind user buffers */
   cl_command_queue_bind_surface(queue, ker, gpgpu, &max_bti);
   /* Bind user images */
-  if(UNLIKELY(err = cl_command_queue_bind_image(queue, ker, gpgpu, &max_bti) != CL_SUCCESS))
-    return err;
+  if(UNLIKELY((err = cl_command_queue_bind_image(queue, ker, gpgpu, &max_bti)) != CL_SUCCESS))
+    goto error_status;
   /* Bind all exec infos */
   cl_command_queue_bind_exec_info(queue, ker, gpgpu, &max_bti);
   /* Bind device enqueue buffer */
@@ -488,15 +488,41 @@ cl_command_queue_ND_range_gen7(cl_command_queue queue,
 
   /* Close the batch buffer and submit it */
   cl_gpgpu_batch_end(gpgpu, 0);
+  return CL_SUCCESS;
+
+error:
+  /* only some command/buffer internal error reach here, so return error code OOR */
+  err = CL_OUT_OF_RESOURCES;
+error_status:
+  /* Give back the part of the printf buffer taken for the launch */
+  cl_command_queue_finish_printf(queue, gpgpu, CL_FALSE);
+  return err;
+}
+
+LOCAL cl_int
+cl_command_queue_ND_range_gen7(cl_command_queue queue,
+                               cl_kernel ker,
+                               cl_event event,
+                               const uint32_t work_dim,
+                               const size_t *global_wk_off,
+                               const size_t *global_dim_off,
+                               const size_t *global_wk_sz,
+                               const size_t *global_wk_sz_use,
+                               const size_t *local_wk_sz,
+                               const size_t *local_wk_sz_use)
+{
+  cl_gpgpu gpgpu = cl_gpgpu_new(queue->ctx->drv);
+  cl_int err;
+
+  err = cl_command_queue_build_ND_range_gen7(queue, ker, gpgpu, work_dim, global_wk_off,
+                                             global_dim_off, global_wk_sz, global_wk_sz_use,
+                                             local_wk_sz, local_wk_sz_use);
+  if (err != CL_SUCCESS)
+    return err;
 
   event->exec_data.queue = queue;
   event->exec_data.gpgpu = gpgpu;
   event->exec_data.type = EnqueueNDRangeKernel;
-
   return CL_SUCCESS;
-
-error:
-  /* only some command/buffer internal error reach here, so return error code OOR */
-  return CL_OUT_OF_RESOURCES;
 }
 
@@ -22,6 +22,7 @@
 #include "cl_context.h"
 #include "cl_command_queue.h"
 #include "cl_mem.h"
+#include "cl_mem_slab.h"
 #include "cl_sampler.h"
 #include "cl_event.h"
 #include "cl_alloc.h"
@@ -127,10 +128,9 @@ cl_context_add_event(cl_context ctx, cl_event event) {
   assert(event->ctx == NULL);
   cl_context_add_ref(ctx);
 
-  CL_OBJECT_LOCK(ctx);
-  list_add_tail(&ctx->events, &event->base.node);
-  ctx->event_num++;
-  CL_OBJECT_UNLOCK(ctx);
+  /* Events are not linked in a context list, every queue enqueues them and
+   * that would serialize them all on the context lock. */
+  atomic_inc(&ctx->event_num);
 
   event->ctx = ctx;
 }
@@ -138,13 +138,12 @@ cl_context_add_event(cl_context ctx, cl_event event) {
 LOCAL void
 cl_context_remove_event(cl_context ctx, cl_event event) {
   assert(event->ctx == ctx);
-  CL_OBJECT_LOCK(ctx);
-  list_node_del(&event->base.node);
-  ctx->event_num--;
-  CL_OBJECT_UNLOCK(ctx);
+  atomic_dec(&ctx->event_num);
 
-  cl_context_delete(ctx);
+  /* The event memory belongs to the context pool once the ref is dropped */
   event->ctx = NULL;
+  cl_free_list_put(&ctx->event_pool, event);
+  cl_context_delete(ctx);
 }
 
 LOCAL void
@@ -336,12 +335,15 @@ cl_context_new(struct _cl_context_prop *props, cl_uint dev_num, cl_device_id* al
   list_init(&ctx->queues);
   list_init(&ctx->mem_objects);
   list_init(&ctx->samplers);
-  list_init(&ctx->events);
+  cl_free_list_init(&ctx->event_pool, sizeof(_cl_event), CL_CONTEXT_EVENT_POOL_MAX);
+  cl_free_list_init(&ctx->event_cb_pool, sizeof(_cl_event_user_callback), CL_CONTEXT_EVENT_POOL_MAX);
   list_init(&ctx->programs);
   ctx->queue_modify_disable = CL_FALSE;
   TRY_ALLOC_NO_ERR (ctx->drv, cl_driver_new(props));
   ctx->props = *props;
   ctx->ver = cl_driver_get_ver(ctx->drv);
+  cl_mem_init_image_tiling(ctx);
+  cl_copy_tuning_init_context(ctx);
   ctx->image_queue = NULL;
 
 exit:
@@ -400,6 +402,9 @@ cl_context_delete(cl_context ctx)
 
   CL_OBJECT_DEC_REF(ctx);
 
+  cl_mem_slab_pool_delete(ctx);
+  cl_free_list_destroy(&ctx->event_pool);
+  cl_free_list_destroy(&ctx->event_cb_pool);
   cl_free(ctx->prop_user);
   cl_free(ctx->devices);
   cl_driver_delete(ctx->drv);
@@ -457,8 +462,14 @@ cl_context_get_static_kernel_from_bin(cl_context ctx, cl_int index,
     } else if (index == CL_ENQUEUE_FILL_BUFFER_ALIGN8_64) {
       ctx->internal_kernels[index] = cl_program_create_kernel(ctx->internal_prgs[index],
                                                               "__cl_fill_region_align8_16", NULL);
+    } else if (index >= CL_ENQUEUE_COPY_BUFFER_TUNED && index < CL_ENQUEUE_FILL_BUFFER_TUNED) {
+      ctx->internal_kernels[index] = cl_program_create_kernel(ctx->internal_prgs[index],
+        cl_copy_tuned_kernels[index - CL_ENQUEUE_COPY_BUFFER_TUNED].name, NULL);
+    } else if (index >= CL_ENQUEUE_FILL_BUFFER_TUNED && index < CL_INTERNAL_KERNEL_MAX) {
+      ctx->internal_kernels[index] = cl_program_create_kernel(ctx->internal_prgs[index],
+        cl_fill_tuned_kernels[index - CL_ENQUEUE_FILL_BUFFER_TUNED].name, NULL);
     } else {
-      ctx->internal_kernels[index] = cl_kernel_dup(ctx->internal_prgs[index]->ker[0]);
+      ctx->internal_kernels[index] = cl_kernel_dup(cl_program_get_kernel(ctx->internal_prgs[index], 0));
     }
   }
   ker = ctx->internal_kernels[index];
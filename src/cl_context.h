@@ -25,6 +25,8 @@
 #include "cl_internals.h"
 #include "cl_driver.h"
 #include "cl_base_object.h"
+#include "cl_alloc.h"
+#include "cl_copy_tuning.h"
 
 #include <stdint.h>
 #include <pthread.h>
@@ -85,7 +87,9 @@ enum _cl_internal_ker_type {
   CL_ENQUEUE_FILL_IMAGE_2D,         // fill image 2d
   CL_ENQUEUE_FILL_IMAGE_2D_ARRAY,   // fill image 2d array
   CL_ENQUEUE_FILL_IMAGE_3D,         // fill image 3d
-  CL_INTERNAL_KERNEL_MAX
+  CL_ENQUEUE_COPY_BUFFER_TUNED,     // first calibrated buffer copy, see cl_copy_tuning.h
+  CL_ENQUEUE_FILL_BUFFER_TUNED = CL_ENQUEUE_COPY_BUFFER_TUNED + CL_COPY_TUNED_KERNEL_N,
+  CL_INTERNAL_KERNEL_MAX = CL_ENQUEUE_FILL_BUFFER_TUNED + CL_FILL_TUNED_KERNEL_N
 };
 
 struct _cl_context_prop {
@@ -116,8 +120,9 @@ struct _cl_context {
   cl_uint mem_object_num;           /* All memory number currently allocated */
   list_head samplers;               /* All sampler object currently allocated */
   cl_uint sampler_num;              /* All sampler number currently allocated */
-  list_head events;                 /* All event object currently allocated */
-  cl_uint event_num;                /* All event number currently allocated */
+  atomic_t event_num;               /* All event number currently allocated */
+  cl_free_list event_pool;          /* Released events, recycled by the next enqueue */
+  cl_free_list event_cb_pool;       /* Released event callback records */
   list_head programs;               /* All programs currently allocated */
   cl_uint program_num;              /* All program number currently allocated */
 
@@ -134,8 +139,17 @@ struct _cl_context {
                                      /* User's callback when error occur in context */
   void *user_data;                   /* A pointer to user supplied data */
   cl_command_queue image_queue;      /* A internal command queue for image data copying */
+  cl_uint image_tiling;              /* Tiling of the new images, OCL_TILING */
+  cl_bool cpu_tiling;                /* Tile image reads and writes on the CPU, OCL_CPU_TILING */
+  int copy_kernel;                   /* Forced calibrated copy kernel, OCL_COPY_KERNEL */
+  int fill_kernel;                   /* Forced calibrated fill kernel, OCL_FILL_KERNEL */
+  struct _cl_mem_slab_pool *slab_pool; /* Bos small buffers are carved out of, see cl_mem_slab.h */
+  struct _cl_mem_slab_pool *svm_slab_pool; /* Same for the small SVM allocations */
 };
 
+/* Released events and callback records a context keeps for reuse */
+#define CL_CONTEXT_EVENT_POOL_MAX 256
+
 #define CL_OBJECT_CONTEXT_MAGIC 0x20BBCADE993134AALL
 #define CL_OBJECT_IS_CONTEXT(obj) ((obj &&                           \
          ((cl_base_object)obj)->magic == CL_OBJECT_CONTEXT_MAGIC &&  \
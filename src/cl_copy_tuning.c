@@ -0,0 +1,354 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_copy_tuning.h"
+#include "cl_context.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+#include "CL/cl.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const cl_copy_kernel_desc cl_copy_tuned_kernels[CL_COPY_TUNED_KERNEL_N] = {
+  {"__cl_copy_buf_uint_x1", 4, 1, 0},
+  {"__cl_copy_buf_uint_x4", 4, 4, 0},
+  {"__cl_copy_buf_uint4_x1", 16, 1, 0},
+  {"__cl_copy_buf_uint4_x2", 16, 2, 0},
+  {"__cl_copy_buf_uint4_x4", 16, 4, 0},
+  {"__cl_copy_buf_uint8_x1", 32, 1, 0},
+  {"__cl_copy_buf_uint8_x2", 32, 2, 0},
+  {"__cl_copy_buf_uint16_x1", 64, 1, 0},
+  {"__cl_copy_buf_block4", 16, 1, 1},
+  {"__cl_copy_buf_block8", 32, 1, 1},
+};
+
+const cl_copy_kernel_desc cl_fill_tuned_kernels[CL_FILL_TUNED_KERNEL_N] = {
+  {"__cl_fill_buf_uint4_x1", 16, 1, 0},
+  {"__cl_fill_buf_uint4_x4", 16, 4, 0},
+  {"__cl_fill_buf_uint8_x2", 32, 2, 0},
+  {"__cl_fill_buf_uint16_x1", 64, 1, 0},
+  {"__cl_fill_buf_uint16_x2", 64, 2, 0},
+  {"__cl_fill_buf_block4", 16, 1, 1},
+};
+
+/* The selection table is indexed by the alignment (4, 16, 32 and 64 bytes)
+ * and by the size, each size class being measured at one transfer size */
+#define CL_TUNE_ALIGN_N 4
+#define CL_TUNE_SIZE_N 3
+#define CL_TUNE_RUNS 3
+static const size_t tune_sizes[CL_TUNE_SIZE_N] = {64 * 1024, 1024 * 1024, 8 * 1024 * 1024};
+
+/* Kernel used for each [fill][align][size][block_ok] without calibration:
+ * wide elements that the alignment allows, unrolled for the larger sizes.
+ * Fills need 16 bytes aligned ranges */
+static const int8_t default_select[2][CL_TUNE_ALIGN_N][CL_TUNE_SIZE_N][2] = {
+  { {{1, 1}, {1, 1}, {1, 1}},
+    {{3, 3}, {4, 4}, {4, 4}},
+    {{5, 5}, {6, 6}, {6, 6}},
+    {{7, 7}, {6, 6}, {6, 6}} },
+  { {{-1, -1}, {-1, -1}, {-1, -1}},
+    {{0, 0}, {1, 1}, {1, 1}},
+    {{2, 2}, {2, 2}, {2, 2}},
+    {{3, 3}, {4, 4}, {4, 4}} },
+};
+
+/* OCL_COPY_TUNING: 0 keeps the fixed kernels, 1 calibrates the table on the
+ * first copy or fill, the default table is used otherwise */
+static struct {
+  int mode;
+  int8_t select[2][CL_TUNE_ALIGN_N][CL_TUNE_SIZE_N][2]; /* [fill][align][size][block_ok] */
+} tuning;
+
+/* The first copy or fill sets the table up with the device of its context,
+ * the other threads wait for it */
+static pthread_mutex_t tuning_lock = PTHREAD_MUTEX_INITIALIZER;
+static int tuning_done = 0;
+
+LOCAL size_t
+cl_copy_tuned_global_size(const cl_copy_kernel_desc *desc, size_t size)
+{
+  size_t elems = size / desc->elem_size;
+  return ALIGN((elems + desc->unroll - 1) / desc->unroll, CL_COPY_TUNED_LOCAL_SIZE);
+}
+
+static int
+cl_copy_tuning_size_class(size_t size)
+{
+  if (size < 256 * 1024)
+    return 0;
+  if (size < 4 * 1024 * 1024)
+    return 1;
+  return 2;
+}
+
+static int
+cl_copy_tuning_align_class(size_t align)
+{
+  if (align >= 64)
+    return 3;
+  if (align >= 32)
+    return 2;
+  if (align >= 16)
+    return 1;
+  if (align >= 4)
+    return 0;
+  return -1;
+}
+
+/* Whether a kernel moves the elements of a transfer of the given alignment
+ * class and bound addresses */
+static cl_bool
+cl_copy_tuning_fits(const cl_copy_kernel_desc *desc, int a, cl_bool block_ok)
+{
+  return cl_copy_tuning_align_class(desc->elem_size) <= a && (!desc->block || block_ok);
+}
+
+/* Best of a few runs, in ns. The first one also warms up the caches and the
+ * kernel upload */
+static cl_ulong
+cl_copy_tuning_run(cl_command_queue queue, cl_kernel kernel, const cl_copy_kernel_desc *desc, size_t size)
+{
+  size_t global_sz = cl_copy_tuned_global_size(desc, size);
+  size_t local_sz = CL_COPY_TUNED_LOCAL_SIZE;
+  cl_ulong best = (cl_ulong)-1;
+  cl_ulong start, end;
+  cl_event e;
+  int i;
+
+  for (i = 0; i < CL_TUNE_RUNS; i++) {
+    if (clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_sz, &local_sz, 0, NULL, &e) != CL_SUCCESS)
+      return (cl_ulong)-1;
+    if (clWaitForEvents(1, &e) == CL_SUCCESS &&
+        clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS &&
+        clGetEventProfilingInfo(e, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS &&
+        end > start && end - start < best)
+      best = end - start;
+    clReleaseEvent(e);
+  }
+  return best;
+}
+
+/* Check the first size bytes written by the last run. A kernel which does
+ * not produce the expected bytes is never selected */
+static cl_bool
+cl_copy_tuning_check(cl_command_queue queue, cl_mem dst, const char *expect, char *result, size_t size)
+{
+  if (clEnqueueReadBuffer(queue, dst, CL_TRUE, 0, size, result, 0, NULL, NULL) != CL_SUCCESS)
+    return CL_FALSE;
+  return memcmp(result, expect, size) == 0;
+}
+
+/* Time every kernel of the program on each size class. src holds expect for
+ * the copies, expect is the replicated pattern for the fills */
+static cl_bool
+cl_copy_tuning_measure(cl_device_id device, cl_context ctx, cl_command_queue queue, cl_mem src,
+                       cl_mem dst, cl_bool fill, const char *expect, char *result,
+                       cl_ulong times[][CL_TUNE_SIZE_N])
+{
+  extern char cl_internal_copy_buf_tuned_str[];
+  extern size_t cl_internal_copy_buf_tuned_str_size;
+  extern char cl_internal_fill_buf_tuned_str[];
+  extern size_t cl_internal_fill_buf_tuned_str_size;
+  const cl_copy_kernel_desc *descs = fill ? cl_fill_tuned_kernels : cl_copy_tuned_kernels;
+  const int kernel_n = fill ? CL_FILL_TUNED_KERNEL_N : CL_COPY_TUNED_KERNEL_N;
+  const unsigned char *binary = (const unsigned char *)(fill ? cl_internal_fill_buf_tuned_str
+                                                             : cl_internal_copy_buf_tuned_str);
+  size_t binary_size = fill ? cl_internal_fill_buf_tuned_str_size : cl_internal_copy_buf_tuned_str_size;
+  const size_t buf_size = tune_sizes[CL_TUNE_SIZE_N - 1];
+  const cl_uint zero = 0;
+  cl_uint4 pattern;
+  cl_program program;
+  cl_kernel kernel;
+  cl_int status;
+  int i, s;
+
+  memcpy(&pattern, expect, sizeof(pattern));
+  program = clCreateProgramWithBinary(ctx, 1, &device, &binary_size, &binary, NULL, &status);
+  if (program == NULL)
+    return CL_FALSE;
+  if (clBuildProgram(program, 1, &device, "", NULL, NULL) != CL_SUCCESS) {
+    clReleaseProgram(program);
+    return CL_FALSE;
+  }
+
+  for (i = 0; i < kernel_n; i++) {
+    for (s = 0; s < CL_TUNE_SIZE_N; s++)
+      times[i][s] = (cl_ulong)-1;
+    if ((kernel = clCreateKernel(program, descs[i].name, &status)) == NULL)
+      continue;
+    for (s = 0; s < CL_TUNE_SIZE_N; s++) {
+      cl_uint elems = tune_sizes[s] / descs[i].elem_size;
+      memset(result, 0, buf_size);
+      if (clEnqueueWriteBuffer(queue, dst, CL_TRUE, 0, buf_size, result, 0, NULL, NULL) != CL_SUCCESS)
+        break;
+      if (fill) {
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &dst);
+        clSetKernelArg(kernel, 1, sizeof(cl_uint4), &pattern);
+        clSetKernelArg(kernel, 2, sizeof(cl_uint), &zero);
+        clSetKernelArg(kernel, 3, sizeof(cl_uint), &elems);
+      } else {
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &src);
+        clSetKernelArg(kernel, 1, sizeof(cl_uint), &zero);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), &dst);
+        clSetKernelArg(kernel, 3, sizeof(cl_uint), &zero);
+        clSetKernelArg(kernel, 4, sizeof(cl_uint), &elems);
+      }
+      times[i][s] = cl_copy_tuning_run(queue, kernel, &descs[i], tune_sizes[s]);
+      if (times[i][s] != (cl_ulong)-1 &&
+          !cl_copy_tuning_check(queue, dst, expect, result, tune_sizes[s])) {
+        DEBUGP(DL_WARNING, "Calibration: %s gives wrong results, not used", descs[i].name);
+        for (s = 0; s < CL_TUNE_SIZE_N; s++)
+          times[i][s] = (cl_ulong)-1;
+        break;
+      }
+    }
+    clReleaseKernel(kernel);
+  }
+
+  clReleaseProgram(program);
+  return CL_TRUE;
+}
+
+static void
+cl_copy_tuning_build_table(cl_bool fill, cl_ulong times[][CL_TUNE_SIZE_N])
+{
+  const cl_copy_kernel_desc *descs = fill ? cl_fill_tuned_kernels : cl_copy_tuned_kernels;
+  const int kernel_n = fill ? CL_FILL_TUNED_KERNEL_N : CL_COPY_TUNED_KERNEL_N;
+  int a, s, b, i;
+
+  for (a = 0; a < CL_TUNE_ALIGN_N; a++)
+    for (s = 0; s < CL_TUNE_SIZE_N; s++)
+      for (b = 0; b < 2; b++) {
+        int best = -1;
+        for (i = 0; i < kernel_n; i++) {
+          if (!cl_copy_tuning_fits(&descs[i], a, b))
+            continue;
+          if (times[i][s] == (cl_ulong)-1)
+            continue;
+          if (best < 0 || times[i][s] < times[best][s])
+            best = i;
+        }
+        tuning.select[fill][a][s][b] = best;
+      }
+}
+
+/* Measure the kernels on a private profiling queue and replace the default
+ * table. Nothing changes if anything fails */
+static void
+cl_copy_tuning_calibrate(cl_device_id device)
+{
+  cl_ulong copy_times[CL_COPY_TUNED_KERNEL_N][CL_TUNE_SIZE_N];
+  cl_ulong fill_times[CL_FILL_TUNED_KERNEL_N][CL_TUNE_SIZE_N];
+  const size_t buf_size = tune_sizes[CL_TUNE_SIZE_N - 1];
+  const cl_queue_properties queue_props[] = {CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0};
+  const cl_uint pattern[4] = {0x01020304, 0x05060708, 0x090a0b0c, 0x0d0e0f00};
+  cl_command_queue queue = NULL;
+  cl_mem src = NULL, dst = NULL;
+  char *data = NULL, *result = NULL;
+  cl_context ctx;
+  cl_int status;
+  size_t i;
+
+  ctx = clCreateContext(NULL, 1, &device, NULL, NULL, &status);
+  if (ctx == NULL)
+    return;
+  queue = clCreateCommandQueueWithProperties(ctx, device, queue_props, &status);
+  src = clCreateBuffer(ctx, CL_MEM_READ_WRITE, buf_size, NULL, &status);
+  dst = clCreateBuffer(ctx, CL_MEM_READ_WRITE, buf_size, NULL, &status);
+  data = cl_malloc(buf_size);
+  result = cl_malloc(buf_size);
+
+  if (queue && src && dst && data && result) {
+    for (i = 0; i < buf_size / sizeof(cl_uint); i++)
+      ((cl_uint *)data)[i] = (cl_uint)i * 2654435761u;
+    if (clEnqueueWriteBuffer(queue, src, CL_TRUE, 0, buf_size, data, 0, NULL, NULL) == CL_SUCCESS &&
+        cl_copy_tuning_measure(device, ctx, queue, src, dst, CL_FALSE, data, result, copy_times)) {
+      for (i = 0; i < buf_size; i += sizeof(pattern))
+        memcpy(data + i, pattern, sizeof(pattern));
+      if (cl_copy_tuning_measure(device, ctx, queue, src, dst, CL_TRUE, data, result, fill_times)) {
+        cl_copy_tuning_build_table(CL_FALSE, copy_times);
+        cl_copy_tuning_build_table(CL_TRUE, fill_times);
+      }
+    }
+  }
+
+  if (result)
+    cl_free(result);
+  if (data)
+    cl_free(data);
+  if (dst)
+    clReleaseMemObject(dst);
+  if (src)
+    clReleaseMemObject(src);
+  if (queue)
+    clReleaseCommandQueue(queue);
+  clReleaseContext(ctx);
+}
+
+static void
+cl_copy_tuning_init(cl_device_id device)
+{
+  const char *env = getenv("OCL_COPY_TUNING");
+
+  tuning.mode = -1;
+  if (env != NULL)
+    sscanf(env, "%i", &tuning.mode);
+  memcpy(tuning.select, default_select, sizeof(tuning.select));
+  if (tuning.mode == 1)
+    cl_copy_tuning_calibrate(device);
+}
+
+LOCAL void
+cl_copy_tuning_init_context(cl_context ctx)
+{
+  const char *env;
+
+  ctx->copy_kernel = -1;
+  ctx->fill_kernel = -1;
+  if ((env = getenv("OCL_COPY_KERNEL")) != NULL)
+    sscanf(env, "%i", &ctx->copy_kernel);
+  if ((env = getenv("OCL_FILL_KERNEL")) != NULL)
+    sscanf(env, "%i", &ctx->fill_kernel);
+}
+
+LOCAL int
+cl_copy_tuning_select(cl_context ctx, cl_bool fill, size_t size, size_t align, cl_bool block_ok)
+{
+  const int forced = fill ? ctx->fill_kernel : ctx->copy_kernel;
+  const int kernel_n = fill ? CL_FILL_TUNED_KERNEL_N : CL_COPY_TUNED_KERNEL_N;
+  int a = cl_copy_tuning_align_class(align);
+
+  if (a < 0)
+    return -1;
+  if (forced >= 0 && forced < kernel_n) {
+    const cl_copy_kernel_desc *descs = fill ? cl_fill_tuned_kernels : cl_copy_tuned_kernels;
+    return cl_copy_tuning_fits(&descs[forced], a, block_ok) ? forced : -1;
+  }
+  pthread_mutex_lock(&tuning_lock);
+  if (!tuning_done) {
+    cl_copy_tuning_init(ctx->devices[0]);
+    tuning_done = 1;
+  }
+  pthread_mutex_unlock(&tuning_lock);
+  if (tuning.mode == 0)
+    return -1;
+  return tuning.select[fill != 0][a][cl_copy_tuning_size_class(size)][block_ok != 0];
+}
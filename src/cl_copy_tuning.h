@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_COPY_TUNING_H__
+#define __CL_COPY_TUNING_H__
+#include "CL/cl.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of kernels in cl_internal_copy_buf_tuned.cl and
+ * cl_internal_fill_buf_tuned.cl */
+#define CL_COPY_TUNED_KERNEL_N 10
+#define CL_FILL_TUNED_KERNEL_N 6
+
+/* One of the calibrated copy or fill kernels */
+typedef struct cl_copy_kernel_desc {
+  const char *name;   /* Kernel name in the internal program */
+  uint8_t elem_size;  /* Bytes moved by a work-item per iteration */
+  uint8_t unroll;     /* Iterations of a work-item */
+  uint8_t block;      /* Uses the sub group block messages */
+} cl_copy_kernel_desc;
+
+extern const cl_copy_kernel_desc cl_copy_tuned_kernels[CL_COPY_TUNED_KERNEL_N];
+extern const cl_copy_kernel_desc cl_fill_tuned_kernels[CL_FILL_TUNED_KERNEL_N];
+
+/* Global size for a transfer of size bytes, the local size being
+ * CL_COPY_TUNED_LOCAL_SIZE */
+#define CL_COPY_TUNED_LOCAL_SIZE 64
+extern size_t cl_copy_tuned_global_size(const cl_copy_kernel_desc *desc, size_t size);
+
+/* Pick the kernel for a copy (or fill) of size bytes. align is the largest
+ * power of 2 dividing the offsets and the size, block_ok tells if the bound
+ * addresses are 16 bytes aligned. The choice comes from a default table, or
+ * from a calibration run once per process with OCL_COPY_TUNING=1; the
+ * OCL_COPY_KERNEL and OCL_FILL_KERNEL indexes of a context force a kernel
+ * when it fits. Returns the index of the kernel in cl_copy_tuned_kernels
+ * (cl_fill_tuned_kernels), or -1 to keep the fixed kernels: OCL_COPY_TUNING=0
+ * or no kernel fits the alignment */
+extern int cl_copy_tuning_select(cl_context ctx, cl_bool fill, size_t size,
+                                 size_t align, cl_bool block_ok);
+
+/* Read the forced kernels of a new context */
+extern void cl_copy_tuning_init_context(cl_context ctx);
+
+#endif /* __CL_COPY_TUNING_H__ */
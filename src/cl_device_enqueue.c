@@ -26,10 +26,13 @@
 #include "cl_command_queue.h"
 #include "cl_event.h"
 
+#include <stdio.h>
+#include <string.h>
+
 LOCAL cl_int
 cl_device_enqueue_fix_offset(cl_kernel ker) {
   uint32_t i;
-  void *ptr;
+  void *base, *ptr;
   cl_mem mem;
   enum gbe_arg_type arg_type; /* kind of argument */
   for (i = 0; i < ker->arg_n; ++i) {
@@ -40,11 +43,16 @@ cl_device_enqueue_fix_offset(cl_kernel ker) {
 
     if(!ker->args[i].is_svm) {
       mem = ker->args[i].mem;
-      ptr = cl_mem_map(mem, 0);
-      cl_buffer_set_softpin_offset(mem->bo, (size_t)ptr);
+      cl_mem_map(mem, 0);
+      /* The bo is pinned at its own address. The data of slab and userptr
+       * buffers start at their offset in it */
+      base = cl_buffer_get_virtual(mem->bo);
+      ptr = (char *)base + mem->offset;
+      cl_buffer_set_softpin_offset(mem->bo, (size_t)base);
       cl_buffer_set_bo_use_full_range(mem->bo, 1);
       cl_buffer_disable_reuse(mem->bo);
-      mem->host_ptr = ptr;
+      if (!mem->is_userptr)
+        mem->host_ptr = ptr;
       cl_mem_unmap(mem);
       ker->device_enqueue_infos[ker->device_enqueue_info_n++] = ptr;
     } else {
@@ -76,7 +84,7 @@ cl_device_enqueue_bind_buffer(cl_gpgpu gpgpu, cl_kernel ker, uint32_t *max_bti,
 
     mem = cl_context_get_svm_from_ptr(ker->program->ctx, ker->device_enqueue_ptr);
     assert(mem);
-    cl_gpgpu_bind_buf(gpgpu, mem->bo, offset, 0, buf_size, *max_bti);
+    cl_gpgpu_bind_buf(gpgpu, mem->bo, offset, mem->offset, buf_size, *max_bti);
 
     cl_gpgpu_set_kernel(gpgpu, ker);
   }
@@ -107,14 +115,151 @@ typedef struct Block_literal {
   // imported variables
 } Block_literal;
 
+/* The child kernel of a block. Children are created on their first enqueue
+ * and kept by the parent, their arguments are set again for every launch.
+ * Must be called with the parent's lock */
+static cl_kernel
+cl_device_enqueue_get_child_kernel(cl_kernel ker, uint32_t index)
+{
+  const char *kernel_name;
+
+  if (index >= ker->device_enqueue_kernel_n) {
+    uint32_t n = ker->device_enqueue_kernel_n ? ker->device_enqueue_kernel_n : 4;
+    cl_kernel *kernels;
+    while (n <= index)
+      n *= 2;
+    kernels = cl_realloc(ker->device_enqueue_kernels, n * sizeof(cl_kernel));
+    if (kernels == NULL)
+      return NULL;
+    memset(kernels + ker->device_enqueue_kernel_n, 0,
+           (n - ker->device_enqueue_kernel_n) * sizeof(cl_kernel));
+    ker->device_enqueue_kernels = kernels;
+    ker->device_enqueue_kernel_n = n;
+  }
+
+  if (ker->device_enqueue_kernels[index] == NULL) {
+    kernel_name = interp_program_get_device_enqueue_kernel_name(ker->program->opaque, index);
+    ker->device_enqueue_kernels[index] = cl_program_create_kernel(ker->program, kernel_name, NULL);
+  }
+  return ker->device_enqueue_kernels[index];
+}
+
+/* The launches of the children of one parent, each built in its own gpgpu */
+typedef struct child_launches_t {
+  cl_gpgpu *gpgpus;
+  uint32_t n;
+  uint32_t size;
+} child_launches_t;
+
+/* Build the launch of a child, split as clEnqueueNDRangeKernel does when the
+ * global size is not a multiple of the local size */
+static cl_int
+cl_device_enqueue_add_launch(cl_command_queue queue, cl_kernel child_ker,
+                             child_launches_t *launches, uint32_t work_dim,
+                             const size_t *global_off, const size_t *global_sz,
+                             const size_t *local_sz)
+{
+  const size_t global_wk_sz_div[3] = {
+    global_sz[0] / local_sz[0] * local_sz[0],
+    global_sz[1] / local_sz[1] * local_sz[1],
+    global_sz[2] / local_sz[2] * local_sz[2]};
+  const size_t global_wk_sz_rem[3] = {
+    global_sz[0] % local_sz[0],
+    global_sz[1] % local_sz[1],
+    global_sz[2] % local_sz[2]};
+  const size_t *global_wk_all[2] = {global_wk_sz_div, global_wk_sz_rem};
+  cl_gpgpu gpgpu;
+  cl_int err;
+  int i, j, k;
+
+  for (i = 0; i < 2; i++) {
+    for (j = 0; j < 2; j++) {
+      for (k = 0; k < 2; k++) {
+        size_t global_wk_sz_use[3] = {global_wk_all[k][0], global_wk_all[j][1], global_wk_all[i][2]};
+        size_t global_dim_off[3] = {
+          k * global_wk_sz_div[0] / local_sz[0],
+          j * global_wk_sz_div[1] / local_sz[1],
+          i * global_wk_sz_div[2] / local_sz[2]};
+        size_t local_wk_sz_use[3] = {
+          k ? global_wk_sz_rem[0] : local_sz[0],
+          j ? global_wk_sz_rem[1] : local_sz[1],
+          i ? global_wk_sz_rem[2] : local_sz[2]};
+        if (local_wk_sz_use[0] == 0 || local_wk_sz_use[1] == 0 || local_wk_sz_use[2] == 0)
+          continue;
+
+        if (launches->n == launches->size) {
+          uint32_t size = launches->size ? launches->size * 2 : 16;
+          cl_gpgpu *gpgpus = cl_realloc(launches->gpgpus, size * sizeof(cl_gpgpu));
+          if (gpgpus == NULL)
+            return CL_OUT_OF_HOST_MEMORY;
+          launches->gpgpus = gpgpus;
+          launches->size = size;
+        }
+
+        gpgpu = cl_gpgpu_new(queue->ctx->drv);
+        if (gpgpu == NULL)
+          return CL_OUT_OF_HOST_MEMORY;
+        err = cl_command_queue_build_ND_range(queue, child_ker, gpgpu, work_dim, global_off,
+                                              global_dim_off, global_sz, global_wk_sz_use,
+                                              local_sz, local_wk_sz_use);
+        if (err != CL_SUCCESS) {
+          cl_gpgpu_delete(gpgpu);
+          return err;
+        }
+        launches->gpgpus[launches->n++] = gpgpu;
+      }
+    }
+  }
+  return CL_SUCCESS;
+}
+
+/* Submit the children at once: one batch calls each of them as a second
+ * level batch, those which cannot be chained are flushed on their own. The
+ * children get no event, the device side events are not backed so the
+ * parent cannot ask for one, and the parent completes once they are done */
+static void
+cl_device_enqueue_submit(cl_command_queue queue, child_launches_t *launches)
+{
+  cl_gpgpu gpgpu, chain;
+  void *buf;
+  uint32_t i;
+
+  if (launches->n == 0)
+    return;
+
+  chain = cl_gpgpu_new(queue->ctx->drv);
+  if (chain && cl_gpgpu_batch_reset(chain, launches->n * 16 + 64) != 0) {
+    cl_gpgpu_delete(chain);
+    chain = NULL;
+  }
+  for (i = 0; i < launches->n; ++i)
+    if (chain == NULL || cl_gpgpu_batch_chain(chain, launches->gpgpus[i]) != 0)
+      cl_gpgpu_flush(launches->gpgpus[i]);
+  if (chain)
+    cl_gpgpu_flush(chain);
+
+  for (i = 0; i < launches->n; ++i) {
+    gpgpu = launches->gpgpus[i];
+    //Can't call clWaitForEvents here, it may cause dead lock.
+    buf = cl_gpgpu_ref_batch_buf(gpgpu);
+    cl_gpgpu_sync(buf);
+    cl_gpgpu_unref_batch_buf(buf);
+    cl_command_queue_output_profiling(gpgpu);
+    cl_command_queue_finish_printf(queue, gpgpu, CL_TRUE);
+    /* The children may enqueue kernels as well */
+    cl_device_enqueue_parse_result(queue, gpgpu);
+    cl_gpgpu_delete(gpgpu);
+  }
+  cl_gpgpu_delete(chain);
+}
+
 LOCAL cl_int
 cl_device_enqueue_parse_result(cl_command_queue queue, cl_gpgpu gpgpu)
 {
   cl_mem mem;
   int size, type, dim, i;
-  const char * kernel_name;
   cl_kernel child_ker;
-  cl_event evt = NULL;
+  child_launches_t launches = {NULL, 0, 0};
 
   cl_kernel ker = cl_gpgpu_get_kernel(gpgpu);
   if(ker == NULL || ker->useDeviceEnqueue == CL_FALSE)
@@ -161,9 +306,13 @@ cl_device_enqueue_parse_result(cl_command_queue queue, cl_gpgpu gpgpu)
     size -= slm_size;
     ptr += slm_size;
 
-    kernel_name = interp_program_get_device_enqueue_kernel_name(ker->program->opaque, block->index);
-    child_ker = cl_program_create_kernel(ker->program, kernel_name, NULL);
+    CL_OBJECT_LOCK(ker);
+    child_ker = cl_device_enqueue_get_child_kernel(ker, block->index);
+    CL_OBJECT_UNLOCK(ker);
     assert(child_ker);
+
+    /* The arguments of the child are only read while its launch is built */
+    CL_OBJECT_LOCK(child_ker);
     cl_kernel_set_arg_svm_pointer(child_ker, 0, block);
     int index = 1;
     for(i=0; i<slm_size/sizeof(int); i++, index++) {
@@ -171,31 +320,15 @@ cl_device_enqueue_parse_result(cl_command_queue queue, cl_gpgpu gpgpu)
     }
     cl_kernel_set_exec_info(child_ker, ker->device_enqueue_info_n * sizeof(void *),
                             ker->device_enqueue_infos);
-
-    if (evt != NULL) {
-      clReleaseEvent(evt);
-      evt = NULL;
-    }
-    clEnqueueNDRangeKernel(queue, child_ker, dim + 1, fixed_global_off,
-                           fixed_global_sz, fixed_local_sz, 0, NULL, &evt);
-    cl_command_queue_flush_gpgpu(gpgpu);
-    cl_kernel_delete(child_ker);
+    if (cl_device_enqueue_add_launch(queue, child_ker, &launches, dim + 1, fixed_global_off,
+                                     fixed_global_sz, fixed_local_sz) != CL_SUCCESS)
+      DEBUGP(DL_ERROR, "Could not build the launch of a child kernel.");
+    CL_OBJECT_UNLOCK(child_ker);
   }
 
-  if (evt != NULL) {
-    //Can't call clWaitForEvents here, it may cause dead lock.
-    //If evt->exec_data.gpgpu is NULL, evt has finished.
-    if (evt->exec_data.gpgpu) {
-      buf = cl_gpgpu_ref_batch_buf(evt->exec_data.gpgpu);
-      //wait the gpgpu's batch buf finish, the gpgpu in queue may be not
-      //same as the param gpgpu, for example when flush event.
-      cl_gpgpu_sync(buf);
-      cl_gpgpu_unref_batch_buf(buf);
-    }
-    clReleaseEvent(evt);
-    evt = NULL;
-  }
   cl_mem_unmap_auto(mem);
+  cl_device_enqueue_submit(queue, &launches);
+  cl_free(launches.gpgpus);
   cl_kernel_delete(ker);
   return 0;
 }
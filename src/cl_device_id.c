@@ -17,6 +17,9 @@
  * Author: Benjamin Segovia <benjamin.segovia@intel.com>
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* dladdr */
+#endif
 #include "cl_platform_id.h"
 #include "cl_device_id.h"
 #include "cl_internals.h"
@@ -35,6 +38,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/sysinfo.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #ifndef CL_VERSION_1_2
 #define CL_DEVICE_BUILT_IN_KERNELS 0x103F
@@ -806,7 +816,7 @@ glk12eu_break:
     return NULL;
 
   CL_OBJECT_INIT_BASE(ret, CL_OBJECT_DEVICE_MAGIC);
-  if (!CompilerSupported()) {
+  if (!CompilerAvailable()) {
     ret->compiler_available = CL_FALSE;
     //ret->linker_available = CL_FALSE;
     ret->profile = "EMBEDDED_PROFILE";
@@ -839,6 +849,18 @@ glk12eu_break:
   return ret;
 }
 
+/* Returns the self-test kernel prebuilt for every family as one fat binary,
+ * clCreateProgramWithBinary picks the entry of the device. */
+static const unsigned char *
+cl_self_test_binary(cl_device_id device, size_t *size)
+{
+  extern char cl_internal_self_test_fat_str[];
+  extern size_t cl_internal_self_test_fat_str_size;
+
+  *size = cl_internal_self_test_fat_str_size;
+  return (const unsigned char *)cl_internal_self_test_fat_str;
+}
+
 /* Runs a small kernel to check that the device works; returns
  * SELF_TEST_PASS: for success.
  * SELF_TEST_SLM_FAIL: for SLM results mismatch;
@@ -856,12 +878,9 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   cl_event kernel_finished;
   size_t n = 3;
   cl_int test_data[3] = {3, 7, 5};
-  const char* kernel_source = "__kernel void self_test(__global int *buf) {"
-  "  __local int tmp[3];"
-  "  tmp[get_local_id(0)] = buf[get_local_id(0)];"
-  "  barrier(CLK_LOCAL_MEM_FENCE);"
-  "  buf[get_global_id(0)] = tmp[2 - get_local_id(0)] + buf[get_global_id(0)];"
-  "}"; // using __local to catch the "no SLM on Haswell" problem
+  /* The source the prebuilt binary comes from, kernels/cl_internal_self_test.cl */
+  extern char cl_internal_self_test_src_str[];
+  const char* kernel_source = cl_internal_self_test_src_str;
   static int tested = 0;
   static cl_self_test_res ret = SELF_TEST_OTHER_FAIL;
   if (tested != 0)
@@ -874,7 +893,15 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   if (status == CL_SUCCESS) {
     queue = clCreateCommandQueueWithProperties(ctx, device, 0, &status);
     if (status == CL_SUCCESS) {
-      program = clCreateProgramWithSource(ctx, 1, &kernel_source, NULL, &status);
+      size_t binary_size = 0;
+      const unsigned char *binary = cl_self_test_binary(device, &binary_size);
+      program = NULL;
+      /* The prebuilt binary avoids starting the compiler at all. Fall back to
+       * the source if it does not match the device. */
+      if (binary)
+        program = clCreateProgramWithBinary(ctx, 1, &device, &binary_size, &binary, NULL, &status);
+      if (program == NULL)
+        program = clCreateProgramWithSource(ctx, 1, &kernel_source, NULL, &status);
       if (status == CL_SUCCESS) {
         status = clBuildProgram(program, 1, &device, "", NULL, NULL);
         if (status == CL_SUCCESS) {
@@ -919,6 +946,118 @@ cl_self_test(cl_device_id device, cl_self_test_res atomic_in_l3_flag)
   return ret;
 }
 
+/* The self-test verdict only depends on the device, the kernel driver and
+ * this library. It is kept in $XDG_CACHE_HOME/beignet (~/.cache/beignet by
+ * default) so that the processes coming after the first one do not have to
+ * run any kernel. OCL_SELF_TEST_CACHE=0 disables the cache. */
+#define SELF_TEST_CACHE_KEY_LEN 512
+
+static int
+cl_self_test_cache_enabled(void)
+{
+  int enabled = 1;
+  // can't use BVAR (backend/src/sys/cvar.hpp) here as it's C++
+  const char *env = getenv("OCL_SELF_TEST_CACHE");
+  if (env != NULL)
+    sscanf(env, "%i", &enabled);
+  return enabled;
+}
+
+static int
+cl_self_test_cache_path(cl_device_id device, char *path, size_t len, int create)
+{
+  const char *base = getenv("XDG_CACHE_HOME");
+  char dir[PATH_MAX];
+
+  if (base != NULL && base[0] == '/')
+    snprintf(dir, sizeof(dir), "%s/beignet", base);
+  else if ((base = getenv("HOME")) != NULL && base[0] == '/') {
+    snprintf(dir, sizeof(dir), "%s/.cache", base);
+    if (create)
+      mkdir(dir, 0700);
+    snprintf(dir, sizeof(dir), "%s/.cache/beignet", base);
+  } else
+    return 0;
+  if (create && mkdir(dir, 0700) != 0 && errno != EEXIST)
+    return 0;
+  return snprintf(path, len, "%s/self_test_%04x", dir, device->device_id) < (int)len;
+}
+
+/* Identifies the kernel driver and the library build the verdict was
+ * computed with. The library is identified by its version and the time
+ * stamp and size of the shared object, the i915 driver by the kernel release
+ * and its PPGTT mode which decides if SLM works on Haswell. */
+static void
+cl_self_test_cache_key(char *key, size_t len)
+{
+  struct utsname name;
+  struct stat st;
+  Dl_info info;
+  char ppgtt[16] = "-";
+  FILE *f;
+
+  memset(&name, 0, sizeof(name));
+  memset(&st, 0, sizeof(st));
+  uname(&name);
+  if (dladdr((void *)cl_self_test, &info) && info.dli_fname)
+    stat(info.dli_fname, &st);
+  if ((f = fopen("/sys/module/i915/parameters/enable_ppgtt", "r")) != NULL) {
+    if (fscanf(f, "%15s", ppgtt) != 1)
+      strcpy(ppgtt, "-");
+    fclose(f);
+  }
+  snprintf(key, len, "%s %ld %ld|%s|%s|%s", LIBCL_DRIVER_VERSION_STRING BEIGNET_GIT_SHA1_STRING,
+           (long)st.st_mtime, (long)st.st_size, name.release, name.version, ppgtt);
+}
+
+static int
+cl_self_test_cache_load(cl_device_id device, cl_self_test_res *atomic, cl_self_test_res *ret)
+{
+  char path[PATH_MAX], key[SELF_TEST_CACHE_KEY_LEN], stored[SELF_TEST_CACHE_KEY_LEN];
+  int a, r, hit = 0;
+  FILE *f;
+
+  if (!cl_self_test_cache_path(device, path, sizeof(path), 0))
+    return 0;
+  if ((f = fopen(path, "r")) == NULL)
+    return 0;
+  cl_self_test_cache_key(key, sizeof(key));
+  if (fgets(stored, sizeof(stored), f) != NULL) {
+    stored[strcspn(stored, "\n")] = '\0';
+    if (strcmp(stored, key) == 0 && fscanf(f, "%d %d", &a, &r) == 2 &&
+        (a == SELF_TEST_PASS || a == SELF_TEST_ATOMIC_FAIL) &&
+        (r == SELF_TEST_PASS || r == SELF_TEST_SLM_FAIL)) {
+      *atomic = a;
+      *ret = r;
+      hit = 1;
+    }
+  }
+  fclose(f);
+  return hit;
+}
+
+static void
+cl_self_test_cache_store(cl_device_id device, cl_self_test_res atomic, cl_self_test_res ret)
+{
+  char path[PATH_MAX], tmp[PATH_MAX], key[SELF_TEST_CACHE_KEY_LEN];
+  FILE *f;
+
+  /* Runtime API failures may be transient, never remember them */
+  if (ret != SELF_TEST_PASS && ret != SELF_TEST_SLM_FAIL)
+    return;
+  if (!cl_self_test_cache_path(device, path, sizeof(path), 1))
+    return;
+  if (snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid()) >= (int)sizeof(tmp))
+    return;
+  if ((f = fopen(tmp, "w")) == NULL)
+    return;
+  cl_self_test_cache_key(key, sizeof(key));
+  fprintf(f, "%s\n%d %d\n", key, atomic, ret);
+  /* Concurrent processes may race here, rename keeps the file consistent */
+  if (fclose(f) != 0 || rename(tmp, path) != 0)
+    unlink(tmp);
+}
+
 LOCAL cl_int
 cl_get_device_ids(cl_platform_id    platform,
                   cl_device_type    device_type,
@@ -931,12 +1070,35 @@ cl_get_device_ids(cl_platform_id    platform,
   /* Do we have a usable device? */
   device = cl_get_gt_device(device_type);
   if (device) {
-    cl_self_test_res ret = cl_self_test(device, SELF_TEST_PASS);
-    if (ret == SELF_TEST_ATOMIC_FAIL) {
-      device->atomic_test_result = ret;
-      ret = cl_self_test(device, ret);
-      printf("Beignet: warning - disable atomic in L3 feature.\n");
+    /* Threads calling clGetDeviceIDs for the first time wait for the one
+     * running the self-test */
+    static pthread_mutex_t self_test_lock = PTHREAD_MUTEX_INITIALIZER;
+    static int self_test_done = 0;
+    static cl_self_test_res self_test_ret = SELF_TEST_OTHER_FAIL;
+    cl_self_test_res ret, atomic = SELF_TEST_PASS;
+
+    pthread_mutex_lock(&self_test_lock);
+    if (!self_test_done) {
+      if (cl_self_test_cache_enabled() &&
+          cl_self_test_cache_load(device, &atomic, &self_test_ret)) {
+        device->atomic_test_result = atomic;
+        if (atomic == SELF_TEST_ATOMIC_FAIL)
+          printf("Beignet: warning - disable atomic in L3 feature.\n");
+      } else {
+        self_test_ret = cl_self_test(device, SELF_TEST_PASS);
+        if (self_test_ret == SELF_TEST_ATOMIC_FAIL) {
+          atomic = self_test_ret;
+          device->atomic_test_result = self_test_ret;
+          self_test_ret = cl_self_test(device, self_test_ret);
+          printf("Beignet: warning - disable atomic in L3 feature.\n");
+        }
+        if (cl_self_test_cache_enabled())
+          cl_self_test_cache_store(device, atomic, self_test_ret);
+      }
+      self_test_done = 1;
     }
+    ret = self_test_ret;
+    pthread_mutex_unlock(&self_test_lock);
 
     if(ret == SELF_TEST_SLM_FAIL) {
       int disable_self_test = 0;
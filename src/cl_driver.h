@@ -143,6 +143,11 @@ extern cl_gpgpu_delete_cb *cl_gpgpu_delete;
 typedef void (cl_gpgpu_sync_cb)(void*);
 extern cl_gpgpu_sync_cb *cl_gpgpu_sync;
 
+/* Wait at most timeout_ns (negative means forever) for the batch buffer to
+ * retire. Returns 0 when it is idle, -ETIME when it is still running */
+typedef int (cl_gpgpu_wait_cb)(void*, int64_t timeout_ns);
+extern cl_gpgpu_wait_cb *cl_gpgpu_wait;
+
 /* Bind a regular unformatted buffer */
 typedef void (cl_gpgpu_bind_buf_cb)(cl_gpgpu, cl_buffer, uint32_t offset, uint32_t internal_offset, size_t size, uint8_t bti);
 extern cl_gpgpu_bind_buf_cb *cl_gpgpu_bind_buf;
@@ -247,6 +252,12 @@ extern cl_gpgpu_batch_end_cb *cl_gpgpu_batch_end;
 typedef int (cl_gpgpu_flush_cb)(cl_gpgpu);
 extern cl_gpgpu_flush_cb *cl_gpgpu_flush;
 
+/* Close the batch of the second gpgpu and call it from the first one as a
+ * second level batch, instead of flushing it on its own. Returns -1 if the
+ * device cannot chain batches */
+typedef int (cl_gpgpu_batch_chain_cb)(cl_gpgpu, cl_gpgpu);
+extern cl_gpgpu_batch_chain_cb *cl_gpgpu_batch_chain;
+
 /* new a event for a batch buffer */
 typedef cl_gpgpu_event (cl_gpgpu_event_new_cb)(cl_gpgpu);
 extern cl_gpgpu_event_new_cb *cl_gpgpu_event_new;
@@ -299,18 +310,23 @@ extern cl_gpgpu_map_profiling_buffer_cb *cl_gpgpu_map_profiling_buffer;
 typedef void (cl_gpgpu_unmap_profiling_buffer_cb)(cl_gpgpu);
 extern cl_gpgpu_unmap_profiling_buffer_cb *cl_gpgpu_unmap_profiling_buffer;
 
-/* Set the printf buffer */
-typedef int (cl_gpgpu_set_printf_buffer_cb)(cl_gpgpu, uint32_t, uint8_t);
+/* Set the printf buffer: size bytes at offset in the bo. The other parts of
+ * the bo may still be in use by the GPU */
+typedef int (cl_gpgpu_set_printf_buffer_cb)(cl_gpgpu, cl_buffer bo, uint32_t offset, uint32_t size, uint8_t bti);
 extern cl_gpgpu_set_printf_buffer_cb *cl_gpgpu_set_printf_buffer;
 
 /* get the printf buffer offset in the apeture*/
 typedef unsigned long (cl_gpgpu_reloc_printf_buffer_cb)(cl_gpgpu, uint32_t, uint32_t);
 extern cl_gpgpu_reloc_printf_buffer_cb *cl_gpgpu_reloc_printf_buffer;
 
-/* map the printf buffer */
-typedef void* (cl_gpgpu_map_printf_buffer_cb)(cl_gpgpu);
+/* map the printf buffer, once the kernel is done, and get its size */
+typedef void* (cl_gpgpu_map_printf_buffer_cb)(cl_gpgpu, uint32_t *size);
 extern cl_gpgpu_map_printf_buffer_cb *cl_gpgpu_map_printf_buffer;
 
+/* Get the bo of the printf buffer */
+typedef cl_buffer (cl_gpgpu_get_printf_buffer_cb)(cl_gpgpu);
+extern cl_gpgpu_get_printf_buffer_cb *cl_gpgpu_get_printf_buffer;
+
 /* unmap the printf buffer */
 typedef void (cl_gpgpu_unmap_printf_buffer_cb)(cl_gpgpu);
 extern cl_gpgpu_unmap_printf_buffer_cb *cl_gpgpu_unmap_printf_buffer;
@@ -343,6 +359,19 @@ extern cl_gpgpu_walker_cb *cl_gpgpu_walker;
 typedef cl_buffer (cl_buffer_alloc_cb)(cl_buffer_mgr, const char*, size_t, size_t);
 extern cl_buffer_alloc_cb *cl_buffer_alloc;
 
+/* Get a buffer holding the given kernel code and its cache entry. Kernels
+ * with the same code share the buffer of their driver */
+typedef cl_buffer (cl_buffer_get_kernel_code_cb)(cl_driver, const char *code, size_t size, cl_kernel_code *entry);
+extern cl_buffer_get_kernel_code_cb *cl_buffer_get_kernel_code;
+
+/* Add a user to a kernel code entry already known */
+typedef void (cl_buffer_ref_kernel_code_cb)(cl_driver, cl_kernel_code);
+extern cl_buffer_ref_kernel_code_cb *cl_buffer_ref_kernel_code;
+
+/* Release a user of a kernel code entry, its buffer goes with the last one */
+typedef void (cl_buffer_put_kernel_code_cb)(cl_driver, cl_kernel_code);
+extern cl_buffer_put_kernel_code_cb *cl_buffer_put_kernel_code;
+
 typedef cl_buffer (cl_buffer_alloc_userptr_cb)(cl_buffer_mgr, const char*, void *, size_t, unsigned long);
 extern cl_buffer_alloc_userptr_cb *cl_buffer_alloc_userptr;
 
@@ -399,6 +428,15 @@ extern cl_buffer_map_gtt_cb *cl_buffer_map_gtt;
 typedef int (cl_buffer_map_gtt_unsync_cb)(cl_buffer);
 extern cl_buffer_map_gtt_unsync_cb *cl_buffer_map_gtt_unsync;
 
+/* Tell if the addresses of the CPU mapping of a tiled buffer are bit 6
+ * swizzled. Tiles can only be (de)swizzled in software when they are not */
+typedef int (cl_buffer_is_swizzled_cb)(cl_buffer);
+extern cl_buffer_is_swizzled_cb *cl_buffer_is_swizzled;
+
+/* Tell if the GPU still has pending work on the buffer */
+typedef int (cl_buffer_is_busy_cb)(cl_buffer);
+extern cl_buffer_is_busy_cb *cl_buffer_is_busy;
+
 /* Unmap a buffer in the GTT domain */
 typedef int (cl_buffer_unmap_gtt_cb)(cl_buffer);
 extern cl_buffer_unmap_gtt_cb *cl_buffer_unmap_gtt;
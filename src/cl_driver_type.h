@@ -10,6 +10,9 @@
 /* Encapsulates command buffer / data buffer / kernels */
 typedef struct _cl_buffer *cl_buffer;
 
+/* Encapsulates a kernel code buffer shared by the kernels with the same code */
+typedef struct _cl_kernel_code *cl_kernel_code;
+
 /* Encapsulates buffer manager */
 typedef struct _cl_buffer_mgr *cl_buffer_mgr;
 
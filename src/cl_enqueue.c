@@ -25,6 +25,7 @@
 #include "cl_utils.h"
 #include "cl_alloc.h"
 #include "cl_device_enqueue.h"
+#include "cl_memcpy.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -42,24 +43,15 @@ cl_enqueue_read_buffer(enqueue_data *data, cl_int status)
   assert(mem->type == CL_MEM_BUFFER_TYPE ||
          mem->type == CL_MEM_SUBBUFFER_TYPE);
   struct _cl_mem_buffer *buffer = (struct _cl_mem_buffer *)mem;
-  //cl_buffer_get_subdata sometime is very very very slow in linux kernel, in skl and chv,
-  //and it is randomly. So temporary disable it, use map/copy/unmap to read.
-  //Should re-enable it after find root cause.
-  if (0 && !mem->is_userptr) {
-    if (cl_buffer_get_subdata(mem->bo, data->offset + buffer->sub_offset,
-                              data->size, data->ptr) != 0)
-      err = CL_MAP_FAILURE;
-  } else {
-    void *src_ptr = cl_mem_map_auto(mem, 0);
-    if (src_ptr == NULL)
-      err = CL_MAP_FAILURE;
-    else {
-      //sometimes, application invokes read buffer, instead of map buffer, even if userptr is enabled
-      //memcpy is not necessary for this case
-      if (data->ptr != (char *)src_ptr + data->offset + buffer->sub_offset)
-        memcpy(data->ptr, (char *)src_ptr + data->offset + buffer->sub_offset, data->size);
-      cl_mem_unmap_auto(mem);
-    }
+  void *src_ptr = cl_mem_map_auto(mem, 0);
+  if (src_ptr == NULL)
+    err = CL_MAP_FAILURE;
+  else {
+    //sometimes, application invokes read buffer, instead of map buffer, even if userptr is enabled
+    //memcpy is not necessary for this case
+    if (data->ptr != (char *)src_ptr + data->offset + buffer->sub_offset)
+      cl_memcpy(data->ptr, (char *)src_ptr + data->offset + buffer->sub_offset, data->size, CL_FALSE);
+    cl_mem_unmap_auto(mem);
   }
   return err;
 }
@@ -97,14 +89,14 @@ cl_enqueue_read_buffer_rect(enqueue_data *data, cl_int status)
 
   if (data->row_pitch == region[0] && data->row_pitch == data->host_row_pitch &&
       (region[2] == 1 || (data->slice_pitch == region[0] * region[1] && data->slice_pitch == data->host_slice_pitch))) {
-    memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
+    cl_memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2], CL_FALSE);
   } else {
     cl_uint y, z;
     for (z = 0; z < region[2]; z++) {
       const char *src = src_ptr;
       char *dst = dst_ptr;
       for (y = 0; y < region[1]; y++) {
-        memcpy(dst, src, region[0]);
+        cl_memcpy(dst, src, region[0], CL_FALSE);
         src += data->row_pitch;
         dst += data->host_row_pitch;
       }
@@ -131,16 +123,18 @@ cl_enqueue_write_buffer(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
-  if (mem->is_userptr) {
+  /* Large writes are mapped to be copied by several threads, pwrite only
+   * uses one */
+  if (mem->is_userptr || cl_memcpy_is_parallel(data->size)) {
     void *dst_ptr = cl_mem_map_auto(mem, 1);
     if (dst_ptr == NULL)
       err = CL_MAP_FAILURE;
     else {
-      memcpy((char *)dst_ptr + data->offset + buffer->sub_offset, data->const_ptr, data->size);
+      cl_memcpy((char *)dst_ptr + data->offset + buffer->sub_offset, data->const_ptr, data->size, CL_TRUE);
       cl_mem_unmap_auto(mem);
     }
   } else {
-    if (cl_buffer_subdata(mem->bo, data->offset + buffer->sub_offset,
+    if (cl_buffer_subdata(mem->bo, mem->offset + data->offset + buffer->sub_offset,
                           data->size, data->const_ptr) != 0)
       err = CL_MAP_FAILURE;
   }
@@ -180,14 +174,14 @@ cl_enqueue_write_buffer_rect(enqueue_data *data, cl_int status)
 
   if (data->row_pitch == region[0] && data->row_pitch == data->host_row_pitch &&
       (region[2] == 1 || (data->slice_pitch == region[0] * region[1] && data->slice_pitch == data->host_slice_pitch))) {
-    memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2]);
+    cl_memcpy(dst_ptr, src_ptr, region[2] == 1 ? data->row_pitch * region[1] : data->slice_pitch * region[2], CL_TRUE);
   } else {
     cl_uint y, z;
     for (z = 0; z < region[2]; z++) {
       const char *src = src_ptr;
       char *dst = dst_ptr;
       for (y = 0; y < region[1]; y++) {
-        memcpy(dst, src, region[0]);
+        cl_memcpy(dst, src, region[0], CL_FALSE);
         src += data->host_row_pitch;
         dst += data->row_pitch;
       }
@@ -216,6 +210,16 @@ cl_enqueue_read_image(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
+  if (cl_mem_image_cpu_tiling(image)) {
+    if (!(src_ptr = cl_mem_map(mem, 0))) {
+      err = CL_MAP_FAILURE;
+      goto error;
+    }
+    cl_mem_copy_image_region_tiled(origin, region, src_ptr, data->ptr,
+                                   data->row_pitch, data->slice_pitch, image, CL_FALSE);
+    return cl_mem_unmap(mem);
+  }
+
   if (!(src_ptr = cl_mem_map_auto(mem, 0))) {
     err = CL_MAP_FAILURE;
     goto error;
@@ -261,6 +265,16 @@ cl_enqueue_write_image(enqueue_data *data, cl_int status)
   if (status != CL_COMPLETE)
     return err;
 
+  if (cl_mem_image_cpu_tiling(image)) {
+    if (!(dst_ptr = cl_mem_map(mem, 1))) {
+      err = CL_MAP_FAILURE;
+      goto error;
+    }
+    cl_mem_copy_image_region_tiled(data->origin, data->region, dst_ptr, (void *)data->const_ptr,
+                                   data->row_pitch, data->slice_pitch, image, CL_TRUE);
+    return cl_mem_unmap(mem);
+  }
+
   if (!(dst_ptr = cl_mem_map_auto(mem, 1))) {
     err = CL_MAP_FAILURE;
     goto error;
@@ -562,6 +576,56 @@ cl_int cl_enqueue_svm_mem_fill(enqueue_data *data, cl_int status) {
   return CL_SUCCESS;
 }
 
+static cl_int
+cl_enqueue_copy_buffer_host(enqueue_data *data, cl_int status)
+{
+  cl_mem src = data->mem_obj;
+  cl_mem dst = data->dst_mem_obj;
+  char *src_ptr, *dst_ptr;
+
+  if (status != CL_COMPLETE)
+    return CL_SUCCESS;
+
+  if (!(src_ptr = cl_mem_map_auto(src, 0)))
+    return CL_MAP_FAILURE;
+  if (!(dst_ptr = cl_mem_map_auto(dst, 1))) {
+    cl_mem_unmap_auto(src);
+    return CL_MAP_FAILURE;
+  }
+
+  memcpy(dst_ptr + ((struct _cl_mem_buffer *)dst)->sub_offset + data->dst_offset,
+         src_ptr + ((struct _cl_mem_buffer *)src)->sub_offset + data->offset, data->size);
+
+  cl_mem_unmap_auto(dst);
+  cl_mem_unmap_auto(src);
+  return CL_SUCCESS;
+}
+
+static cl_int
+cl_enqueue_fill_buffer_host(enqueue_data *data, cl_int status)
+{
+  cl_mem mem = data->mem_obj;
+  const size_t pattern_size = data->pattern_size;
+  char *ptr, *end;
+
+  if (status != CL_COMPLETE)
+    return CL_SUCCESS;
+
+  if (!(ptr = cl_mem_map_auto(mem, 1)))
+    return CL_MAP_FAILURE;
+
+  ptr += ((struct _cl_mem_buffer *)mem)->sub_offset + data->offset;
+  end = ptr + data->size;
+  if (pattern_size == 1)
+    memset(ptr, *(const char *)data->const_ptr, data->size);
+  else
+    for (; ptr < end; ptr += pattern_size)
+      memcpy(ptr, data->const_ptr, pattern_size);
+
+  cl_mem_unmap_auto(mem);
+  return CL_SUCCESS;
+}
+
 static cl_int
 cl_enqueue_ndrange(enqueue_data *data, cl_int status)
 {
@@ -579,6 +643,9 @@ cl_enqueue_ndrange(enqueue_data *data, cl_int status)
     void *batch_buf = cl_gpgpu_ref_batch_buf(data->gpgpu);
     cl_gpgpu_sync(batch_buf);
     cl_gpgpu_unref_batch_buf(batch_buf);
+    /* The printf output is formatted here, by the queue worker for the
+     * asynchronous launches, instead of blocking the enqueue on the kernel */
+    cl_command_queue_finish_printf(data->queue, data->gpgpu, CL_TRUE);
   }
 
   return err;
@@ -605,12 +672,21 @@ cl_enqueue_delete(enqueue_data *data)
       data->type == EnqueueFillBuffer ||
       data->type == EnqueueFillImage) {
     if (data->gpgpu) {
+      cl_command_queue_finish_printf(data->queue, data->gpgpu, CL_FALSE);
       cl_gpgpu_delete(data->gpgpu);
       data->gpgpu = NULL;
     }
     return;
   }
 
+  if (data->type == EnqueueFillBufferHost) {
+    if (data->const_ptr) {
+      cl_free((void*)data->const_ptr);
+      data->const_ptr = NULL;
+    }
+    return;
+  }
+
   if (data->type == EnqueueNativeKernel) {
     if (data->mem_list) {
       cl_free((void*)data->mem_list);
@@ -627,6 +703,35 @@ cl_enqueue_delete(enqueue_data *data)
   }
 }
 
+LOCAL cl_bool
+cl_enqueue_wait_gpu(enqueue_data *data, int64_t timeout_ns)
+{
+  void *batch_buf;
+  int ret;
+
+  switch (data->type) {
+  case EnqueueCopyBufferRect:
+  case EnqueueCopyBuffer:
+  case EnqueueCopyImage:
+  case EnqueueCopyBufferToImage:
+  case EnqueueCopyImageToBuffer:
+  case EnqueueNDRangeKernel:
+  case EnqueueFillBuffer:
+  case EnqueueFillImage:
+    break;
+  default:
+    return CL_TRUE;
+  }
+
+  if (data->gpgpu == NULL)
+    return CL_TRUE;
+
+  batch_buf = cl_gpgpu_ref_batch_buf(data->gpgpu);
+  ret = cl_gpgpu_wait(batch_buf, timeout_ns);
+  cl_gpgpu_unref_batch_buf(batch_buf);
+  return ret == 0;
+}
+
 LOCAL cl_int
 cl_enqueue_handle(enqueue_data *data, cl_int status)
 {
@@ -657,6 +762,10 @@ cl_enqueue_handle(enqueue_data *data, cl_int status)
     return cl_enqueue_svm_mem_copy(data, status);
   case EnqueueSVMMemFill:
     return cl_enqueue_svm_mem_fill(data, status);
+  case EnqueueCopyBufferHost:
+    return cl_enqueue_copy_buffer_host(data, status);
+  case EnqueueFillBufferHost:
+    return cl_enqueue_fill_buffer_host(data, status);
   case EnqueueMarker:
   case EnqueueBarrier:
     return cl_enqueue_marker_or_barrier(data, status);
@@ -49,12 +49,16 @@ typedef enum {
   EnqueueSVMFree,
   EnqueueSVMMemCopy,
   EnqueueSVMMemFill,
+  EnqueueCopyBufferHost,     /* Small clEnqueueCopyBuffer done by the CPU */
+  EnqueueFillBufferHost,     /* Small clEnqueueFillBuffer done by the CPU */
   EnqueueInvalid
 } enqueue_type;
 
 typedef struct _enqueue_data {
   enqueue_type type;         /* Command type */
   cl_mem mem_obj;            /* Enqueue's cl_mem */
+  cl_mem dst_mem_obj;        /* Destination cl_mem of the host buffer copy */
+  size_t dst_offset;         /* Destination offset of the host buffer copy */
   cl_command_queue queue;    /* Command queue */
   size_t offset;             /* Mem object's offset */
   size_t size;               /* Size */
@@ -86,5 +90,8 @@ typedef struct _enqueue_data {
 /* Do real enqueue commands */
 extern cl_int cl_enqueue_handle(enqueue_data *data, cl_int status);
 extern void cl_enqueue_delete(enqueue_data *data);
+/* Wait at most timeout_ns for the GPU work of a submitted command, returns
+ * CL_FALSE if it is still running. Commands without GPU work are done */
+extern cl_bool cl_enqueue_wait_gpu(enqueue_data *data, int64_t timeout_ns);
 
 #endif /* __CL_ENQUEUE_H__ */
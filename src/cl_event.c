@@ -149,7 +149,7 @@ cl_event_new(cl_context ctx, cl_command_queue queue, cl_command_type type,
              cl_uint num_events, cl_event *event_list)
 {
   int i;
-  cl_event e = cl_calloc(1, sizeof(_cl_event));
+  cl_event e = cl_free_list_get(&ctx->event_pool);
   if (e == NULL)
     return NULL;
 
@@ -211,15 +211,14 @@ cl_event_delete(cl_event event)
   while (!list_empty(&event->callbacks)) {
     cb = list_entry(event->callbacks.head_node.n, _cl_event_user_callback, node);
     list_node_del(&cb->node);
-    cl_free(cb);
+    cl_free_list_put(&event->ctx->event_cb_pool, cb);
   }
 
-  /* Remove it from the list */
+  CL_OBJECT_DESTROY_BASE(event);
+
+  /* Give the event back to the context pool, may release the context */
   assert(event->ctx);
   cl_context_remove_event(event->ctx, event);
-
-  CL_OBJECT_DESTROY_BASE(event);
-  cl_free(event);
 }
 
 LOCAL cl_event
@@ -320,7 +319,7 @@ cl_event_set_callback(cl_event event, cl_int exec_type, cl_event_notify_cb pfn_n
   assert(pfn_notify);
 
   do {
-    cb = cl_calloc(1, sizeof(_cl_event_user_callback));
+    cb = cl_free_list_get(&event->ctx->event_cb_pool);
     if (cb == NULL) {
       err = CL_OUT_OF_HOST_MEMORY;
       break;
@@ -349,7 +348,7 @@ cl_event_set_callback(cl_event event, cl_int exec_type, cl_event_notify_cb pfn_n
   } while (0);
 
   if (cb)
-    cl_free(cb);
+    cl_free_list_put(&event->ctx->event_cb_pool, cb);
 
   return err;
 }
@@ -405,7 +404,7 @@ cl_event_set_status(cl_event event, cl_int status)
         list_node_del(&cb->node);
         cb->executed = CL_TRUE;
         cb->pfn_notify(event, status, cb->user_data);
-        cl_free(cb);
+        cl_free_list_put(&event->ctx->event_cb_pool, cb);
       }
 
       CL_OBJECT_LOCK(event);
@@ -650,10 +649,13 @@ cl_event_create_marker_or_barrier(cl_command_queue queue, cl_uint num_events_in_
     cl_uint i;
     cl_uint event_num;
     cl_event *depend_events;
+    cl_ulong taken_seq;
 
     CL_OBJECT_LOCK(queue);
 
-    /* First, wait for the command queue retire all in executing event. */
+    /* First, wait for the command queue retire all the events it is executing
+       now, but not the ones it takes meanwhile. */
+    taken_seq = worker->taken_seq;
     while (1) {
       if (worker->quit) { // already destroy the queue?
         CL_OBJECT_UNLOCK(queue);
@@ -661,7 +663,7 @@ cl_event_create_marker_or_barrier(cl_command_queue queue, cl_uint num_events_in_
         return NULL;
       }
 
-      if (worker->in_exec_status != CL_COMPLETE) {
+      if (worker->retired_seq < taken_seq) {
         CL_OBJECT_WAIT_ON_COND(queue);
         continue;
       }
@@ -17,8 +17,10 @@
  */
 #include <iostream>
 #include <dlfcn.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include "cl_gbe_loader.h"
 #include "backend/src/GBEConfig.h"
 
@@ -37,6 +39,7 @@ gbe_program_clean_llvm_resource_cb *compiler_program_clean_llvm_resource = NULL;
 
 //function pointer from libgbeinterp.so
 gbe_program_new_from_binary_cb *interp_program_new_from_binary = NULL;
+gbe_program_match_binary_cb *interp_program_match_binary = NULL;
 gbe_program_get_global_constant_size_cb *interp_program_get_global_constant_size = NULL;
 gbe_program_get_global_constant_data_cb *interp_program_get_global_constant_data = NULL;
 gbe_program_get_global_reloc_count_cb *interp_program_get_global_reloc_count = NULL;
@@ -45,6 +48,8 @@ gbe_program_delete_cb *interp_program_delete = NULL;
 gbe_program_get_kernel_num_cb *interp_program_get_kernel_num = NULL;
 gbe_program_get_kernel_by_name_cb *interp_program_get_kernel_by_name = NULL;
 gbe_program_get_kernel_cb *interp_program_get_kernel = NULL;
+gbe_program_get_kernel_name_cb *interp_program_get_kernel_name = NULL;
+gbe_program_is_deferred_cb *interp_program_is_deferred = NULL;
 gbe_program_get_device_enqueue_kernel_name_cb *interp_program_get_device_enqueue_kernel_name = NULL;
 gbe_kernel_get_name_cb *interp_kernel_get_name = NULL;
 gbe_kernel_get_attributes_cb *interp_kernel_get_attributes = NULL;
@@ -80,12 +85,13 @@ gbe_output_printf_cb* interp_output_printf = NULL;
 gbe_kernel_get_arg_info_cb *interp_kernel_get_arg_info = NULL;
 gbe_kernel_use_device_enqueue_cb *interp_kernel_use_device_enqueue = NULL;
 
+/* Only the interpreter is needed to run kernels loaded from a Gen binary.
+ * The compiler pulls LLVM and clang in and is only loaded the first time a
+ * program has to be compiled, see CompilerSupported */
 struct GbeLoaderInitializer
 {
-  GbeLoaderInitializer()
+  GbeLoaderInitializer() : compilerLoaded(false), dlhCompiler(NULL), dlhInterp(NULL)
   {
-    LoadCompiler();
-
     const char* path;
     if (!LoadInterp(path))
       std::cerr << "unable to load " << path << " which is part of the driver, please check!" << std::endl;
@@ -108,6 +114,10 @@ struct GbeLoaderInitializer
     if (interp_program_new_from_binary == NULL)
       return false;
 
+    interp_program_match_binary = *(gbe_program_match_binary_cb**)dlsym(dlhInterp, "gbe_program_match_binary");
+    if (interp_program_match_binary == NULL)
+      return false;
+
     interp_program_get_global_constant_size = *(gbe_program_get_global_constant_size_cb**)dlsym(dlhInterp, "gbe_program_get_global_constant_size");
     if (interp_program_get_global_constant_size == NULL)
       return false;
@@ -140,6 +150,14 @@ struct GbeLoaderInitializer
     if (interp_program_get_kernel == NULL)
       return false;
 
+    interp_program_get_kernel_name = *(gbe_program_get_kernel_name_cb**)dlsym(dlhInterp, "gbe_program_get_kernel_name");
+    if (interp_program_get_kernel_name == NULL)
+      return false;
+
+    interp_program_is_deferred = *(gbe_program_is_deferred_cb**)dlsym(dlhInterp, "gbe_program_is_deferred");
+    if (interp_program_is_deferred == NULL)
+      return false;
+
     interp_program_get_device_enqueue_kernel_name = *(gbe_program_get_device_enqueue_kernel_name_cb**)dlsym(dlhInterp, "gbe_program_get_device_enqueue_kernel_name");
     if (interp_program_get_device_enqueue_kernel_name == NULL)
       return false;
@@ -279,19 +297,27 @@ struct GbeLoaderInitializer
     return true;
   }
 
-  void LoadCompiler()
+  static const char* CompilerPath()
   {
-    compilerLoaded = false;
-
     const char* nonCompiler = getenv("OCL_NON_COMPILER");
     if (nonCompiler != NULL) {
       if (strcmp(nonCompiler, "1") == 0)
-        return;
+        return NULL;
     }
 
     const char* gbePath = getenv("OCL_GBE_PATH");
     if (gbePath == NULL || !strcmp(gbePath, ""))
       gbePath = GBE_OBJECT_DIR;
+    return gbePath;
+  }
+
+  void LoadCompiler()
+  {
+    compilerLoaded = false;
+
+    const char* gbePath = CompilerPath();
+    if (gbePath == NULL)
+      return;
 
     dlhCompiler = dlopen(gbePath, RTLD_LAZY | RTLD_LOCAL);
     if (dlhCompiler != NULL) {
@@ -363,11 +389,40 @@ struct GbeLoaderInitializer
 };
 
 static struct GbeLoaderInitializer gbeLoader;
+static pthread_once_t compilerOnce = PTHREAD_ONCE_INIT;
+
+static void LoadCompilerOnce()
+{
+  gbeLoader.LoadCompiler();
+  if (!gbeLoader.compilerLoaded && GbeLoaderInitializer::CompilerPath() != NULL)
+    std::cerr << "unable to load " << GbeLoaderInitializer::CompilerPath()
+              << ", the compiler is not available" << std::endl;
+}
 
 int CompilerSupported()
 {
+  pthread_once(&compilerOnce, LoadCompilerOnce);
   if (gbeLoader.compilerLoaded)
     return 1;
   else
     return 0;
 }
+
+int CompilerLoaded()
+{
+  return gbeLoader.compilerLoaded ? 1 : 0;
+}
+
+int CompilerAvailable()
+{
+  if (gbeLoader.compilerLoaded)
+    return 1;
+
+  const char* gbePath = GbeLoaderInitializer::CompilerPath();
+  if (gbePath == NULL)
+    return 0;
+  // A bare library name is resolved by dlopen, we can't tell without loading it
+  if (strchr(gbePath, '/') == NULL)
+    return 1;
+  return access(gbePath, R_OK) == 0 ? 1 : 0;
+}
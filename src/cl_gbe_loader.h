@@ -37,6 +37,7 @@ extern gbe_program_new_from_llvm_cb *compiler_program_new_from_llvm;
 extern gbe_program_clean_llvm_resource_cb *compiler_program_clean_llvm_resource;
 
 extern gbe_program_new_from_binary_cb *interp_program_new_from_binary;
+extern gbe_program_match_binary_cb *interp_program_match_binary;
 extern gbe_program_get_global_constant_size_cb *interp_program_get_global_constant_size;
 extern gbe_program_get_global_constant_data_cb *interp_program_get_global_constant_data;
 extern gbe_program_get_global_reloc_count_cb *interp_program_get_global_reloc_count;
@@ -45,6 +46,8 @@ extern gbe_program_delete_cb *interp_program_delete;
 extern gbe_program_get_kernel_num_cb *interp_program_get_kernel_num;
 extern gbe_program_get_kernel_by_name_cb *interp_program_get_kernel_by_name;
 extern gbe_program_get_kernel_cb *interp_program_get_kernel;
+extern gbe_program_get_kernel_name_cb *interp_program_get_kernel_name;
+extern gbe_program_is_deferred_cb *interp_program_is_deferred;
 extern gbe_program_get_device_enqueue_kernel_name_cb *interp_program_get_device_enqueue_kernel_name;
 extern gbe_kernel_get_name_cb *interp_kernel_get_name;
 extern gbe_kernel_get_attributes_cb *interp_kernel_get_attributes;
@@ -80,7 +83,12 @@ extern gbe_output_printf_cb* interp_output_printf;
 extern gbe_kernel_get_arg_info_cb *interp_kernel_get_arg_info;
 extern gbe_kernel_use_device_enqueue_cb * interp_kernel_use_device_enqueue;
 
+/* Load the compiler on first use, returns 1 if it is usable */
 int CompilerSupported();
+/* Returns 1 if the compiler was already loaded, never loads it */
+int CompilerLoaded();
+/* Returns 1 if the compiler can be loaded, without loading it */
+int CompilerAvailable();
 #ifdef __cplusplus
 }
 #endif
@@ -56,7 +56,7 @@ cl_kernel_delete(cl_kernel k)
     return;
 
   /* Release one reference on all bos we own */
-  if (k->bo)       cl_buffer_unreference(k->bo);
+  if (k->code)     cl_buffer_put_kernel_code(k->program->ctx->drv, k->code);
   /* This will be true for kernels created by clCreateKernel */
   if (k->ref_its_program) cl_program_delete(k->program);
   /* Release the curbe if allocated */
@@ -74,6 +74,12 @@ cl_kernel_delete(cl_kernel k)
   if (k->exec_info)
     cl_free(k->exec_info);
 
+  if (k->device_enqueue_kernels) {
+    for (i = 0; i < k->device_enqueue_kernel_n; ++i)
+      if (k->device_enqueue_kernels[i] != NULL)
+        cl_kernel_delete(k->device_enqueue_kernels[i]);
+    cl_free(k->device_enqueue_kernels);
+  }
   if (k->device_enqueue_ptr)
     cl_mem_svm_delete(k->program->ctx, k->device_enqueue_ptr);
   if (k->device_enqueue_infos)
@@ -425,19 +431,15 @@ LOCAL void
 cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
 {
   cl_context ctx = k->program->ctx;
-  cl_buffer_mgr bufmgr = cl_context_get_bufmgr(ctx);
 
-  if(k->bo != NULL)
-    cl_buffer_unreference(k->bo);
+  if(k->code != NULL)
+    cl_buffer_put_kernel_code(ctx->drv, k->code);
 
-  /* Allocate the gen code here */
+  /* Kernels with the same gen code share its buffer */
   const uint32_t code_sz = interp_kernel_get_code_size(opaque);
   const char *code = interp_kernel_get_code(opaque);
-  k->bo = cl_buffer_alloc(bufmgr, "CL kernel", code_sz, 64u);
+  k->bo = cl_buffer_get_kernel_code(ctx->drv, code, code_sz, &k->code);
   k->arg_n = interp_kernel_get_arg_num(opaque);
-
-  /* Upload the code */
-  cl_buffer_subdata(k->bo, 0, code_sz, code);
   k->opaque = opaque;
 
   const char* kname = cl_kernel_get_name(k);
@@ -468,7 +470,9 @@ cl_kernel_setup(cl_kernel k, gbe_kernel opaque)
     k->images = NULL;
   return;
 error:
-  cl_buffer_unreference(k->bo);
+  if (k->code)
+    cl_buffer_put_kernel_code(ctx->drv, k->code);
+  k->code = NULL;
   k->bo = NULL;
 }
 
@@ -481,7 +485,6 @@ cl_kernel_dup(cl_kernel from)
     return NULL;
   TRY_ALLOC_NO_ERR (to, CALLOC(struct _cl_kernel));
   CL_OBJECT_INIT_BASE(to, CL_OBJECT_KERNEL_MAGIC);
-  to->bo = from->bo;
   to->opaque = from->opaque;
   to->vme = from->vme;
   to->program = from->program;
@@ -507,7 +510,11 @@ cl_kernel_dup(cl_kernel from)
   if (to->curbe_sz) TRY_ALLOC_NO_ERR(to->curbe, cl_calloc(1, to->curbe_sz));
 
   /* Retain the bos */
-  if (from->bo)       cl_buffer_reference(from->bo);
+  if (from->code) {
+    cl_buffer_ref_kernel_code(from->program->ctx->drv, from->code);
+    to->code = from->code;
+    to->bo = from->bo;
+  }
 
   /* We retain the program destruction since this kernel (user allocated)
    * depends on the program for some of its pointers
@@ -51,6 +51,7 @@ typedef struct cl_argument {
 struct _cl_kernel {
   _cl_base_object base;
   cl_buffer bo;               /* The code itself */
+  cl_kernel_code code;        /* Driver cache entry of the code, owns bo */
   cl_program program;         /* Owns this structure (and pointers) */
   gbe_kernel opaque;          /* (Opaque) compiler structure for the OCL kernel */
   cl_accelerator_intel accel;     /* accelerator */
@@ -78,6 +79,8 @@ struct _cl_kernel {
   void* device_enqueue_ptr;     /* device_enqueue buffer*/
   uint32_t device_enqueue_info_n; /* count of parent kernel's arguments buffers, as child enqueues' exec info */
   void** device_enqueue_infos;   /* parent kernel's arguments buffers, as child enqueues' exec info   */
+  cl_kernel* device_enqueue_kernels; /* child kernels created so far, by block index */
+  uint32_t device_enqueue_kernel_n;  /* size of device_enqueue_kernels */
 };
 
 #define CL_OBJECT_KERNEL_MAGIC 0x1234567890abedefLL
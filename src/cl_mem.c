@@ -18,6 +18,7 @@
  */
 
 #include "cl_mem.h"
+#include "cl_mem_slab.h"
 #include "cl_image.h"
 #include "cl_context.h"
 #include "cl_utils.h"
@@ -29,6 +30,7 @@
 #include "cl_command_queue.h"
 #include "cl_cmrt.h"
 #include "cl_enqueue.h"
+#include "cl_event.h"
 
 #include "CL/cl.h"
 #include "CL/cl_intel.h"
@@ -37,6 +39,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <emmintrin.h>
 
 #define FIELD_SIZE(CASE,TYPE)               \
   case JOIN(CL_,CASE):                      \
@@ -181,14 +184,16 @@ cl_mem_allocate(enum cl_mem_type type,
             mem->is_svm = 1;
           /* userptr not support tiling */
           if (!is_tiled) {
-            if(svm_mem != NULL) {  //SVM always paged alignment
-              mem->offset = 0;
+            if(svm_mem != NULL) {  //SVM memory is already mapped, share its bo
+              mem->offset = svm_mem->offset + ((size_t)host_ptr - (size_t)svm_mem->host_ptr);
               mem->is_userptr = 1;
               mem->bo = svm_mem->bo;
               cl_mem_add_ref(svm_mem);
               bufCreated = 1;
-            } else if ((ALIGN((unsigned long)host_ptr, cacheline_size) == (unsigned long)host_ptr) &&
-                (ALIGN((unsigned long)sz, cacheline_size) == (unsigned long)sz)) {
+            } else if (ALIGN((unsigned long)host_ptr, 4) == (unsigned long)host_ptr) {
+              /* Map the whole enclosing page range and expose the buffer at
+               * its offset in the first page. RAW surfaces only require a
+               * dword aligned base, so any usual allocator alignment works */
               void* aligned_host_ptr = (void*)(((unsigned long)host_ptr) & (~(page_size - 1)));
               mem->offset = host_ptr - aligned_host_ptr;
               mem->is_userptr = 1;
@@ -241,6 +246,8 @@ cl_mem_allocate(enum cl_mem_type type,
       bufCreated = 1;
     }
 
+    if (!bufCreated && type == CL_MEM_BUFFER_TYPE && alignment <= 64 && !(flags & CL_MEM_ALLOC_HOST_PTR))
+      bufCreated = (mem->bo = cl_mem_slab_alloc(ctx, sz, &mem->slab, &mem->offset)) != NULL;
     if (!bufCreated)
       mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
 #else
@@ -248,7 +255,8 @@ cl_mem_allocate(enum cl_mem_type type,
       // if the image if created from buffer, should use the bo directly to share same bo.
       mem->bo = buffer->bo;
       cl_mem_image(mem)->is_image_from_buffer = 1;
-    } else
+    } else if (type != CL_MEM_BUFFER_TYPE || alignment > 64 ||
+               (mem->bo = cl_mem_slab_alloc(ctx, sz, &mem->slab, &mem->offset)) == NULL)
       mem->bo = cl_buffer_alloc(bufmgr, "CL memory object", sz, alignment);
 #endif
 
@@ -373,11 +381,11 @@ cl_mem_new_buffer(cl_context ctx,
     if (mem->is_userptr)
       memcpy(mem->host_ptr, data, sz);
     else
-      cl_buffer_subdata(mem->bo, 0, sz, data);
+      cl_buffer_subdata(mem->bo, mem->offset, sz, data);
   }
 
   if ((flags & CL_MEM_USE_HOST_PTR) && !mem->is_userptr)
-    cl_buffer_subdata(mem->bo, 0, sz, data);
+    cl_buffer_subdata(mem->bo, mem->offset, sz, data);
 
   if (flags & CL_MEM_USE_HOST_PTR)
     mem->host_ptr = data;
@@ -561,6 +569,21 @@ void cl_mem_replace_buffer(cl_mem buffer, cl_buffer new_bo)
   cl_buffer_unreference(buffer->bo);
   buffer->bo = new_bo;
   cl_buffer_reference(new_bo);
+  if (buffer->slab) {
+    /* The buffer leaves its slab, and its sub buffers with it */
+    struct _cl_mem_buffer *it;
+    cl_mem_slab_free(buffer->slab, buffer->offset);
+    buffer->slab = NULL;
+    buffer->offset = 0;
+    pthread_mutex_lock(&((struct _cl_mem_buffer*)buffer)->sub_lock);
+    /* Sub buffers do not hold a reference on the bo */
+    for (it = ((struct _cl_mem_buffer*)buffer)->subs; it != NULL; it = it->sub_next) {
+      it->base.bo = new_bo;
+      it->base.offset = 0;
+    }
+    pthread_mutex_unlock(&((struct _cl_mem_buffer*)buffer)->sub_lock);
+    return;
+  }
   if (buffer->type != CL_MEM_SUBBUFFER_TYPE)
     return;
 
@@ -573,6 +596,20 @@ void cl_mem_replace_buffer(cl_mem buffer, cl_buffer new_bo)
   }
 }
 
+/* Give a slab buffer a bo of its own */
+static cl_int
+cl_mem_leave_slab(cl_mem buffer)
+{
+  cl_buffer bo = cl_buffer_alloc(cl_context_get_bufmgr(buffer->ctx), "CL memory object", buffer->size, 64);
+  if (bo == NULL)
+    return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  cl_buffer_subdata(bo, 0, buffer->size, cl_mem_map(buffer, 0));
+  cl_mem_unmap(buffer);
+  cl_mem_replace_buffer(buffer, bo);
+  cl_buffer_unreference(bo);
+  return CL_SUCCESS;
+}
+
 void* cl_mem_svm_allocate(cl_context ctx, cl_svm_mem_flags flags,
                                  size_t size, unsigned int alignment)
 {
@@ -624,7 +661,20 @@ void* cl_mem_svm_allocate(cl_context ctx, cl_svm_mem_flags flags,
   bufmgr = cl_context_get_bufmgr(ctx);
   assert(bufmgr);
 
+  /* Small allocations come from the soft-pinned SVM slabs when enabled. The
+   * slots are aligned on their size */
   int page_size = getpagesize();
+  if (alignment <= page_size &&
+      (mem->bo = cl_mem_svm_slab_alloc(ctx, MAX(size, alignment), &mem->slab, &mem->offset)) != NULL) {
+    ptr = (char *)mem->slab->host_ptr + mem->offset;
+    mem->host_ptr = ptr;
+    mem->is_svm = 1;
+    mem->is_userptr = 1;
+    mem->size = size;
+    cl_context_add_mem(ctx, mem);
+    return ptr;
+  }
+
   const size_t alignedSZ = ALIGN(size, page_size);
   if(alignment == 0)
     alignment = page_size;
@@ -711,6 +761,78 @@ cl_mem_copy_image_to_image(const size_t *dst_origin,const size_t *src_origin, co
 
 }
 
+LOCAL cl_bool
+cl_mem_image_cpu_tiling(const struct _cl_mem_image *image)
+{
+  if (image->tiling == CL_NO_TILE || image->base.is_userptr || !image->base.ctx->cpu_tiling)
+    return CL_FALSE;
+  return !cl_buffer_is_swizzled(image->base.bo);
+}
+
+/* Copy size bytes between the linear memory and the bytes [x, x + size) of
+ * the row y of a tiled surface seen through its CPU mapping. An X tile is 8
+ * rows of 512 bytes. A Y tile is 8 columns of 16 bytes wide and 32 rows
+ * high, so a row of a Y tile is made of 16 bytes pieces 512 bytes apart. */
+static void
+cl_mem_copy_tiled_row(char *tiled, size_t row_pitch, cl_image_tiling_t tiling,
+                      size_t x, size_t y, char *linear, size_t size, cl_bool to_tiled)
+{
+  if (tiling == CL_TILE_X) {
+    char *row = tiled + (y / 8) * row_pitch * 8 + (y % 8) * 512;
+    while (size > 0) {
+      size_t in = x % 512;
+      size_t n = MIN(512 - in, size);
+      char *t = row + (x / 512) * 4096 + in;
+      if (to_tiled)
+        memcpy(t, linear, n);
+      else
+        memcpy(linear, t, n);
+      x += n;
+      linear += n;
+      size -= n;
+    }
+  } else {
+    char *row = tiled + (y / 32) * row_pitch * 32 + (y % 32) * 16;
+    while (size > 0) {
+      size_t in = x % 16;
+      size_t n = MIN(16 - in, size);
+      char *t = row + (x / 128) * 4096 + ((x % 128) / 16) * 512 + in;
+      if (n == 16) {
+        if (to_tiled)
+          _mm_store_si128((__m128i *)t, _mm_loadu_si128((const __m128i *)linear));
+        else
+          _mm_storeu_si128((__m128i *)linear, _mm_load_si128((const __m128i *)t));
+      } else if (to_tiled)
+        memcpy(t, linear, n);
+      else
+        memcpy(linear, t, n);
+      x += n;
+      linear += n;
+      size -= n;
+    }
+  }
+}
+
+LOCAL void
+cl_mem_copy_image_region_tiled(const size_t *origin, const size_t *region,
+                               void *tiled, void *host, size_t host_row_pitch, size_t host_slice_pitch,
+                               const struct _cl_mem_image *image, cl_bool to_tiled)
+{
+  size_t y, z;
+  for (z = 0; z < region[2]; z++) {
+    char *dst = (char *)host + z * host_slice_pitch;
+    for (y = 0; y < region[1]; y++) {
+      /* Where the row is in the linear view the GTT mapping would give */
+      size_t offset = image->offset + image->bpp * origin[0] +
+                      image->row_pitch * (origin[1] + y) + image->slice_pitch * (origin[2] + z);
+      cl_mem_copy_tiled_row(tiled, image->row_pitch, image->tiling,
+                            offset % image->row_pitch, offset / image->row_pitch,
+                            dst, image->bpp * region[0], to_tiled);
+      dst += host_row_pitch;
+    }
+  }
+}
+
 static void
 cl_mem_copy_image(struct _cl_mem_image *image,
 		  size_t row_pitch,
@@ -726,30 +848,37 @@ cl_mem_copy_image(struct _cl_mem_image *image,
   cl_mem_unmap_auto((cl_mem)image);
 }
 
-cl_image_tiling_t cl_get_default_tiling(cl_driver drv)
+LOCAL void
+cl_mem_init_image_tiling(cl_context ctx)
 {
-  static int initialized = 0;
-  static cl_image_tiling_t tiling = CL_TILE_X;
-
-  if (!initialized) {
-    // FIXME, need to find out the performance diff's root cause on BDW.
-    // SKL's 3D Image can't use TILE_X, so use TILE_Y as default
-    if(cl_driver_get_ver(drv) == 8 || cl_driver_get_ver(drv) == 9)
-      tiling = CL_TILE_Y;
-    char *tilingStr = getenv("OCL_TILING");
-    if (tilingStr != NULL) {
-      switch (tilingStr[0]) {
-        case '0': tiling = CL_NO_TILE; break;
-        case '1': tiling = CL_TILE_X; break;
-        case '2': tiling = CL_TILE_Y; break;
-        default:
-          break;
-      }
+  const char *env;
+  cl_image_tiling_t tiling = CL_TILE_X;
+
+  // FIXME, need to find out the performance diff's root cause on BDW.
+  // SKL's 3D Image can't use TILE_X, so use TILE_Y as default
+  if(cl_driver_get_ver(ctx->drv) == 8 || cl_driver_get_ver(ctx->drv) == 9)
+    tiling = CL_TILE_Y;
+  env = getenv("OCL_TILING");
+  if (env != NULL) {
+    switch (env[0]) {
+      case '0': tiling = CL_NO_TILE; break;
+      case '1': tiling = CL_TILE_X; break;
+      case '2': tiling = CL_TILE_Y; break;
+      default:
+        break;
     }
-    initialized = 1;
   }
+  ctx->image_tiling = tiling;
+
+  /* OCL_CPU_TILING=0 goes back to the GTT mapping */
+  env = getenv("OCL_CPU_TILING");
+  ctx->cpu_tiling = !(env != NULL && env[0] == '0');
+}
 
-  return tiling;
+static cl_image_tiling_t
+cl_get_default_tiling(cl_context ctx)
+{
+  return (cl_image_tiling_t)ctx->image_tiling;
 }
 
 static cl_mem
@@ -920,7 +1049,7 @@ _cl_mem_new_image(cl_context ctx,
       tiling = CL_NO_TILE;
     } else if (cl_driver_get_ver(ctx->drv) != 6) {
       /* Pick up tiling mode (we do only linear on SNB) */
-      tiling = cl_get_default_tiling(ctx->drv);
+      tiling = cl_get_default_tiling(ctx);
     }
 
     size_t min_pitch = bpp * w;
@@ -940,7 +1069,7 @@ _cl_mem_new_image(cl_context ctx,
       h = 1;
       tiling = CL_NO_TILE;
     } else if (cl_driver_get_ver(ctx->drv) != 6)
-      tiling = cl_get_default_tiling(ctx->drv);
+      tiling = cl_get_default_tiling(ctx);
 
     size_t min_pitch = bpp * w;
     if (data && pitch == 0)
@@ -1314,6 +1443,9 @@ _cl_mem_new_image_from_buffer(cl_context ctx,
     offset = ((struct _cl_mem_buffer *)buffer)->sub_offset;
     mem_buffer = mem_buffer->parent;
   }
+  /* The image needs a bo of its own */
+  if (mem_buffer->base.slab && (err = cl_mem_leave_slab(&mem_buffer->base)) != CL_SUCCESS)
+    goto error;
   /* Get the size of each pixel */
   if (UNLIKELY((err = cl_image_byte_per_pixel(image_format, &bpp)) != CL_SUCCESS))
     goto error;
@@ -1529,6 +1661,8 @@ cl_mem_delete(cl_mem mem)
     if (svm_mem != NULL)
       cl_mem_delete(svm_mem);
   } else if (LIKELY(mem->bo != NULL)) {
+    if (mem->slab)
+      cl_mem_slab_free(mem->slab, mem->offset);
     cl_buffer_unreference(mem->bo);
   }
 
@@ -1538,7 +1672,7 @@ cl_mem_delete(cl_mem mem)
   if ((mem->is_userptr &&
       (mem->flags & CL_MEM_ALLOC_HOST_PTR) &&
       (mem->type != CL_MEM_SUBBUFFER_TYPE)) ||
-      (mem->is_svm && mem->type == CL_MEM_SVM_TYPE))
+      (mem->is_svm && mem->type == CL_MEM_SVM_TYPE && mem->slab == NULL))
     cl_free(mem->host_ptr);
 
   CL_OBJECT_DESTROY_BASE(mem);
@@ -1556,6 +1690,121 @@ cl_mem_add_ref(cl_mem mem)
 #define LOCAL_SZ_1   4
 #define LOCAL_SZ_2   4
 
+#define CL_MEM_HOST_OP_DEFAULT_THRESHOLD 4096
+
+/* Small copies and fills cost much less on the CPU than the launch of the
+ * internal kernel. They are done by the CPU when the buffer is idle, so that
+ * the mapping does not stall on the GPU. OCL_HOST_COPY_THRESHOLD sets the
+ * largest size done this way, 0 disables it. The benchmark_small_copy_buffer_*
+ * and benchmark_small_fill_buffer_* benchmarks give the crossover */
+static cl_bool
+cl_mem_host_op_ok(cl_mem mem, size_t size)
+{
+  static long threshold = -1;
+  if (threshold < 0) {
+    const char *env = getenv("OCL_HOST_COPY_THRESHOLD");
+    long val = CL_MEM_HOST_OP_DEFAULT_THRESHOLD;
+    if (env != NULL)
+      sscanf(env, "%ld", &val);
+    threshold = val < 0 ? 0 : val;
+  }
+
+  if (size > (size_t)threshold)
+    return CL_FALSE;
+  if (mem->type != CL_MEM_BUFFER_TYPE && mem->type != CL_MEM_SUBBUFFER_TYPE)
+    return CL_FALSE;
+  return !cl_buffer_is_busy(mem->bo);
+}
+
+/* Largest power of 2, up to 64, dividing all the values */
+static size_t
+cl_mem_transfer_align(size_t a, size_t b, size_t c)
+{
+  size_t bits = a | b | c | 64;
+  return bits & -bits;
+}
+
+/* The block messages of the calibrated kernels need 16 bytes aligned
+ * addresses, counted from the start of the bo */
+static cl_bool
+cl_mem_transfer_block_ok(cl_mem mem, size_t offset)
+{
+  return (mem->offset + ((struct _cl_mem_buffer *)mem)->sub_offset + offset) % 16 == 0;
+}
+
+static cl_int
+cl_mem_copy_tuned(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_buf,
+                  size_t src_offset, size_t dst_offset, size_t cb, int index)
+{
+  extern char cl_internal_copy_buf_tuned_str[];
+  extern size_t cl_internal_copy_buf_tuned_str_size;
+  const cl_copy_kernel_desc *desc = &cl_copy_tuned_kernels[index];
+  /* The block kernels count the offsets in dwords */
+  const size_t unit = desc->block ? 4 : desc->elem_size;
+  cl_uint src_off = src_offset / unit;
+  cl_uint dst_off = dst_offset / unit;
+  cl_uint elems = cb / desc->elem_size;
+  size_t global_off[] = {0,0,0};
+  size_t global_sz[] = {1,1,1};
+  size_t local_sz[] = {CL_COPY_TUNED_LOCAL_SIZE,1,1};
+  cl_kernel ker;
+  cl_int ret;
+
+  ker = cl_context_get_static_kernel_from_bin(queue->ctx, CL_ENQUEUE_COPY_BUFFER_TUNED + index,
+           cl_internal_copy_buf_tuned_str, (size_t)cl_internal_copy_buf_tuned_str_size, NULL);
+  if (!ker)
+    return CL_OUT_OF_RESOURCES;
+
+  global_sz[0] = cl_copy_tuned_global_size(desc, cb);
+  cl_kernel_set_arg(ker, 0, sizeof(cl_mem), &src_buf);
+  cl_kernel_set_arg(ker, 1, sizeof(cl_uint), &src_off);
+  cl_kernel_set_arg(ker, 2, sizeof(cl_mem), &dst_buf);
+  cl_kernel_set_arg(ker, 3, sizeof(cl_uint), &dst_off);
+  cl_kernel_set_arg(ker, 4, sizeof(cl_uint), &elems);
+  ret = cl_command_queue_ND_range(queue, ker, event, 1, global_off,
+                                  global_off, global_sz, global_sz, local_sz, local_sz);
+  cl_kernel_delete(ker);
+  return ret;
+}
+
+static cl_int
+cl_mem_fill_tuned(cl_command_queue queue, cl_event e, const void *pattern, size_t pattern_size,
+                  cl_mem buffer, size_t offset, size_t size, int index)
+{
+  extern char cl_internal_fill_buf_tuned_str[];
+  extern size_t cl_internal_fill_buf_tuned_str_size;
+  const cl_copy_kernel_desc *desc = &cl_fill_tuned_kernels[index];
+  const size_t unit = desc->block ? 4 : desc->elem_size;
+  cl_uint off = offset / unit;
+  cl_uint elems = size / desc->elem_size;
+  size_t global_off[] = {0,0,0};
+  size_t global_sz[] = {1,1,1};
+  size_t local_sz[] = {CL_COPY_TUNED_LOCAL_SIZE,1,1};
+  cl_uint4 pattern16;
+  cl_kernel ker;
+  cl_int ret;
+  size_t i;
+
+  /* The kernels take the pattern replicated to 16 bytes */
+  for (i = 0; i < sizeof(pattern16); i += pattern_size)
+    memcpy((char *)&pattern16 + i, pattern, pattern_size);
+
+  ker = cl_context_get_static_kernel_from_bin(queue->ctx, CL_ENQUEUE_FILL_BUFFER_TUNED + index,
+           cl_internal_fill_buf_tuned_str, (size_t)cl_internal_fill_buf_tuned_str_size, NULL);
+  if (!ker)
+    return CL_OUT_OF_RESOURCES;
+
+  global_sz[0] = cl_copy_tuned_global_size(desc, size);
+  cl_kernel_set_arg(ker, 0, sizeof(cl_mem), &buffer);
+  cl_kernel_set_arg(ker, 1, sizeof(cl_uint4), &pattern16);
+  cl_kernel_set_arg(ker, 2, sizeof(cl_uint), &off);
+  cl_kernel_set_arg(ker, 3, sizeof(cl_uint), &elems);
+  ret = cl_command_queue_ND_range(queue, ker, e, 1, global_off,
+                                  global_off, global_sz, global_sz, local_sz, local_sz);
+  cl_kernel_delete(ker);
+  return ret;
+}
+
 LOCAL cl_int
 cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_buf,
             size_t src_offset, size_t dst_offset, size_t cb)
@@ -1569,13 +1818,33 @@ cl_mem_copy(cl_command_queue queue, cl_event event, cl_mem src_buf, cl_mem dst_b
   int aligned = 0;
   int dw_src_offset = src_offset/4;
   int dw_dst_offset = dst_offset/4;
+  int tuned;
 
   if (!cb)
     return ret;
 
+  if (event && cl_mem_host_op_ok(src_buf, cb) && cl_mem_host_op_ok(dst_buf, cb)) {
+    event->exec_data.type = EnqueueCopyBufferHost;
+    event->exec_data.queue = queue;
+    event->exec_data.mem_obj = src_buf;
+    event->exec_data.offset = src_offset;
+    event->exec_data.dst_mem_obj = dst_buf;
+    event->exec_data.dst_offset = dst_offset;
+    event->exec_data.size = cb;
+    return ret;
+  }
+
   /* We use one kernel to copy the data. The kernel is lazily created. */
   assert(src_buf->ctx == dst_buf->ctx);
 
+  /* Dword aligned copies use the tuned kernel for their size and alignment */
+  tuned = cl_copy_tuning_select(queue->ctx, CL_FALSE, cb,
+                                cl_mem_transfer_align(src_offset, dst_offset, cb),
+                                cl_mem_transfer_block_ok(src_buf, src_offset) &&
+                                cl_mem_transfer_block_ok(dst_buf, dst_offset));
+  if (tuned >= 0)
+    return cl_mem_copy_tuned(queue, event, src_buf, dst_buf, src_offset, dst_offset, cb, tuned);
+
   /* All 16 bytes aligned, fast and easy one. */
   if((cb % 16 == 0) && (src_offset % 16 == 0) && (dst_offset % 16 == 0)) {
     extern char cl_internal_copy_buf_align16_str[];
@@ -1828,6 +2097,7 @@ cl_mem_fill(cl_command_queue queue, cl_event e, const void * pattern, size_t pat
   char pattern_comb[4];
   int is_128 = 0;
   const void * pattern1 = NULL;
+  int tuned = -1;
 
   assert(offset % pattern_size == 0);
   assert(size % pattern_size == 0);
@@ -1835,6 +2105,30 @@ cl_mem_fill(cl_command_queue queue, cl_event e, const void * pattern, size_t pat
   if (!size)
     return ret;
 
+  if (e && cl_mem_host_op_ok(buffer, size)) {
+    void *pattern_copy = cl_malloc(pattern_size);
+    if (pattern_copy == NULL)
+      return CL_OUT_OF_HOST_MEMORY;
+    memcpy(pattern_copy, pattern, pattern_size);
+    e->exec_data.type = EnqueueFillBufferHost;
+    e->exec_data.queue = queue;
+    e->exec_data.mem_obj = buffer;
+    e->exec_data.offset = offset;
+    e->exec_data.size = size;
+    e->exec_data.const_ptr = pattern_copy;
+    e->exec_data.pattern_size = pattern_size;
+    return ret;
+  }
+
+  /* Patterns up to 16 bytes filling 16 bytes aligned ranges use the
+   * tuned kernels */
+  if (pattern_size <= 16)
+    tuned = cl_copy_tuning_select(queue->ctx, CL_TRUE, size,
+                                  cl_mem_transfer_align(offset, size, 0),
+                                  cl_mem_transfer_block_ok(buffer, offset));
+  if (tuned >= 0)
+    return cl_mem_fill_tuned(queue, e, pattern, pattern_size, buffer, offset, size, tuned);
+
   if (pattern_size == 128) {
     /* 128 is according to pattern of double16, but double works not very
        well on some platform. We use two float16 to handle this. */
@@ -2410,12 +2704,21 @@ cl_mem_copy_buffer_to_image(cl_command_queue queue, cl_event event, cl_mem buffe
 }
 
 
+/* The data of the buffers carved out of a slab start at their offset. The
+ * userptr ones have their offset applied by the host pointer instead */
+static void *
+cl_mem_get_virtual(cl_mem mem)
+{
+  char *ptr = cl_buffer_get_virtual(mem->bo);
+  return mem->is_userptr ? ptr : ptr + mem->offset;
+}
+
 LOCAL void*
 cl_mem_map(cl_mem mem, int write)
 {
   cl_buffer_map(mem->bo, write);
   assert(cl_buffer_get_virtual(mem->bo));
-  return cl_buffer_get_virtual(mem->bo);
+  return cl_mem_get_virtual(mem);
 }
 
 LOCAL cl_int
@@ -2431,7 +2734,7 @@ cl_mem_map_gtt(cl_mem mem)
   cl_buffer_map_gtt(mem->bo);
   assert(cl_buffer_get_virtual(mem->bo));
   mem->mapped_gtt = 1;
-  return cl_buffer_get_virtual(mem->bo);
+  return cl_mem_get_virtual(mem);
 }
 
 LOCAL void *
@@ -2439,7 +2742,7 @@ cl_mem_map_gtt_unsync(cl_mem mem)
 {
   cl_buffer_map_gtt_unsync(mem->bo);
   assert(cl_buffer_get_virtual(mem->bo));
-  return cl_buffer_get_virtual(mem->bo);
+  return cl_mem_get_virtual(mem);
 }
 
 LOCAL cl_int
@@ -2452,9 +2755,9 @@ cl_mem_unmap_gtt(cl_mem mem)
 LOCAL void*
 cl_mem_map_auto(cl_mem mem, int write)
 {
-  //if mem is not created from userptr, the offset should be always zero.
-  if (!mem->is_userptr)
-    assert(mem->offset == 0);
+  //if mem is not created from userptr, the offset is only used by slab buffers
+  if (!mem->is_userptr && mem->type != CL_MEM_SUBBUFFER_TYPE)
+    assert(mem->offset == 0 || mem->slab != NULL);
 
   if (IS_IMAGE(mem) && cl_mem_image(mem)->tiling != CL_NO_TILE)
     return cl_mem_map_gtt(mem);
@@ -2593,6 +2896,12 @@ cl_mem_get_fd(cl_mem mem,
               int* fd)
 {
   cl_int err = CL_SUCCESS;
+  cl_mem buffer = mem;
+  if (mem->type == CL_MEM_SUBBUFFER_TYPE)
+    buffer = &((struct _cl_mem_buffer *)mem)->parent->base;
+  /* The importer sees the whole bo, which must not hold other buffers */
+  if (buffer->slab && (err = cl_mem_leave_slab(buffer)) != CL_SUCCESS)
+    return err;
   if(cl_buffer_get_fd(mem->bo, fd))
 	err = CL_INVALID_OPERATION;
   return err;
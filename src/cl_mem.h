@@ -100,7 +100,9 @@ typedef  struct _cl_mem {
   list_head dstr_cb_head;   /* All destroy callbacks. */
   uint8_t is_userptr;       /* CL_MEM_USE_HOST_PTR is enabled */
   cl_bool is_svm;           /* This object  is svm */
-  size_t offset;            /* offset of host_ptr to the page beginning, only for CL_MEM_USE_HOST_PTR*/
+  size_t offset;            /* offset of host_ptr to the page beginning for CL_MEM_USE_HOST_PTR,
+                               offset of the data in the bo for the other buffers */
+  struct _cl_mem_slab *slab; /* Slab the buffer is carved from, see cl_mem_slab.h */
 
   uint8_t cmrt_mem_type;    /* CmBuffer, CmSurface2D, ... */
   void* cmrt_mem;
@@ -337,6 +339,20 @@ cl_mem_copy_image_region(const size_t *origin, const size_t *region,
                          const void *src, size_t src_row_pitch, size_t src_slice_pitch,
                          const struct _cl_mem_image *image, cl_bool offset_dst, cl_bool offset_src);
 
+/* Read the image tiling options of the context, OCL_TILING and OCL_CPU_TILING */
+extern void cl_mem_init_image_tiling(cl_context ctx);
+
+/* Tell if a tiled image can be read and written through its linear CPU
+ * mapping with the tiling done in software instead of using the GTT */
+extern cl_bool cl_mem_image_cpu_tiling(const struct _cl_mem_image *image);
+
+/* Copy a region between host memory and a tiled image mapped with cl_mem_map.
+ * to_tiled gives the direction */
+extern void cl_mem_copy_image_region_tiled(const size_t *origin, const size_t *region,
+                                           void *tiled, void *host,
+                                           size_t host_row_pitch, size_t host_slice_pitch,
+                                           const struct _cl_mem_image *image, cl_bool to_tiled);
+
 void
 cl_mem_copy_image_to_image(const size_t *dst_origin,const size_t *src_origin, const size_t *region,
                            const struct _cl_mem_image *dst_image, const struct _cl_mem_image *src_image);
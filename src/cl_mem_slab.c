@@ -0,0 +1,244 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_mem_slab.h"
+#include "cl_context.h"
+#include "cl_alloc.h"
+#include "cl_utils.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct _cl_mem_slab_pool {
+  pthread_mutex_t lock;
+  cl_context ctx;
+  cl_bool svm;                              /* Soft-pinned host memory slabs */
+  cl_bool enabled;                          /* OCL_SLAB_ALLOC or OCL_SVM_SLAB_ALLOC */
+  size_t slab_size;
+  int max_shift;                            /* Largest class */
+  cl_mem_slab slabs[CL_MEM_SLAB_CLASS_MAX]; /* Slabs with free slots first */
+};
+
+static cl_bool
+cl_mem_slab_env(const char *name)
+{
+  const char *env = getenv(name);
+  int val = 0;
+  if (env != NULL)
+    sscanf(env, "%d", &val);
+  return val != 0;
+}
+
+static int
+cl_mem_slab_class(size_t size)
+{
+  int cls = 0;
+  while (((size_t)1 << (cls + CL_MEM_SLAB_MIN_SHIFT)) < size)
+    cls++;
+  return cls;
+}
+
+static struct _cl_mem_slab_pool *
+cl_mem_slab_get_pool(cl_context ctx, cl_bool svm)
+{
+  struct _cl_mem_slab_pool *pool;
+  struct _cl_mem_slab_pool **ctx_pool = svm ? &ctx->svm_slab_pool : &ctx->slab_pool;
+
+  CL_OBJECT_LOCK(ctx);
+  pool = *ctx_pool;
+  if (pool == NULL) {
+    pool = CALLOC(struct _cl_mem_slab_pool);
+    if (pool != NULL) {
+      pthread_mutex_init(&pool->lock, NULL);
+      pool->ctx = ctx;
+      pool->svm = svm;
+      pool->enabled = cl_mem_slab_env(svm ? "OCL_SVM_SLAB_ALLOC" : "OCL_SLAB_ALLOC");
+      pool->slab_size = svm ? CL_MEM_SVM_SLAB_SIZE : CL_MEM_SLAB_SIZE;
+      pool->max_shift = svm ? CL_MEM_SVM_SLAB_MAX_SHIFT : CL_MEM_SLAB_MAX_SHIFT;
+      *ctx_pool = pool;
+    }
+  }
+  CL_OBJECT_UNLOCK(ctx);
+  return pool;
+}
+
+static void
+cl_mem_slab_delete(cl_mem_slab slab)
+{
+  cl_buffer_unreference(slab->bo);
+  if (slab->host_ptr)
+    cl_free(slab->host_ptr);
+  cl_free(slab);
+}
+
+static cl_mem_slab
+cl_mem_slab_new(struct _cl_mem_slab_pool *pool, int cls)
+{
+  const uint32_t slot_size = 1 << (cls + CL_MEM_SLAB_MIN_SHIFT);
+  const uint32_t slot_n = pool->slab_size / slot_size;
+  cl_buffer_mgr bufmgr = cl_context_get_bufmgr(pool->ctx);
+  cl_mem_slab slab;
+
+  slab = cl_calloc(1, sizeof(_cl_mem_slab) + ALIGN(slot_n, 64) / 8);
+  if (slab == NULL)
+    return NULL;
+  if (pool->svm) {
+#ifdef HAS_BO_SET_SOFTPIN
+    slab->host_ptr = cl_aligned_malloc(pool->slab_size, pool->slab_size);
+    if (slab->host_ptr != NULL) {
+      slab->bo = cl_buffer_alloc_userptr(bufmgr, "CL SVM slab memory object",
+                                         slab->host_ptr, pool->slab_size, 0);
+      if (slab->bo != NULL) {
+        cl_buffer_set_softpin_offset(slab->bo, (size_t)slab->host_ptr);
+        cl_buffer_set_bo_use_full_range(slab->bo, 1);
+      }
+    }
+#endif
+  } else
+    slab->bo = cl_buffer_alloc(bufmgr, "CL slab memory object", pool->slab_size, 4096);
+  if (slab->bo == NULL) {
+    if (slab->host_ptr)
+      cl_free(slab->host_ptr);
+    cl_free(slab);
+    return NULL;
+  }
+  slab->pool = pool;
+  slab->slot_size = slot_size;
+  slab->slot_n = slot_n;
+  slab->free_n = slot_n;
+  return slab;
+}
+
+static cl_buffer
+cl_mem_slab_pool_alloc(struct _cl_mem_slab_pool *pool, size_t size,
+                       cl_mem_slab *ret_slab, size_t *offset)
+{
+  cl_mem_slab slab, *prev;
+  uint32_t slot, word;
+  int cls;
+
+  if (pool == NULL || !pool->enabled || size == 0 || size > ((size_t)1 << pool->max_shift))
+    return NULL;
+
+  cls = cl_mem_slab_class(size);
+  pthread_mutex_lock(&pool->lock);
+  for (prev = &pool->slabs[cls]; *prev != NULL; prev = &(*prev)->next)
+    if ((*prev)->free_n > 0)
+      break;
+  if (*prev == NULL) {
+    if ((slab = cl_mem_slab_new(pool, cls)) == NULL) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+  } else {
+    slab = *prev;
+    *prev = slab->next;
+  }
+  /* Keep the slab with free slots at the head */
+  slab->next = pool->slabs[cls];
+  pool->slabs[cls] = slab;
+
+  for (word = 0; ~slab->used[word] == 0; word++)
+    ;
+  slot = word * 64 + __builtin_ctzll(~slab->used[word]);
+  assert(slot < slab->slot_n);
+  slab->used[word] |= (uint64_t)1 << (slot % 64);
+  slab->free_n--;
+  cl_buffer_reference(slab->bo);
+  pthread_mutex_unlock(&pool->lock);
+
+  *ret_slab = slab;
+  *offset = (size_t)slot * slab->slot_size;
+  return slab->bo;
+}
+
+LOCAL cl_buffer
+cl_mem_slab_alloc(cl_context ctx, size_t size, cl_mem_slab *slab, size_t *offset)
+{
+  if (size > (1 << CL_MEM_SLAB_MAX_SHIFT))
+    return NULL;
+  return cl_mem_slab_pool_alloc(cl_mem_slab_get_pool(ctx, CL_FALSE), size, slab, offset);
+}
+
+LOCAL cl_buffer
+cl_mem_svm_slab_alloc(cl_context ctx, size_t size, cl_mem_slab *slab, size_t *offset)
+{
+  if (size > (1 << CL_MEM_SVM_SLAB_MAX_SHIFT))
+    return NULL;
+  return cl_mem_slab_pool_alloc(cl_mem_slab_get_pool(ctx, CL_TRUE), size, slab, offset);
+}
+
+LOCAL void
+cl_mem_slab_free(cl_mem_slab slab, size_t offset)
+{
+  struct _cl_mem_slab_pool *pool = slab->pool;
+  const uint32_t slot = offset / slab->slot_size;
+  const int cls = cl_mem_slab_class(slab->slot_size);
+  cl_mem_slab *prev;
+
+  pthread_mutex_lock(&pool->lock);
+  assert(slab->used[slot / 64] & ((uint64_t)1 << (slot % 64)));
+  slab->used[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+  slab->free_n++;
+
+  /* Release the slab once empty, unless it is the one we allocate from */
+  if (slab->free_n == slab->slot_n && pool->slabs[cls] != slab) {
+    for (prev = &pool->slabs[cls]; *prev != slab; prev = &(*prev)->next)
+      ;
+    *prev = slab->next;
+    cl_mem_slab_delete(slab);
+  } else if (pool->slabs[cls] != slab && pool->slabs[cls]->free_n == 0) {
+    /* Move it to the head so that it is found first */
+    for (prev = &pool->slabs[cls]; *prev != slab; prev = &(*prev)->next)
+      ;
+    *prev = slab->next;
+    slab->next = pool->slabs[cls];
+    pool->slabs[cls] = slab;
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void
+cl_mem_slab_pool_release(struct _cl_mem_slab_pool *pool)
+{
+  int cls;
+
+  if (pool == NULL)
+    return;
+  for (cls = 0; cls < CL_MEM_SLAB_CLASS_MAX; cls++) {
+    while (pool->slabs[cls]) {
+      cl_mem_slab slab = pool->slabs[cls];
+      assert(slab->free_n == slab->slot_n);
+      pool->slabs[cls] = slab->next;
+      cl_mem_slab_delete(slab);
+    }
+  }
+  pthread_mutex_destroy(&pool->lock);
+  cl_free(pool);
+}
+
+LOCAL void
+cl_mem_slab_pool_delete(cl_context ctx)
+{
+  cl_mem_slab_pool_release(ctx->slab_pool);
+  cl_mem_slab_pool_release(ctx->svm_slab_pool);
+  ctx->slab_pool = NULL;
+  ctx->svm_slab_pool = NULL;
+}
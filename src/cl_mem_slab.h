@@ -0,0 +1,72 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_MEM_SLAB_H__
+#define __CL_MEM_SLAB_H__
+
+#include "cl_driver.h"
+#include <stdint.h>
+
+/* Small buffers are carved out of 64KB bos, the slabs. Each slab holds
+ * slots of one size class, from 128 bytes (the sub buffer alignment) to
+ * 4KB. A buffer in a slab keeps the slab bo and the slot offset in
+ * cl_mem::offset, and is bound like a sub buffer. Slabs are per context and
+ * only used for buffers when OCL_SLAB_ALLOC=1, read once per context:
+ * mapping a buffer waits for the GPU to be done with the whole slab.
+ *
+ * Small SVM allocations use the same scheme with 2MB slabs of soft-pinned
+ * host memory and classes up to 64KB, so clSVMAlloc needs neither a new bo
+ * nor a userptr ioctl. They are only used when OCL_SVM_SLAB_ALLOC=1, read
+ * once per context. */
+#define CL_MEM_SLAB_SIZE          (64 * 1024)
+#define CL_MEM_SLAB_MIN_SHIFT     7
+#define CL_MEM_SLAB_MAX_SHIFT     12
+#define CL_MEM_SVM_SLAB_SIZE      (2 * 1024 * 1024)
+#define CL_MEM_SVM_SLAB_MAX_SHIFT 16
+#define CL_MEM_SLAB_CLASS_MAX     (CL_MEM_SVM_SLAB_MAX_SHIFT - CL_MEM_SLAB_MIN_SHIFT + 1)
+
+struct _cl_mem_slab_pool;
+
+typedef struct _cl_mem_slab {
+  struct _cl_mem_slab *next;        /* Next slab of the same class */
+  struct _cl_mem_slab_pool *pool;   /* Pool it belongs to */
+  cl_buffer bo;
+  void *host_ptr;                   /* Host memory of the SVM slabs, NULL otherwise */
+  uint32_t slot_size;
+  uint32_t slot_n;
+  uint32_t free_n;                  /* Number of free slots */
+  uint64_t used[];                  /* One bit per slot */
+} _cl_mem_slab;
+typedef _cl_mem_slab *cl_mem_slab;
+
+/* Take a slot of at least size bytes. The returned bo is referenced once for
+ * the caller. NULL is returned when slabs are disabled or the size too big,
+ * the caller then allocates its own bo */
+extern cl_buffer cl_mem_slab_alloc(cl_context ctx, size_t size, cl_mem_slab *slab, size_t *offset);
+
+/* Same for SVM. The memory is at slab->host_ptr + offset and is already
+ * soft-pinned at its host address */
+extern cl_buffer cl_mem_svm_slab_alloc(cl_context ctx, size_t size, cl_mem_slab *slab, size_t *offset);
+
+/* Give the slot back. The bo reference is released by the caller */
+extern void cl_mem_slab_free(cl_mem_slab slab, size_t offset);
+
+/* Release the slabs of a context. They are all empty by then */
+extern void cl_mem_slab_pool_delete(cl_context ctx);
+
+#endif /* __CL_MEM_SLAB_H__ */
@@ -0,0 +1,217 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "cl_memcpy.h"
+#include "cl_utils.h"
+
+#include <emmintrin.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CL_MEMCPY_MAX_THREADS 4
+#define CL_MEMCPY_DEFAULT_THRESHOLD (4 * 1024 * 1024)
+
+typedef struct cl_memcpy_chunk {
+  char *dst;
+  const char *src;
+  size_t size;
+} cl_memcpy_chunk;
+
+/* The copy threads. The thread calling cl_memcpy copies the first chunk and
+ * the workers the others. Only one copy uses the pool at a time, the other
+ * callers copy alone */
+static struct {
+  pthread_mutex_t busy;           /* Held by the copy using the pool */
+  pthread_mutex_t lock;           /* Protects the fields below */
+  pthread_cond_t start;
+  pthread_cond_t done;
+  cl_memcpy_chunk chunks[CL_MEMCPY_MAX_THREADS];
+  cl_bool nt;
+  uint32_t generation;            /* Incremented for each new copy */
+  int pending;                    /* Chunks still copied by the workers */
+  int worker_n;
+  cl_bool quit;                   /* Set when the library is unloaded */
+  pthread_t tids[CL_MEMCPY_MAX_THREADS];
+  size_t threshold;
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+          PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void
+cl_memcpy_nt(char *dst, const char *src, size_t size)
+{
+  size_t head = (-(uintptr_t)dst) & 15;
+  if (head > size)
+    head = size;
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+
+  for (; size >= 64; size -= 64, dst += 64, src += 64) {
+    __m128i v0 = _mm_loadu_si128((const __m128i *)src);
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(src + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i *)(src + 32));
+    __m128i v3 = _mm_loadu_si128((const __m128i *)(src + 48));
+    _mm_stream_si128((__m128i *)dst, v0);
+    _mm_stream_si128((__m128i *)(dst + 16), v1);
+    _mm_stream_si128((__m128i *)(dst + 32), v2);
+    _mm_stream_si128((__m128i *)(dst + 48), v3);
+  }
+  for (; size >= 16; size -= 16, dst += 16, src += 16)
+    _mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+  memcpy(dst, src, size);
+  _mm_sfence();
+}
+
+static void
+cl_memcpy_chunk_copy(const cl_memcpy_chunk *chunk, cl_bool nt)
+{
+  if (nt)
+    cl_memcpy_nt(chunk->dst, chunk->src, chunk->size);
+  else
+    memcpy(chunk->dst, chunk->src, chunk->size);
+}
+
+static void *
+cl_memcpy_worker(void *arg)
+{
+  const int id = (int)(intptr_t)arg;
+  uint32_t generation = 0;
+
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.generation == generation && !pool.quit)
+      pthread_cond_wait(&pool.start, &pool.lock);
+    if (pool.quit)
+      break;
+    generation = pool.generation;
+    if (pool.chunks[id].size == 0)
+      continue;
+    pthread_mutex_unlock(&pool.lock);
+
+    cl_memcpy_chunk_copy(&pool.chunks[id], pool.nt);
+
+    pthread_mutex_lock(&pool.lock);
+    if (--pool.pending == 0)
+      pthread_cond_signal(&pool.done);
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+static void
+cl_memcpy_init(void)
+{
+  const char *env;
+  long cpu_n = sysconf(_SC_NPROCESSORS_ONLN);
+  int i;
+
+  pool.threshold = CL_MEMCPY_DEFAULT_THRESHOLD;
+  env = getenv("OCL_PARALLEL_COPY_THRESHOLD");
+  if (env != NULL) {
+    unsigned long threshold;
+    if (sscanf(env, "%lu", &threshold) == 1)
+      pool.threshold = threshold;
+  }
+
+  /* Worker 0 is the calling thread */
+  for (i = 1; i < CL_MEMCPY_MAX_THREADS && i < cpu_n; i++) {
+    if (pthread_create(&pool.tids[i], NULL, cl_memcpy_worker, (void *)(intptr_t)i)) {
+      DEBUGP(DL_WARNING, "Can not create copy thread %d\n", i);
+      break;
+    }
+    pool.worker_n = i;
+  }
+}
+
+/* Stop and join the copy threads when the library is unloaded */
+static void __attribute__((destructor))
+cl_memcpy_fini(void)
+{
+  int i;
+
+  if (pool.worker_n == 0)
+    return;
+
+  pthread_mutex_lock(&pool.lock);
+  pool.quit = CL_TRUE;
+  pthread_cond_broadcast(&pool.start);
+  pthread_mutex_unlock(&pool.lock);
+
+  for (i = 1; i <= pool.worker_n; i++)
+    pthread_join(pool.tids[i], NULL);
+  pool.worker_n = 0;
+}
+
+LOCAL cl_bool
+cl_memcpy_is_parallel(size_t size)
+{
+  pthread_once(&pool_once, cl_memcpy_init);
+  return pool.worker_n > 0 && size >= pool.threshold;
+}
+
+LOCAL void
+cl_memcpy(void *dst, const void *src, size_t size, cl_bool nt)
+{
+  cl_memcpy_chunk first;
+  size_t chunk_size, offset;
+  int i, n;
+
+  if (!cl_memcpy_is_parallel(size) || pthread_mutex_trylock(&pool.busy) != 0) {
+    if (nt)
+      cl_memcpy_nt(dst, src, size);
+    else
+      memcpy(dst, src, size);
+    return;
+  }
+
+  /* Cut at cache line boundaries */
+  n = pool.worker_n + 1;
+  chunk_size = ALIGN(size / n, 64);
+
+  pthread_mutex_lock(&pool.lock);
+  first.dst = dst;
+  first.src = src;
+  first.size = MIN(chunk_size, size);
+  pool.pending = 0;
+  for (i = 1, offset = first.size; i < n; i++, offset += chunk_size) {
+    pool.chunks[i].dst = (char *)dst + offset;
+    pool.chunks[i].src = (const char *)src + offset;
+    pool.chunks[i].size = offset < size ? MIN(chunk_size, size - offset) : 0;
+    if (pool.chunks[i].size)
+      pool.pending++;
+  }
+  pool.nt = nt;
+  pool.generation++;
+  pthread_cond_broadcast(&pool.start);
+  pthread_mutex_unlock(&pool.lock);
+
+  cl_memcpy_chunk_copy(&first, nt);
+
+  pthread_mutex_lock(&pool.lock);
+  while (pool.pending > 0)
+    pthread_cond_wait(&pool.done, &pool.lock);
+  pthread_mutex_unlock(&pool.lock);
+  pthread_mutex_unlock(&pool.busy);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright © 2017 Intel Corporation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CL_MEMCPY_H__
+#define __CL_MEMCPY_H__
+#include "CL/cl.h"
+#include <stddef.h>
+
+/* Tell if a copy of this size is split across the copy threads. The
+ * threshold is OCL_PARALLEL_COPY_THRESHOLD bytes, 4MB by default. It was not
+ * measured on every platform, benchmark_enqueue_read_write_buffer run with
+ * OCL_PARALLEL_COPY_THRESHOLD=0 and with a threshold above its largest size
+ * gives the crossover of a machine, see docs/optimization-guide.mdwn */
+extern cl_bool cl_memcpy_is_parallel(size_t size);
+
+/* memcpy for the host transfers of the enqueue functions. Copies above the
+ * threshold are split across a small pool of threads. nt asks for
+ * non-temporal stores, for the writes into bos that the GPU reads next; the
+ * reads into user memory keep regular stores since the caller usually reads
+ * the data right after */
+extern void cl_memcpy(void *dst, const void *src, size_t size, cl_bool nt);
+
+#endif /* __CL_MEMCPY_H__ */
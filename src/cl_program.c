@@ -26,6 +26,7 @@
 #include "cl_khr_icd.h"
 #include "cl_gbe_loader.h"
 #include "cl_cmrt.h"
+#include "cl_device_data.h"
 #include "CL/cl.h"
 #include "CL/cl_intel.h"
 #include "CL/cl_ext.h"
@@ -68,9 +69,8 @@ cl_program_delete(cl_program p)
   /* We are not done with it yet */
   if ((ref = CL_OBJECT_DEC_REF(p)) > 1) return;
 
-  /* Destroy the sources and binary if still allocated */
+  /* Destroy the sources if still allocated */
   cl_program_release_sources(p);
-  cl_program_release_binary(p);
 
   /* Release the build options. */
   if (p->build_opts) {
@@ -104,7 +104,7 @@ cl_program_delete(cl_program p)
 
   /* Free the program as allocated by the compiler */
   if (p->opaque) {
-    if (CompilerSupported())
+    if (CompilerLoaded())
       //For static variables release, gbeLoader may have been released, so
       //compiler_program_clean_llvm_resource and interp_program_delete may be NULL.
       if(compiler_program_clean_llvm_resource)
@@ -113,6 +113,9 @@ cl_program_delete(cl_program p)
       interp_program_delete(p->opaque);
   }
 
+  /* Gen binary images are used in place, free them with the program only */
+  cl_program_release_binary(p);
+
   CL_OBJECT_DESTROY_BASE(p);
   cl_free(p);
 }
@@ -161,6 +164,10 @@ cl_program_load_gen_program(cl_program p)
   /* Allocate the kernel array */
   TRY_ALLOC (p->ker, CALLOC_ARRAY(cl_kernel, p->ker_n));
 
+  /* The kernels are set up by cl_program_get_kernel on first use */
+  if (interp_program_is_deferred(p->opaque))
+    return err;
+
   for (i = 0; i < p->ker_n; ++i) {
     const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
     assert(opaque != NULL);
@@ -172,6 +179,34 @@ error:
   return err;
 }
 
+LOCAL cl_kernel
+cl_program_get_kernel(cl_program p, uint32_t index)
+{
+  cl_kernel k;
+
+  assert(index < p->ker_n);
+  CL_OBJECT_LOCK(p);
+  k = p->ker[index];
+  if (k == NULL) {
+    /* Compiles the kernel if the program build was deferred */
+    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, index);
+    if (opaque != NULL && (k = cl_kernel_new(p)) != NULL) {
+      cl_kernel_setup(k, opaque);
+      p->ker[index] = k;
+    }
+  }
+  CL_OBJECT_UNLOCK(p);
+  return k;
+}
+
+static const char *
+cl_program_get_kernel_name(cl_program p, uint32_t index)
+{
+  if (p->ker[index] != NULL)
+    return cl_kernel_get_name(p->ker[index]);
+  return interp_program_get_kernel_name(p->opaque, index);
+}
+
 #define BINARY_HEADER_LENGTH 5
 
 static const unsigned char binary_type_header[BHI_MAX][BINARY_HEADER_LENGTH]=  \
@@ -180,6 +215,7 @@ static const unsigned char binary_type_header[BHI_MAX][BINARY_HEADER_LENGTH]=  \
                                                {2, 'B', 'C', 0xC0, 0xDE},
                                                {1, 'G','E', 'N', 'C'},
                                                {'C','I', 'S', 'A'},
+                                               {1, 'G','E', 'N', 'F'},
                                                };
 
 LOCAL cl_bool headerCompare(const unsigned char *BufPtr, BINARY_HEADER_INDEX index)
@@ -207,6 +243,61 @@ LOCAL cl_bool headerCompare(const unsigned char *BufPtr, BINARY_HEADER_INDEX ind
 #define isLLVM_LIB(BufPtr)  headerCompare(BufPtr, BHI_LIBRARY)
 #define isGenBinary(BufPtr) headerCompare(BufPtr, BHI_GEN_BINARY)
 #define isCMRT(BufPtr)      headerCompare(BufPtr, BHI_CMRT)
+#define isGenFatBinary(BufPtr) headerCompare(BufPtr, BHI_GEN_FAT_BINARY)
+
+#define GEN_BINARY_HEADER_LENGTH 8
+#define FAT_BINARY_ENTRY_LENGTH (GEN_BINARY_HEADER_LENGTH + 2 * sizeof(uint32_t))
+
+/* A fat binary, as written by gbe_bin_generater with several targets, holds
+ * a table of (Gen binary header, offset, size) entries after its 8 bytes
+ * header and entry count. Replace it by the Gen binary of the device: the
+ * backend matches the entry headers against the device, and only the entry
+ * it selects is copied and loaded. */
+static cl_int
+cl_program_select_fat_binary(cl_program p)
+{
+  const char *fat = p->binary;
+  const size_t fat_sz = p->binary_sz;
+  const size_t table_offset = GEN_BINARY_HEADER_LENGTH + sizeof(uint32_t);
+  uint32_t entry_num, offset, size, i;
+  char *binary;
+
+  if (fat_sz < table_offset)
+    return CL_INVALID_BINARY;
+  memcpy(&entry_num, fat + GEN_BINARY_HEADER_LENGTH, sizeof(uint32_t));
+  if (entry_num > (fat_sz - table_offset) / FAT_BINARY_ENTRY_LENGTH)
+    return CL_INVALID_BINARY;
+
+  for (i = 0; i < entry_num; i++) {
+    const char *entry = fat + table_offset + i * FAT_BINARY_ENTRY_LENGTH;
+
+    if (!interp_program_match_binary(p->ctx->devices[0]->device_id, entry))
+      continue;
+    memcpy(&offset, entry + GEN_BINARY_HEADER_LENGTH, sizeof(uint32_t));
+    memcpy(&size, entry + GEN_BINARY_HEADER_LENGTH + sizeof(uint32_t), sizeof(uint32_t));
+    if (offset > fat_sz || size > fat_sz - offset)
+      return CL_INVALID_BINARY;
+
+    binary = cl_calloc(GEN_BINARY_HEADER_LENGTH + size, sizeof(char));
+    if (binary == NULL)
+      return CL_OUT_OF_HOST_MEMORY;
+    memcpy(binary, entry, GEN_BINARY_HEADER_LENGTH);
+    memcpy(binary + GEN_BINARY_HEADER_LENGTH, fat + offset, size);
+    p->opaque = interp_program_new_from_binary(p->ctx->devices[0]->device_id,
+                                               binary, GEN_BINARY_HEADER_LENGTH + size);
+    if (p->opaque == NULL) {
+      cl_free(binary);
+      return CL_INVALID_PROGRAM;
+    }
+    cl_free(p->binary);
+    p->binary = binary;
+    p->binary_sz = GEN_BINARY_HEADER_LENGTH + size;
+    return CL_SUCCESS;
+  }
+
+  DEBUGP(DL_ERROR, "The fat binary holds no entry for this device.");
+  return CL_INVALID_PROGRAM;
+}
 
 static cl_int get_program_global_data(cl_program prog) {
 //OpenCL 1.2 would never call this function, and OpenCL 2.0 alwasy HAS_BO_SET_SOFTPIN.
@@ -298,6 +389,11 @@ cl_program_create_from_binary(cl_context             ctx,
   program->binary_sz = lengths[0];
   program->source_type = FROM_BINARY;
 
+  /* Keep the entry of the device only, as a plain Gen binary */
+  if (isGenFatBinary((unsigned char*)program->binary)) {
+    TRY (cl_program_select_fat_binary, program);
+  }
+
   if (isCMRT((unsigned char*)program->binary)) {
     program->source_type = FROM_CMRT;
   }else if(isSPIR((unsigned char*)program->binary)) {
@@ -305,6 +401,11 @@ cl_program_create_from_binary(cl_context             ctx,
     TRY_ALLOC(typed_binary, cl_calloc(lengths[0]+1, sizeof(char)));
     memcpy(typed_binary+1, binaries[0], lengths[0]);
     *typed_binary = 1;
+    if (!CompilerSupported()) {
+      cl_free(typed_binary);
+      err = CL_COMPILER_NOT_AVAILABLE;
+      goto error;
+    }
     program->opaque = compiler_program_new_from_llvm_binary(program->ctx->devices[0]->device_id, typed_binary, program->binary_sz+1);
     cl_free(typed_binary);
     if (UNLIKELY(program->opaque == NULL)) {
@@ -323,6 +424,10 @@ cl_program_create_from_binary(cl_context             ctx,
       err= CL_INVALID_BINARY;
       goto error;
     }
+    if (!CompilerSupported()) {
+      err = CL_COMPILER_NOT_AVAILABLE;
+      goto error;
+    }
     program->opaque = compiler_program_new_from_llvm_binary(program->ctx->devices[0]->device_id, program->binary, program->binary_sz);
 
     if (UNLIKELY(program->opaque == NULL)) {
@@ -332,7 +437,8 @@ cl_program_create_from_binary(cl_context             ctx,
     program->source_type = FROM_LLVM;
   }
   else if (isGenBinary((unsigned char*)program->binary)) {
-    program->opaque = interp_program_new_from_binary(program->ctx->devices[0]->device_id, program->binary, program->binary_sz);
+    if (program->opaque == NULL)
+      program->opaque = interp_program_new_from_binary(program->ctx->devices[0]->device_id, program->binary, program->binary_sz);
     if (UNLIKELY(program->opaque == NULL)) {
       DEBUGP(DL_ERROR, "Incompatible binary, please delete the binary and generate again.");
       err = CL_INVALID_PROGRAM;
@@ -423,6 +529,11 @@ cl_program_create_from_llvm(cl_context ctx,
   INVALID_DEVICE_IF (devices[0] != ctx->devices[0]);
   INVALID_VALUE_IF (file_name == NULL);
 
+  if (!CompilerSupported()) {
+    err = CL_COMPILER_NOT_AVAILABLE;
+    goto error;
+  }
+
   program = cl_program_new(ctx);
   if (UNLIKELY(program == NULL)) {
       err = CL_OUT_OF_HOST_MEMORY;
@@ -633,18 +744,21 @@ cl_program_build(cl_program p, const char *options)
   }
   p->binary_type = CL_PROGRAM_BINARY_TYPE_EXECUTABLE;
 
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    p->bin_sz += interp_kernel_get_code_size(opaque);
-  }
+  /* Deferred kernels are compiled by their first clCreateKernel */
+  if (!interp_program_is_deferred(p->opaque)) {
+    for (i = 0; i < p->ker_n; i ++) {
+      const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
+      p->bin_sz += interp_kernel_get_code_size(opaque);
+    }
 
-  TRY_ALLOC (p->bin, cl_calloc(p->bin_sz, sizeof(char)));
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    size_t sz = interp_kernel_get_code_size(opaque);
+    TRY_ALLOC (p->bin, cl_calloc(p->bin_sz, sizeof(char)));
+    for (i = 0; i < p->ker_n; i ++) {
+      const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
+      size_t sz = interp_kernel_get_code_size(opaque);
 
-    memcpy(p->bin + copyed, interp_kernel_get_code(opaque), sz);
-    copyed += sz;
+      memcpy(p->bin + copyed, interp_kernel_get_code(opaque), sz);
+      copyed += sz;
+    }
   }
   uint32_t ocl_version = interp_kernel_get_ocl_version(interp_program_get_kernel(p->opaque, 0));
   if (ocl_version >= 200 && (err = get_program_global_data(p)) != CL_SUCCESS)
@@ -672,6 +786,10 @@ cl_program_link(cl_context            context,
   int copyed = 0;
   cl_bool ret = 0;
   int avialable_program = 0;
+  if (!CompilerSupported()) {
+    err = CL_LINKER_NOT_AVAILABLE;
+    goto error;
+  }
   //Although we don't use options, but still need check options
   if(!compiler_program_check_opt(options)) {
     err = CL_INVALID_LINKER_OPTIONS;
@@ -742,18 +860,21 @@ cl_program_link(cl_context            context,
   /* Create all the kernels */
   TRY (cl_program_load_gen_program, p);
 
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    p->bin_sz += interp_kernel_get_code_size(opaque);
-  }
+  /* Deferred kernels are compiled by their first clCreateKernel */
+  if (!interp_program_is_deferred(p->opaque)) {
+    for (i = 0; i < p->ker_n; i ++) {
+      const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
+      p->bin_sz += interp_kernel_get_code_size(opaque);
+    }
 
-  TRY_ALLOC (p->bin, cl_calloc(p->bin_sz, sizeof(char)));
-  for (i = 0; i < p->ker_n; i ++) {
-    const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
-    size_t sz = interp_kernel_get_code_size(opaque);
+    TRY_ALLOC (p->bin, cl_calloc(p->bin_sz, sizeof(char)));
+    for (i = 0; i < p->ker_n; i ++) {
+      const gbe_kernel opaque = interp_program_get_kernel(p->opaque, i);
+      size_t sz = interp_kernel_get_code_size(opaque);
 
-    memcpy(p->bin + copyed, interp_kernel_get_code(opaque), sz);
-    copyed += sz;
+      memcpy(p->bin + copyed, interp_kernel_get_code(opaque), sz);
+      copyed += sz;
+    }
   }
 
   uint32_t ocl_version = interp_kernel_get_ocl_version(interp_program_get_kernel(p->opaque, 0));
@@ -917,20 +1038,24 @@ cl_program_create_kernel(cl_program p, const char *name, cl_int *errcode_ret)
 
   /* Find the program first */
   for (i = 0; i < p->ker_n; ++i) {
-    assert(p->ker[i]);
-    const char *ker_name = cl_kernel_get_name(p->ker[i]);
-    if (ker_name != NULL && strcmp(ker_name, name) == 0) {
-      from = p->ker[i];
+    const char *ker_name = cl_program_get_kernel_name(p, i);
+    if (ker_name != NULL && strcmp(ker_name, name) == 0)
       break;
-    }
   }
 
   /* We were not able to find this named kernel */
-  if (UNLIKELY(from == NULL)) {
+  if (UNLIKELY(i == p->ker_n)) {
     err = CL_INVALID_KERNEL_NAME;
     goto error;
   }
 
+  /* A deferred kernel which fails to compile */
+  from = cl_program_get_kernel(p, i);
+  if (UNLIKELY(from == NULL)) {
+    err = CL_INVALID_PROGRAM_EXECUTABLE;
+    goto error;
+  }
+
   TRY_ALLOC(to, cl_kernel_dup(from));
 
 exit:
@@ -946,13 +1071,19 @@ error:
 LOCAL cl_int
 cl_program_create_kernels_in_program(cl_program p, cl_kernel* ker)
 {
+  cl_int err = CL_OUT_OF_HOST_MEMORY;
   int i = 0;
 
   if(ker == NULL)
     return CL_SUCCESS;
 
   for (i = 0; i < p->ker_n; ++i) {
-    TRY_ALLOC_NO_ERR(ker[i], cl_kernel_dup(p->ker[i]));
+    cl_kernel from = cl_program_get_kernel(p, i);
+    if (UNLIKELY(from == NULL)) {
+      err = CL_INVALID_PROGRAM_EXECUTABLE;
+      goto error;
+    }
+    TRY_ALLOC_NO_ERR(ker[i], cl_kernel_dup(from));
   }
 
   return CL_SUCCESS;
@@ -963,7 +1094,7 @@ error:
     ker[i--] = NULL;
   } while(i > 0);
 
-  return CL_OUT_OF_HOST_MEMORY;
+  return err;
 }
 
 LOCAL void
@@ -978,7 +1109,7 @@ cl_program_get_kernel_names(cl_program p, size_t size, char *names, size_t *size
     return;
   }
 
-  ker_name = cl_kernel_get_name(p->ker[0]);
+  ker_name = cl_program_get_kernel_name(p, 0);
   if (ker_name != NULL)
     len = strlen(ker_name);
   else
@@ -995,7 +1126,7 @@ cl_program_get_kernel_names(cl_program p, size_t size, char *names, size_t *size
   if(size_ret) *size_ret = len + 1;  //add NULL
 
   for (i = 1; i < p->ker_n; ++i) {
-    ker_name = cl_kernel_get_name(p->ker[i]);
+    ker_name = cl_program_get_kernel_name(p, i);
     if (ker_name != NULL)
       len = strlen(ker_name);
     else
@@ -45,6 +45,7 @@ typedef enum _BINARY_HEADER_INDEX {
   BHI_LIBRARY = 2,
   BHI_GEN_BINARY = 3,
   BHI_CMRT = 4,
+  BHI_GEN_FAT_BINARY = 5,
   BHI_MAX,
 }BINARY_HEADER_INDEX;
 
@@ -90,6 +91,10 @@ extern void cl_program_delete(cl_program);
 /* Add one more reference to the object (to defer its deletion) */
 extern void cl_program_add_ref(cl_program);
 
+/* Get the index-th kernel of the program, compiling it if its build was
+ * deferred. Returns NULL if the compilation fails */
+extern cl_kernel cl_program_get_kernel(cl_program, uint32_t index);
+
 /* Create a kernel for the OCL user */
 extern cl_kernel cl_program_create_kernel(cl_program, const char*, cl_int*);
 
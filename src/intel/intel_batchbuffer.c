@@ -103,12 +103,10 @@ intel_batchbuffer_terminate(intel_batchbuffer_t *batch)
   batch->buffer = NULL;
 }
 
-LOCAL int
-intel_batchbuffer_flush(intel_batchbuffer_t *batch)
+LOCAL uint32_t
+intel_batchbuffer_close(intel_batchbuffer_t *batch)
 {
   uint32_t used = batch->ptr - batch->map;
-  int is_locked = batch->intel->locked;
-  int err = 0;
 
   if (used == 0)
     return 0;
@@ -123,6 +121,18 @@ intel_batchbuffer_flush(intel_batchbuffer_t *batch)
   used = batch->ptr - batch->map;
   dri_bo_unmap(batch->buffer);
   batch->ptr = batch->map = NULL;
+  return used;
+}
+
+LOCAL int
+intel_batchbuffer_flush(intel_batchbuffer_t *batch)
+{
+  int is_locked = batch->intel->locked;
+  int err = 0;
+  uint32_t used = intel_batchbuffer_close(batch);
+
+  if (used == 0)
+    return 0;
 
   if (!is_locked)
     intel_driver_lock_hardware(batch->intel);
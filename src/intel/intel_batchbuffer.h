@@ -98,6 +98,9 @@ extern void intel_batchbuffer_emit_reloc(intel_batchbuffer_t*,
                                          uint32_t delta);
 extern void intel_batchbuffer_init(intel_batchbuffer_t*, struct intel_driver*);
 extern void intel_batchbuffer_terminate(intel_batchbuffer_t*);
+/* Terminate the batch and unmap it without submitting it. Returns the bytes
+ * used, 0 if the batch is empty */
+extern uint32_t intel_batchbuffer_close(intel_batchbuffer_t*);
 extern int intel_batchbuffer_flush(intel_batchbuffer_t*);
 extern int intel_batchbuffer_reset(intel_batchbuffer_t*, size_t sz);
 
@@ -72,6 +72,7 @@
 #include <sys/ioctl.h>
 #include <xf86drm.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "cl_utils.h"
 #include "cl_alloc.h"
@@ -177,6 +178,7 @@ intel_driver_init(intel_driver_t *driver, int dev_fd)
 driver->fd = dev_fd;
 driver->locked = 0;
 pthread_mutex_init(&driver->ctxmutex, NULL);
+pthread_mutex_init(&driver->kernel_code_lock, NULL);
 
 if (!intel_driver_memman_init(driver)) return 0;
 if (!intel_driver_context_init(driver)) return 0;
@@ -275,9 +277,13 @@ if (props && props->gl_type == CL_GL_EGL_DISPLAY) {
 return CL_SUCCESS;
 }
 
+static void intel_driver_release_kernel_codes(intel_driver_t *driver);
+
 static void
 intel_driver_close(intel_driver_t *intel)
 {
+/* The cached kernel code bos belong to the bufmgr */
+intel_driver_release_kernel_codes(intel);
 //Due to the drm change about the test usrptr, we need to destroy the bufmgr
 //befor the driver was closed, otherwise the test usrptr will not be freed.
 if (intel->bufmgr)
@@ -368,6 +374,7 @@ LOCAL int
 intel_driver_terminate(intel_driver_t *driver)
 {
 pthread_mutex_destroy(&driver->ctxmutex);
+pthread_mutex_destroy(&driver->kernel_code_lock);
 
 if(driver->need_close) {
   close(driver->fd);
@@ -446,6 +453,122 @@ intel_driver_delete(driver);
 return intel_device_id;
 }
 
+/* A kernel code buffer, shared by all the kernels of the driver with the same
+ * code. Entries are looked up by hash and size and the host copy of the code
+ * confirms the match. Kernels keep their entry, their copies only add a user */
+typedef struct intel_kernel_code {
+  struct intel_kernel_code *next;
+  struct intel_kernel_code **pprev; /* the pointer to this entry in the list */
+  uint64_t hash;
+  size_t size;
+  char *code;
+  drm_intel_bo *bo;
+  uint32_t users;
+} intel_kernel_code_t;
+
+static uint64_t
+intel_kernel_code_hash(const char *code, size_t size)
+{
+  /* FNV-1a */
+  uint64_t hash = 0xcbf29ce484222325ull;
+  size_t i;
+  for (i = 0; i < size; i++) {
+    hash ^= (unsigned char)code[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static drm_intel_bo *
+intel_buffer_get_kernel_code(intel_driver_t *driver, const char *code, size_t size,
+                             intel_kernel_code_t **found)
+{
+  const uint64_t hash = intel_kernel_code_hash(code, size);
+  intel_kernel_code_t *entry;
+  drm_intel_bo *bo = NULL;
+
+  *found = NULL;
+  pthread_mutex_lock(&driver->kernel_code_lock);
+  for (entry = driver->kernel_codes; entry != NULL; entry = entry->next)
+    if (entry->hash == hash && entry->size == size && memcmp(entry->code, code, size) == 0)
+      break;
+
+  /* First kernel with this code, upload it */
+  if (entry == NULL) {
+    entry = cl_calloc(1, sizeof(intel_kernel_code_t));
+    if (entry == NULL)
+      goto exit;
+    entry->code = cl_malloc(size);
+    entry->bo = drm_intel_bo_alloc(driver->bufmgr, "CL kernel", size, 64u);
+    if (entry->code == NULL || entry->bo == NULL) {
+      if (entry->bo)
+        drm_intel_bo_unreference(entry->bo);
+      cl_free(entry->code);
+      cl_free(entry);
+      goto exit;
+    }
+    memcpy(entry->code, code, size);
+    drm_intel_bo_subdata(entry->bo, 0, size, code);
+    entry->hash = hash;
+    entry->size = size;
+    entry->next = driver->kernel_codes;
+    entry->pprev = &driver->kernel_codes;
+    if (entry->next)
+      entry->next->pprev = &entry->next;
+    driver->kernel_codes = entry;
+  }
+
+  entry->users++;
+  bo = entry->bo;
+  *found = entry;
+exit:
+  pthread_mutex_unlock(&driver->kernel_code_lock);
+  return bo;
+}
+
+static void
+intel_buffer_ref_kernel_code(intel_driver_t *driver, intel_kernel_code_t *entry)
+{
+  pthread_mutex_lock(&driver->kernel_code_lock);
+  entry->users++;
+  pthread_mutex_unlock(&driver->kernel_code_lock);
+}
+
+static void
+intel_buffer_put_kernel_code(intel_driver_t *driver, intel_kernel_code_t *entry)
+{
+  pthread_mutex_lock(&driver->kernel_code_lock);
+  if (--entry->users == 0) {
+    *entry->pprev = entry->next;
+    if (entry->next)
+      entry->next->pprev = entry->pprev;
+  } else
+    entry = NULL;
+  pthread_mutex_unlock(&driver->kernel_code_lock);
+
+  if (entry) {
+    drm_intel_bo_unreference(entry->bo);
+    cl_free(entry->code);
+    cl_free(entry);
+  }
+}
+
+/* Free the entries still cached, normally none once all the kernels are gone */
+static void
+intel_driver_release_kernel_codes(intel_driver_t *driver)
+{
+  intel_kernel_code_t *entry;
+
+  pthread_mutex_lock(&driver->kernel_code_lock);
+  while ((entry = driver->kernel_codes) != NULL) {
+    driver->kernel_codes = entry->next;
+    drm_intel_bo_unreference(entry->bo);
+    cl_free(entry->code);
+    cl_free(entry);
+  }
+  pthread_mutex_unlock(&driver->kernel_code_lock);
+}
+
 extern void intel_gpgpu_delete_all(intel_driver_t *driver);
 static void
 cl_intel_driver_delete(intel_driver_t *driver)
@@ -517,6 +640,14 @@ default:
 return CL_NO_TILE;
 }
 
+static int intel_buffer_is_swizzled(drm_intel_bo *bo)
+{
+uint32_t tiling_mode, swizzle_mode;
+if (drm_intel_bo_get_tiling(bo, &tiling_mode, &swizzle_mode) != 0)
+  return 1;
+return swizzle_mode != I915_BIT_6_SWIZZLE_NONE;
+}
+
 static uint32_t intel_buffer_get_tiling_align(cl_context ctx, uint32_t tiling_mode, uint32_t dim)
 {
 uint32_t gen_ver = ((intel_driver_t *)ctx->drv)->gen_ver;
@@ -1017,6 +1148,9 @@ cl_driver_get_device_id = (cl_driver_get_device_id_cb *) intel_get_device_id;
 cl_driver_update_device_info = (cl_driver_update_device_info_cb *) intel_update_device_info;
 cl_buffer_alloc = (cl_buffer_alloc_cb *) drm_intel_bo_alloc;
 cl_buffer_alloc_userptr = (cl_buffer_alloc_userptr_cb*) intel_buffer_alloc_userptr;
+cl_buffer_get_kernel_code = (cl_buffer_get_kernel_code_cb *) intel_buffer_get_kernel_code;
+cl_buffer_ref_kernel_code = (cl_buffer_ref_kernel_code_cb *) intel_buffer_ref_kernel_code;
+cl_buffer_put_kernel_code = (cl_buffer_put_kernel_code_cb *) intel_buffer_put_kernel_code;
 #ifdef HAS_BO_SET_SOFTPIN
 cl_buffer_set_softpin_offset = (cl_buffer_set_softpin_offset_cb *) drm_intel_bo_set_softpin_offset;
 cl_buffer_set_bo_use_full_range = (cl_buffer_set_bo_use_full_range_cb *) drm_intel_bo_use_48b_address_range;
@@ -1036,6 +1170,8 @@ cl_buffer_set_bo_use_full_range = (cl_buffer_set_bo_use_full_range_cb *) drm_int
   cl_buffer_map_gtt = (cl_buffer_map_gtt_cb *) drm_intel_gem_bo_map_gtt;
   cl_buffer_unmap_gtt = (cl_buffer_unmap_gtt_cb *) drm_intel_gem_bo_unmap_gtt;
   cl_buffer_map_gtt_unsync = (cl_buffer_map_gtt_unsync_cb *) drm_intel_gem_bo_map_unsynchronized;
+  cl_buffer_is_swizzled = (cl_buffer_is_swizzled_cb *) intel_buffer_is_swizzled;
+  cl_buffer_is_busy = (cl_buffer_is_busy_cb *) drm_intel_bo_busy;
   cl_buffer_get_virtual = (cl_buffer_get_virtual_cb *) drm_intel_bo_get_virtual;
   cl_buffer_get_size = (cl_buffer_get_size_cb *) drm_intel_bo_get_size;
   cl_buffer_pin = (cl_buffer_pin_cb *) drm_intel_bo_pin;
@@ -61,6 +61,9 @@
 
 #define MI_NOOP                                 (CMD_MI | 0)
 #define MI_BATCH_BUFFER_END                     (CMD_MI | (0xA << 23))
+#define MI_BATCH_BUFFER_START                   (CMD_MI | (0x31 << 23))
+#define MI_BATCH_SECOND_LEVEL                   (1 << 22)
+#define MI_BATCH_PPGTT                          (1 << 8)
 
 #define XY_COLOR_BLT_CMD                        (CMD_2D | (0x50 << 22) | 0x04)
 #define XY_COLOR_BLT_WRITE_ALPHA                (1 << 21)
@@ -73,6 +76,7 @@
 
 struct dri_state;
 struct intel_gpgpu_node;
+struct intel_kernel_code;
 typedef struct _XDisplay Display;
 
 typedef struct intel_driver
@@ -91,6 +95,8 @@ typedef struct intel_driver
   struct dri_state *dri_ctx;
   struct intel_gpgpu_node *gpgpu_list;
   int atomic_test_result;
+  pthread_mutex_t kernel_code_lock;
+  struct intel_kernel_code *kernel_codes; /* Kernel code buffers by content */
 } intel_driver_t;
 
 #define SET_BLOCKED_SIGSET(DRIVER)   do {                     \
@@ -112,6 +112,26 @@ intel_gpgpu_pipe_control_t *intel_gpgpu_pipe_control = NULL;
 typedef void (intel_gpgpu_select_pipeline_t)(intel_gpgpu_t *gpgpu);
 intel_gpgpu_select_pipeline_t *intel_gpgpu_select_pipeline = NULL;
 
+static int
+intel_gpgpu_wait(void *buf, int64_t timeout_ns)
+{
+  int ret;
+
+  if (buf == NULL)
+    return 0;
+
+  /* Unlike bo_wait_rendering, this only sleeps on the request and does not
+   * move the bo to the GTT domain, the caller still syncs before touching it */
+  ret = drm_intel_gem_bo_wait((drm_intel_bo *)buf, timeout_ns);
+  if (ret == -ETIME)
+    return ret;
+
+  /* Kernels without the wait ioctl */
+  if (ret != 0)
+    drm_intel_bo_wait_rendering((drm_intel_bo *)buf);
+  return 0;
+}
+
 static void
 intel_gpgpu_sync(void *buf)
 {
@@ -895,6 +915,32 @@ intel_gpgpu_flush(intel_gpgpu_t *gpgpu)
   */
 }
 
+static int
+intel_gpgpu_batch_chain_gen7(intel_gpgpu_t *gpgpu, intel_gpgpu_t *child)
+{
+  /* Not done before gen8, the batches are flushed one by one */
+  return -1;
+}
+
+static int
+intel_gpgpu_batch_chain_gen8(intel_gpgpu_t *gpgpu, intel_gpgpu_t *child)
+{
+  if (!child->batch || !child->batch->buffer || !child->batch->map)
+    return -1;
+  if (intel_batchbuffer_space(gpgpu->batch) < 3 * 4 + 8)
+    return -1;
+
+  /* A second level batch returns to its caller at MI_BATCH_BUFFER_END */
+  if (intel_batchbuffer_close(child->batch) == 0)
+    return 0;
+  BEGIN_BATCH(gpgpu->batch, 3);
+  OUT_BATCH(gpgpu->batch, MI_BATCH_BUFFER_START | MI_BATCH_SECOND_LEVEL | MI_BATCH_PPGTT | (3 - 2));
+  OUT_RELOC(gpgpu->batch, child->batch->buffer, I915_GEM_DOMAIN_COMMAND, 0, 0);
+  OUT_BATCH(gpgpu->batch, 0);
+  ADVANCE_BATCH(gpgpu->batch);
+  return 0;
+}
+
 static int
 intel_gpgpu_state_init(intel_gpgpu_t *gpgpu,
                        uint32_t max_threads,
@@ -2480,22 +2526,25 @@ intel_gpgpu_get_profiling_info(intel_gpgpu_t *gpgpu)
 }
 
 static int
-intel_gpgpu_set_printf_buf(intel_gpgpu_t *gpgpu, uint32_t size, uint8_t bti)
+intel_gpgpu_set_printf_buf(intel_gpgpu_t *gpgpu, drm_intel_bo *bo, uint32_t offset, uint32_t size, uint8_t bti)
 {
   if (gpgpu->printf_b.bo)
     dri_bo_unreference(gpgpu->printf_b.bo);
-  gpgpu->printf_b.bo = dri_bo_alloc(gpgpu->drv->bufmgr, "Printf buffer", size, 4096);
-
-  if (!gpgpu->printf_b.bo || (drm_intel_bo_map(gpgpu->printf_b.bo, 1) != 0)) {
+  drm_intel_bo_reference(bo);
+  gpgpu->printf_b.bo = bo;
+  gpgpu->printf_b.offset = offset;
+  gpgpu->printf_b.size = size;
+
+  /* Other launches may still write the rest of the bo, do not wait for them.
+   * Only the length needs to be set, the logs are parsed up to it. */
+  if (drm_intel_gem_bo_map_unsynchronized(bo) != 0) {
     fprintf(stderr, "%s:%d: %s.\n", __FILE__, __LINE__, strerror(errno));
     return -1;
   }
-
-  memset(gpgpu->printf_b.bo->virtual, 0, size);
-  *(uint32_t *)(gpgpu->printf_b.bo->virtual) = 4; // first four is for the length.
-  drm_intel_bo_unmap(gpgpu->printf_b.bo);
+  *(uint32_t *)((char *)bo->virtual + offset) = 4; // first four is for the length.
+  drm_intel_gem_bo_unmap_gtt(bo);
   /* No need to bind, we do not need to emit reloc. */
-  intel_gpgpu_setup_bti(gpgpu, gpgpu->printf_b.bo, 0, size, bti, I965_SURFACEFORMAT_RAW);
+  intel_gpgpu_setup_bti(gpgpu, bo, offset, size, bti, I965_SURFACEFORMAT_RAW);
   return 0;
 }
 
@@ -2518,12 +2567,20 @@ intel_gpgpu_unmap_profiling_buf_addr(intel_gpgpu_t *gpgpu)
 
 
 static void*
-intel_gpgpu_map_printf_buf(intel_gpgpu_t *gpgpu)
+intel_gpgpu_map_printf_buf(intel_gpgpu_t *gpgpu, uint32_t *size)
 {
   drm_intel_bo *bo = NULL;
   bo = gpgpu->printf_b.bo;
-  drm_intel_bo_map(bo, 1);
-  return bo->virtual;
+  /* The batch is done, but the following launches may use the rest of the bo */
+  drm_intel_gem_bo_map_unsynchronized(bo);
+  *size = gpgpu->printf_b.size;
+  return (char *)bo->virtual + gpgpu->printf_b.offset;
+}
+
+static drm_intel_bo*
+intel_gpgpu_get_printf_buf(intel_gpgpu_t *gpgpu)
+{
+  return gpgpu->printf_b.bo;
 }
 
 static void
@@ -2531,7 +2588,7 @@ intel_gpgpu_unmap_printf_buf_addr(intel_gpgpu_t *gpgpu)
 {
   drm_intel_bo *bo = NULL;
   bo = gpgpu->printf_b.bo;
-  drm_intel_bo_unmap(bo);
+  drm_intel_gem_bo_unmap_gtt(bo);
 }
 
 static void
@@ -2571,6 +2628,7 @@ intel_set_gpgpu_callbacks(int device_id)
   cl_gpgpu_new = (cl_gpgpu_new_cb *) intel_gpgpu_new;
   cl_gpgpu_delete = (cl_gpgpu_delete_cb *) intel_gpgpu_delete;
   cl_gpgpu_sync = (cl_gpgpu_sync_cb *) intel_gpgpu_sync;
+  cl_gpgpu_wait = (cl_gpgpu_wait_cb *) intel_gpgpu_wait;
   cl_gpgpu_bind_buf = (cl_gpgpu_bind_buf_cb *) intel_gpgpu_bind_buf;
   cl_gpgpu_set_stack = (cl_gpgpu_set_stack_cb *) intel_gpgpu_set_stack;
   cl_gpgpu_state_init = (cl_gpgpu_state_init_cb *) intel_gpgpu_state_init;
@@ -2582,6 +2640,7 @@ intel_set_gpgpu_callbacks(int device_id)
   cl_gpgpu_batch_start = (cl_gpgpu_batch_start_cb *) intel_gpgpu_batch_start;
   cl_gpgpu_batch_end = (cl_gpgpu_batch_end_cb *) intel_gpgpu_batch_end;
   cl_gpgpu_flush = (cl_gpgpu_flush_cb *) intel_gpgpu_flush;
+  cl_gpgpu_batch_chain = (cl_gpgpu_batch_chain_cb *) intel_gpgpu_batch_chain_gen7;
   cl_gpgpu_bind_sampler = (cl_gpgpu_bind_sampler_cb *) intel_gpgpu_bind_sampler_gen7;
   cl_gpgpu_bind_vme_state = (cl_gpgpu_bind_vme_state_cb *) intel_gpgpu_bind_vme_state_gen7;
   cl_gpgpu_set_scratch = (cl_gpgpu_set_scratch_cb *) intel_gpgpu_set_scratch;
@@ -2600,6 +2659,7 @@ intel_set_gpgpu_callbacks(int device_id)
   cl_gpgpu_unmap_profiling_buffer = (cl_gpgpu_unmap_profiling_buffer_cb *)intel_gpgpu_unmap_profiling_buf_addr;
   cl_gpgpu_set_printf_buffer = (cl_gpgpu_set_printf_buffer_cb *)intel_gpgpu_set_printf_buf;
   cl_gpgpu_map_printf_buffer = (cl_gpgpu_map_printf_buffer_cb *)intel_gpgpu_map_printf_buf;
+  cl_gpgpu_get_printf_buffer = (cl_gpgpu_get_printf_buffer_cb *)intel_gpgpu_get_printf_buf;
   cl_gpgpu_unmap_printf_buffer = (cl_gpgpu_unmap_printf_buffer_cb *)intel_gpgpu_unmap_printf_buf_addr;
   cl_gpgpu_release_printf_buffer = (cl_gpgpu_release_printf_buffer_cb *)intel_gpgpu_release_printf_buf;
   cl_gpgpu_set_printf_info = (cl_gpgpu_set_printf_info_cb *)intel_gpgpu_set_printf_info;
@@ -2627,6 +2687,7 @@ intel_set_gpgpu_callbacks(int device_id)
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen7;
     cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_batch_chain = (cl_gpgpu_batch_chain_cb *) intel_gpgpu_batch_chain_gen8;
     return;
   }
   if (IS_GEN9(device_id)) {
@@ -2650,6 +2711,7 @@ intel_set_gpgpu_callbacks(int device_id)
     intel_gpgpu_pipe_control = intel_gpgpu_pipe_control_gen8;
     intel_gpgpu_select_pipeline = intel_gpgpu_select_pipeline_gen9;
     cl_gpgpu_upload_curbes = (cl_gpgpu_upload_curbes_cb *) intel_gpgpu_upload_curbes_gen8;
+    cl_gpgpu_batch_chain = (cl_gpgpu_batch_chain_cb *) intel_gpgpu_batch_chain_gen8;
     return;
   }
 
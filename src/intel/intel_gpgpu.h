@@ -65,7 +65,7 @@ struct intel_gpgpu
   struct { drm_intel_bo *bo; } scratch_b;
   struct { drm_intel_bo *bo; } constant_b;
   struct { drm_intel_bo *bo; } time_stamp_b;  /* time stamp buffer */
-  struct { drm_intel_bo *bo; } printf_b;      /* the printf buf and index buf*/
+  struct { drm_intel_bo *bo; uint32_t offset; uint32_t size; } printf_b; /* the printf buf and index buf*/
   struct { drm_intel_bo *bo; } profiling_b;   /* the buf for profiling*/
   struct { drm_intel_bo *bo; } aux_buf;
   struct {
@@ -0,0 +1,50 @@
+/* Buffer copies of the calibrated copy path. size is counted in T and a
+ * work-item moves UNROLL elements, one global size apart so that the
+ * accesses of the work-items stay contiguous. All the loads are issued
+ * before the stores. */
+#define COPY_BUF_VEC(T, UNROLL) \
+kernel void __cl_copy_buf_##T##_x##UNROLL(global T* src, unsigned int src_offset, \
+                                          global T* dst, unsigned int dst_offset, \
+                                          unsigned int size) \
+{ \
+  unsigned int i = get_global_id(0); \
+  unsigned int n = get_global_size(0); \
+  T data[UNROLL]; \
+  for (int k = 0; k < UNROLL; k++) \
+    if (i + k * n < size) \
+      data[k] = src[src_offset + i + k * n]; \
+  for (int k = 0; k < UNROLL; k++) \
+    if (i + k * n < size) \
+      dst[dst_offset + i + k * n] = data[k]; \
+}
+
+COPY_BUF_VEC(uint, 1)
+COPY_BUF_VEC(uint, 4)
+COPY_BUF_VEC(uint4, 1)
+COPY_BUF_VEC(uint4, 2)
+COPY_BUF_VEC(uint4, 4)
+COPY_BUF_VEC(uint8, 1)
+COPY_BUF_VEC(uint8, 2)
+COPY_BUF_VEC(uint16, 1)
+
+/* Same with the sub group block messages: each sub group moves N * sub group
+ * size contiguous dwords with one OWord block read and write. The offsets are
+ * counted in dwords and the addresses must be 16 bytes aligned. The last,
+ * partial, chunk is copied element by element. */
+#define COPY_BUF_BLOCK(N) \
+kernel void __cl_copy_buf_block##N(global uint* src, unsigned int src_offset, \
+                                   global uint* dst, unsigned int dst_offset, \
+                                   unsigned int size) \
+{ \
+  unsigned int i = get_global_id(0); \
+  unsigned int base = (i - get_sub_group_local_id()) * N; \
+  if (base + N * get_sub_group_size() <= size * N) { \
+    uint##N data = intel_sub_group_block_read##N(src + src_offset + base); \
+    intel_sub_group_block_write##N(dst + dst_offset + base, data); \
+  } else if (i < size) { \
+    vstore##N(vload##N(i, src + src_offset), i, dst + dst_offset); \
+  } \
+}
+
+COPY_BUF_BLOCK(4)
+COPY_BUF_BLOCK(8)
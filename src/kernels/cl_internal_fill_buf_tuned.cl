@@ -0,0 +1,39 @@
+/* Buffer fills of the calibrated fill path. The pattern is replicated to 16
+ * bytes by the runtime, size is counted in T and a work-item writes UNROLL
+ * elements, one global size apart. */
+#define FILL_BUF_VEC(T, UNROLL, EXPAND) \
+kernel void __cl_fill_buf_##T##_x##UNROLL(global T* dst, uint4 pattern, \
+                                          unsigned int offset, unsigned int size) \
+{ \
+  unsigned int i = get_global_id(0); \
+  unsigned int n = get_global_size(0); \
+  T data = EXPAND; \
+  for (int k = 0; k < UNROLL; k++) \
+    if (i + k * n < size) \
+      dst[offset + i + k * n] = data; \
+}
+
+FILL_BUF_VEC(uint4, 1, pattern)
+FILL_BUF_VEC(uint4, 4, pattern)
+FILL_BUF_VEC(uint8, 2, ((uint8)(pattern, pattern)))
+FILL_BUF_VEC(uint16, 1, ((uint16)(pattern, pattern, pattern, pattern)))
+FILL_BUF_VEC(uint16, 2, ((uint16)(pattern, pattern, pattern, pattern)))
+
+/* Same with the sub group block writes. The offset is counted in dwords and
+ * the address must be 16 bytes aligned. The chunk of a sub group starts on a
+ * pattern boundary and the sub group size is a multiple of 4, so the dwords
+ * written by a lane all take the same pattern dword. */
+kernel void __cl_fill_buf_block4(global uint* dst, uint4 pattern,
+                                 unsigned int offset, unsigned int size)
+{
+  unsigned int i = get_global_id(0);
+  unsigned int lane = get_sub_group_local_id();
+  unsigned int base = (i - lane) * 4;
+  if (base + 4 * get_sub_group_size() <= size * 4) {
+    uint v = (lane & 2) ? ((lane & 1) ? pattern.w : pattern.z)
+                        : ((lane & 1) ? pattern.y : pattern.x);
+    intel_sub_group_block_write4(dst + offset + base, (uint4)(v));
+  } else if (i < size) {
+    vstore4(pattern, i, dst + offset);
+  }
+}
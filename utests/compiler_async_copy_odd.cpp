@@ -0,0 +1,134 @@
+#include "utest_helper.hpp"
+#include <string.h>
+
+/* async_work_group_copy picks 16 bytes, 4 bytes or byte accesses from the
+ * alignment of both pointers and copies the tail element by element. Run it
+ * with odd sizes and offsets and work groups which do not divide them */
+
+static const size_t async_odd_sizes[] = {1, 3, 15, 16, 17, 63, 250, 1001};
+static const size_t async_odd_offsets[] = {0, 1, 3, 4, 16};
+static const size_t async_odd_groups[] = {16, 48};
+
+template <typename T>
+static void async_copy_odd_run(void)
+{
+  const size_t max_n = 1001 + 16;
+  T src[max_n], dst[max_n];
+
+  OCL_CREATE_BUFFER(buf[0], 0, max_n * sizeof(T), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, max_n * sizeof(T), NULL);
+  for (size_t i = 0; i < max_n; ++i)
+    src[i] = (T)rand();
+  OCL_CALL (clEnqueueWriteBuffer, queue, buf[1], CL_TRUE, 0, sizeof(src), src, 0, NULL, NULL);
+
+  for (size_t g = 0; g < sizeof(async_odd_groups) / sizeof(async_odd_groups[0]); ++g)
+  for (size_t s = 0; s < sizeof(async_odd_sizes) / sizeof(async_odd_sizes[0]); ++s)
+  for (size_t o = 0; o < sizeof(async_odd_offsets) / sizeof(async_odd_offsets[0]); ++o) {
+    const int num = async_odd_sizes[s];
+    const int src_off = async_odd_offsets[o];
+    const int dst_off = async_odd_offsets[(o + 2) % 5];
+
+    memset(dst, 0, sizeof(dst));
+    OCL_CALL (clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, sizeof(dst), dst, 0, NULL, NULL);
+    OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+    OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+    OCL_SET_ARG(2, num * sizeof(T), NULL);
+    OCL_SET_ARG(3, sizeof(int), &num);
+    OCL_SET_ARG(4, sizeof(int), &src_off);
+    OCL_SET_ARG(5, sizeof(int), &dst_off);
+    globals[0] = locals[0] = async_odd_groups[g];
+    OCL_NDRANGE(1);
+
+    OCL_CALL (clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, sizeof(dst), dst, 0, NULL, NULL);
+    for (int i = 0; i < (int)max_n; ++i) {
+      if (i >= dst_off && i < dst_off + num)
+        OCL_ASSERT(dst[i] == src[i - dst_off + src_off]);
+      else
+        OCL_ASSERT(dst[i] == 0);
+    }
+  }
+}
+
+static void compiler_async_copy_odd_uchar(void)
+{
+  OCL_CREATE_KERNEL_FROM_FILE("compiler_async_copy_odd", "compiler_async_copy_odd_uchar");
+  async_copy_odd_run<unsigned char>();
+}
+MAKE_UTEST_FROM_FUNCTION(compiler_async_copy_odd_uchar);
+
+static void compiler_async_copy_odd_uint(void)
+{
+  OCL_CREATE_KERNEL_FROM_FILE("compiler_async_copy_odd", "compiler_async_copy_odd_uint");
+  async_copy_odd_run<unsigned int>();
+}
+MAKE_UTEST_FROM_FUNCTION(compiler_async_copy_odd_uint);
+
+static void compiler_async_copy_odd_strided(void)
+{
+  static const int strides[][2] = {{1, 1}, {2, 1}, {1, 3}, {5, 7}};
+  const size_t max_n = 250 * 7;
+  short src[max_n], dst[max_n];
+
+  OCL_CREATE_KERNEL_FROM_FILE("compiler_async_copy_odd", "compiler_async_copy_odd_strided");
+  OCL_CREATE_BUFFER(buf[0], 0, sizeof(dst), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, sizeof(src), NULL);
+  for (size_t i = 0; i < max_n; ++i)
+    src[i] = (short)rand();
+  OCL_CALL (clEnqueueWriteBuffer, queue, buf[1], CL_TRUE, 0, sizeof(src), src, 0, NULL, NULL);
+
+  for (size_t g = 0; g < sizeof(async_odd_groups) / sizeof(async_odd_groups[0]); ++g)
+  for (size_t s = 0; s < sizeof(async_odd_sizes) / sizeof(async_odd_sizes[0]) - 1; ++s)
+  for (size_t t = 0; t < sizeof(strides) / sizeof(strides[0]); ++t) {
+    const int num = async_odd_sizes[s];
+    const int src_stride = strides[t][0], dst_stride = strides[t][1];
+
+    memset(dst, 0, sizeof(dst));
+    OCL_CALL (clEnqueueWriteBuffer, queue, buf[0], CL_TRUE, 0, sizeof(dst), dst, 0, NULL, NULL);
+    OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+    OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+    OCL_SET_ARG(2, num * sizeof(short), NULL);
+    OCL_SET_ARG(3, sizeof(int), &num);
+    OCL_SET_ARG(4, sizeof(int), &src_stride);
+    OCL_SET_ARG(5, sizeof(int), &dst_stride);
+    globals[0] = locals[0] = async_odd_groups[g];
+    OCL_NDRANGE(1);
+
+    OCL_CALL (clEnqueueReadBuffer, queue, buf[0], CL_TRUE, 0, sizeof(dst), dst, 0, NULL, NULL);
+    for (int i = 0; i < (int)max_n; ++i) {
+      if (i % dst_stride == 0 && i / dst_stride < num)
+        OCL_ASSERT(dst[i] == src[i / dst_stride * src_stride]);
+      else
+        OCL_ASSERT(dst[i] == 0);
+    }
+  }
+}
+MAKE_UTEST_FROM_FUNCTION(compiler_async_copy_odd_strided);
+
+static void compiler_async_copy_odd_prefetch(void)
+{
+  const int num = 37;
+  const size_t n = 64;
+
+  OCL_CREATE_KERNEL_FROM_FILE("compiler_async_copy_odd", "compiler_async_copy_odd_prefetch");
+  OCL_CREATE_BUFFER(buf[0], 0, n * num * sizeof(int), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, n * num * sizeof(int), NULL);
+  OCL_MAP_BUFFER(1);
+  for (size_t i = 0; i < n * num; ++i)
+    ((int *)buf_data[1])[i] = rand() & 0xffffff;
+  OCL_UNMAP_BUFFER(1);
+
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(2, sizeof(int), &num);
+  globals[0] = n;
+  locals[0] = 16;
+  OCL_NDRANGE(1);
+
+  OCL_MAP_BUFFER(0);
+  OCL_MAP_BUFFER(1);
+  for (size_t i = 0; i < n * num; ++i)
+    OCL_ASSERT(((int *)buf_data[0])[i] == ((int *)buf_data[1])[i] + 1);
+  OCL_UNMAP_BUFFER(0);
+  OCL_UNMAP_BUFFER(1);
+}
+MAKE_UTEST_FROM_FUNCTION(compiler_async_copy_odd_prefetch);
@@ -0,0 +1,46 @@
+#include "utest_helper.hpp"
+
+static void cpu(int gid, const int *src, int n, int64_t *dst)
+{
+  const int64_t prod = (int64_t)src[2*gid] * src[2*gid+1];
+  int64_t acc = (int64_t)(3 * 5) << 2;
+  for (int i = 0; i < n; i++)
+    acc += prod >> (i & 7);
+  dst[gid] = 2 * (prod + gid) + acc;
+}
+
+void compiler_gen_ir_opt(void)
+{
+  const size_t n = 64;
+  const int loop = 11;
+  int cpu_src[2*n];
+  int64_t cpu_dst[n];
+
+  // Setup kernel and buffers
+  OCL_CREATE_KERNEL("compiler_gen_ir_opt");
+  OCL_CREATE_BUFFER(buf[0], 0, n * sizeof(int64_t), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, 2 * n * sizeof(int), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(2, sizeof(int), &loop);
+  globals[0] = n;
+  locals[0] = 16;
+
+  OCL_MAP_BUFFER(1);
+  for (size_t i = 0; i < 2*n; ++i)
+    cpu_src[i] = ((int*)buf_data[1])[i] = (rand() & 0xffff) - 0x8000;
+  OCL_UNMAP_BUFFER(1);
+
+  // Run the kernel on GPU
+  OCL_NDRANGE(1);
+
+  // Compare
+  for (size_t i = 0; i < n; ++i)
+    cpu(i, cpu_src, loop, cpu_dst);
+  OCL_MAP_BUFFER(0);
+  for (size_t i = 0; i < n; ++i)
+    OCL_ASSERT(((int64_t*)buf_data[0])[i] == cpu_dst[i]);
+  OCL_UNMAP_BUFFER(0);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_gen_ir_opt);
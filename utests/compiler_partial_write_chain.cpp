@@ -0,0 +1,88 @@
+#include "utest_helper.hpp"
+
+/* Chains of writes to disjoint parts of one register. With
+ * OCL_DEPENDENCY_CONTROL=1 they get the NoDDClr/NoDDChk hints, run the tests
+ * with the variable set to 0 and to 1 and both must match the host */
+
+static const size_t chain_n = 1024;
+
+static void compiler_partial_write_chain_pack(void)
+{
+  OCL_CREATE_KERNEL_FROM_FILE("compiler_partial_write_chain", "compiler_partial_write_chain_pack");
+  OCL_CREATE_BUFFER(buf[0], 0, 2 * chain_n * sizeof(uint32_t), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, chain_n * sizeof(uint32_t), NULL);
+  OCL_MAP_BUFFER(1);
+  for (size_t i = 0; i < chain_n; ++i)
+    ((uint32_t *)buf_data[1])[i] = rand();
+  OCL_UNMAP_BUFFER(1);
+
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  globals[0] = chain_n;
+  locals[0] = 16;
+  OCL_NDRANGE(1);
+
+  OCL_MAP_BUFFER(0);
+  OCL_MAP_BUFFER(1);
+  for (size_t i = 0; i < chain_n; ++i) {
+    const uint32_t x = ((uint32_t *)buf_data[1])[i];
+    const uint32_t b = (uint8_t)(x >> 3) | (uint8_t)(x * 7) << 8 |
+                       (uint8_t)((uint8_t)(x >> 17) ^ 0x5a) << 16 | (uint32_t)(uint8_t)(x + 11) << 24;
+    const uint32_t h = (uint16_t)(x >> 9) | (uint32_t)(uint16_t)(x * 3) << 16;
+    OCL_ASSERT(((uint32_t *)buf_data[0])[2 * i] == b);
+    OCL_ASSERT(((uint32_t *)buf_data[0])[2 * i + 1] == h);
+  }
+  OCL_UNMAP_BUFFER(0);
+  OCL_UNMAP_BUFFER(1);
+}
+MAKE_UTEST_FROM_FUNCTION(compiler_partial_write_chain_pack);
+
+static void compiler_partial_write_chain_strided(void)
+{
+  OCL_CREATE_KERNEL_FROM_FILE("compiler_partial_write_chain", "compiler_partial_write_chain_strided");
+  OCL_CREATE_BUFFER(buf[0], 0, chain_n * 16, NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, chain_n * 16, NULL);
+  OCL_MAP_BUFFER(1);
+  for (size_t i = 0; i < chain_n * 16; ++i)
+    ((uint8_t *)buf_data[1])[i] = rand();
+  OCL_UNMAP_BUFFER(1);
+
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  globals[0] = chain_n;
+  locals[0] = 16;
+  OCL_NDRANGE(1);
+
+  OCL_MAP_BUFFER(0);
+  OCL_MAP_BUFFER(1);
+  const uint8_t *src = (const uint8_t *)buf_data[1], *dst = (const uint8_t *)buf_data[0];
+  for (size_t i = 0; i < chain_n * 16; i += 2) {
+    OCL_ASSERT(dst[i] == (uint8_t)(src[i + 1] + 1));
+    OCL_ASSERT(dst[i + 1] == (uint8_t)(src[i] ^ 0xff));
+  }
+  OCL_UNMAP_BUFFER(0);
+  OCL_UNMAP_BUFFER(1);
+}
+MAKE_UTEST_FROM_FUNCTION(compiler_partial_write_chain_strided);
+
+static void compiler_partial_write_chain_uniform(void)
+{
+  const uint32_t k = 0x1234567;
+
+  OCL_CREATE_KERNEL_FROM_FILE("compiler_partial_write_chain", "compiler_partial_write_chain_uniform");
+  OCL_CREATE_BUFFER(buf[0], 0, chain_n * sizeof(uint32_t), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(uint32_t), &k);
+  globals[0] = chain_n;
+  locals[0] = 32;
+  OCL_NDRANGE(1);
+
+  OCL_MAP_BUFFER(0);
+  for (uint32_t i = 0; i < chain_n; ++i) {
+    const uint32_t g = i / 32, l = i % 32;
+    const uint32_t r = (g * 3 + k) * l + (g ^ k) + ((g + 5) << 4) + k * 7 * (l & 3);
+    OCL_ASSERT(((uint32_t *)buf_data[0])[i] == r);
+  }
+  OCL_UNMAP_BUFFER(0);
+}
+MAKE_UTEST_FROM_FUNCTION(compiler_partial_write_chain_uniform);
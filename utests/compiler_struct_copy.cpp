@@ -0,0 +1,67 @@
+#include "utest_helper.hpp"
+
+struct big_t { cl_float4 v; int i[5]; char c[3]; };
+struct odd_t { char c[13]; };
+
+void compiler_struct_copy(void)
+{
+  const size_t n = 64;
+
+  // Setup kernel and buffers
+  OCL_CREATE_KERNEL("compiler_struct_copy");
+  OCL_CREATE_BUFFER(buf[0], 0, n * sizeof(big_t), NULL);
+  OCL_CREATE_BUFFER(buf[1], 0, n * sizeof(big_t), NULL);
+  OCL_CREATE_BUFFER(buf[2], 0, n * sizeof(odd_t), NULL);
+  OCL_CREATE_BUFFER(buf[3], 0, n * sizeof(odd_t), NULL);
+  OCL_CREATE_BUFFER(buf[4], 0, n * sizeof(int), NULL);
+  OCL_SET_ARG(0, sizeof(cl_mem), &buf[0]);
+  OCL_SET_ARG(1, sizeof(cl_mem), &buf[1]);
+  OCL_SET_ARG(2, sizeof(cl_mem), &buf[2]);
+  OCL_SET_ARG(3, sizeof(cl_mem), &buf[3]);
+  OCL_SET_ARG(4, sizeof(cl_mem), &buf[4]);
+
+  OCL_MAP_BUFFER(1);
+  OCL_MAP_BUFFER(3);
+  for (uint32_t i = 0; i < n; ++i) {
+    big_t *b = (big_t *)buf_data[1] + i;
+    odd_t *o = (odd_t *)buf_data[3] + i;
+    for (int j = 0; j < 4; ++j)
+      b->v.s[j] = i * 4 + j;
+    for (int j = 0; j < 5; ++j)
+      b->i[j] = i * 5 + j;
+    for (int j = 0; j < 3; ++j)
+      b->c[j] = i + j;
+    for (int j = 0; j < 13; ++j)
+      o->c[j] = i + j + 1;
+  }
+  OCL_UNMAP_BUFFER(1);
+  OCL_UNMAP_BUFFER(3);
+
+  // Run the kernel
+  globals[0] = n;
+  locals[0] = 16;
+  OCL_NDRANGE(1);
+
+  // Check results
+  OCL_MAP_BUFFER(0);
+  OCL_MAP_BUFFER(2);
+  OCL_MAP_BUFFER(4);
+  for (uint32_t i = 0; i < n; ++i) {
+    big_t *b = (big_t *)buf_data[0] + i;
+    odd_t *o = (odd_t *)buf_data[2] + i;
+    for (int j = 0; j < 4; ++j)
+      OCL_ASSERT(b->v.s[j] == i * 4 + j);
+    for (int j = 0; j < 5; ++j)
+      OCL_ASSERT(b->i[j] == (int)(i * 5 + j) + (j == (int)(i % 5)));
+    for (int j = 0; j < 3; ++j)
+      OCL_ASSERT(b->c[j] == (char)(i + j));
+    for (int j = 0; j < 13; ++j)
+      OCL_ASSERT(o->c[j] == (j == (int)(i % 13) ? 0 : (char)(i + j + 1)));
+    OCL_ASSERT(((int *)buf_data[4])[i] == (int)i);
+  }
+  OCL_UNMAP_BUFFER(0);
+  OCL_UNMAP_BUFFER(2);
+  OCL_UNMAP_BUFFER(4);
+}
+
+MAKE_UTEST_FROM_FUNCTION(compiler_struct_copy);
@@ -0,0 +1,98 @@
+#include "utest_helper.hpp"
+#include <string.h>
+
+/* Copies and fills up to OCL_HOST_COPY_THRESHOLD bytes of idle buffers are
+ * done by the CPU. Check them on buffers and sub buffers, at unaligned
+ * offsets and with every pattern size */
+
+static const size_t host_op_sz = 4096;
+static char host_op_src[4096], host_op_dst[4096], host_op_res[4096];
+
+static cl_mem host_op_sub_buffer(cl_mem buffer, size_t origin)
+{
+  cl_buffer_region region = { origin, host_op_sz / 2 };
+  cl_int err;
+  cl_mem sub = clCreateSubBuffer(buffer, 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  return sub;
+}
+
+static void host_op_reset(cl_mem dst)
+{
+  for (size_t i = 0; i < host_op_sz; ++i)
+    host_op_dst[i] = (char)(i * 7);
+  OCL_CALL (clEnqueueWriteBuffer, queue, dst, CL_TRUE, 0, host_op_sz, host_op_dst, 0, NULL, NULL);
+}
+
+static void host_op_check(cl_mem dst)
+{
+  OCL_CALL (clEnqueueReadBuffer, queue, dst, CL_TRUE, 0, host_op_sz, host_op_res, 0, NULL, NULL);
+  for (size_t i = 0; i < host_op_sz; ++i)
+    OCL_ASSERT(host_op_res[i] == host_op_dst[i]);
+}
+
+void runtime_host_copy_fill(void)
+{
+  static const size_t pattern_sizes[] = {1, 2, 4, 8, 16, 32, 64, 128};
+  static const size_t copy_sizes[] = {1, 3, 16, 100, 1000};
+  static const size_t copy_offsets[] = {0, 1, 5, 64};
+  char pattern[128];
+  cl_uint align_bits;
+
+  OCL_CALL (clGetDeviceInfo, device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, NULL);
+  const size_t align = align_bits / 8;
+
+  for (size_t i = 0; i < host_op_sz; ++i)
+    host_op_src[i] = (char)rand();
+  OCL_CREATE_BUFFER(buf[0], CL_MEM_COPY_HOST_PTR, host_op_sz, host_op_src);
+  OCL_CREATE_BUFFER(buf[1], 0, host_op_sz, NULL);
+  cl_mem sub_src = host_op_sub_buffer(buf[0], align);
+  cl_mem sub_dst = host_op_sub_buffer(buf[1], 2 * align);
+
+  /* Copies between buffers and sub buffers */
+  const struct { cl_mem src, dst; size_t src_origin, dst_origin; } pairs[] = {
+    { buf[0], buf[1], 0, 0 },
+    { sub_src, buf[1], align, 0 },
+    { buf[0], sub_dst, 0, 2 * align },
+    { sub_src, sub_dst, align, 2 * align },
+  };
+  for (size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); ++p)
+    for (size_t s = 0; s < sizeof(copy_sizes) / sizeof(copy_sizes[0]); ++s)
+      for (size_t o = 0; o < sizeof(copy_offsets) / sizeof(copy_offsets[0]); ++o) {
+        const size_t src_off = copy_offsets[o], dst_off = copy_offsets[(o + 1) % 4];
+        const size_t size = copy_sizes[s];
+
+        host_op_reset(buf[1]);
+        OCL_CALL (clEnqueueCopyBuffer, queue, pairs[p].src, pairs[p].dst,
+                  src_off, dst_off, size, 0, NULL, NULL);
+        memcpy(host_op_dst + pairs[p].dst_origin + dst_off,
+               host_op_src + pairs[p].src_origin + src_off, size);
+        host_op_check(buf[1]);
+      }
+
+  /* Fills of buffers and sub buffers with every pattern size */
+  const struct { cl_mem dst; size_t origin; } fills[] = {
+    { buf[1], 0 },
+    { sub_dst, 2 * align },
+  };
+  for (size_t f = 0; f < sizeof(fills) / sizeof(fills[0]); ++f)
+    for (size_t p = 0; p < sizeof(pattern_sizes) / sizeof(pattern_sizes[0]); ++p)
+      for (size_t k = 0; k < 3; ++k) {
+        const size_t pattern_sz = pattern_sizes[p];
+        const size_t offset = k * pattern_sz, size = (1 + 2 * k) * pattern_sz;
+
+        for (size_t i = 0; i < pattern_sz; ++i)
+          pattern[i] = (char)rand();
+        host_op_reset(buf[1]);
+        OCL_CALL (clEnqueueFillBuffer, queue, fills[f].dst, pattern, pattern_sz,
+                  offset, size, 0, NULL, NULL);
+        for (size_t i = 0; i < size; ++i)
+          host_op_dst[fills[f].origin + offset + i] = pattern[i % pattern_sz];
+        host_op_check(buf[1]);
+      }
+
+  clReleaseMemObject(sub_src);
+  clReleaseMemObject(sub_dst);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_host_copy_fill);
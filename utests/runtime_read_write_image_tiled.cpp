@@ -0,0 +1,139 @@
+#include <string.h>
+#include <stdlib.h>
+#include "utest_helper.hpp"
+#include "utest_file_map.hpp"
+
+/* clEnqueueReadImage and clEnqueueWriteImage on X and Y tiled images, with
+ * regions crossing the tile borders. The tiling and the CPU tiling are context
+ * options, so each case gets its own context. OCL_CPU_TILING=0 is the GTT path
+ * bit 6 swizzled bos always take. A kernel reads the image back so that the
+ * layout written by the CPU is checked against the sampler's. */
+
+static void set_env(const char *name, const char *value, char **saved)
+{
+  const char *old = getenv(name);
+  *saved = old ? strdup(old) : NULL;
+  setenv(name, value, 1);
+}
+
+static void restore_env(const char *name, char *saved)
+{
+  if (saved)
+    setenv(name, saved, 1);
+  else
+    unsetenv(name);
+  free(saved);
+}
+
+static void fill_random(uint8_t *p, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    p[i] = rand();
+}
+
+static void read_write_image_tiled(const char *tiling, const char *cpu_tiling,
+                                   cl_channel_order order, cl_channel_type type, size_t bpp)
+{
+  const size_t w = 300, h = 130;
+  const size_t wr_origin[3] = {37, 11, 0}, wr_region[3] = {201, 77, 1};
+  const size_t rd_origin[3] = {5, 29, 0}, rd_region[3] = {250, 61, 1};
+  const size_t wr_pitch = wr_region[0] * bpp + 12, rd_pitch = rd_region[0] * bpp + 20;
+  const size_t zero[3] = {0, 0, 0}, full[3] = {w, h, 1};
+  uint8_t *mirror = (uint8_t *)malloc(w * h * bpp);
+  uint8_t *sub = (uint8_t *)malloc(wr_pitch * wr_region[1]);
+  uint8_t *out = (uint8_t *)malloc(rd_pitch * rd_region[1]);
+  char *saved_tiling, *saved_cpu_tiling;
+  cl_image_format format;
+  cl_image_desc desc;
+  cl_context c;
+  cl_command_queue q;
+  cl_mem image;
+  cl_int status;
+
+  set_env("OCL_TILING", tiling, &saved_tiling);
+  set_env("OCL_CPU_TILING", cpu_tiling, &saved_cpu_tiling);
+  c = clCreateContext(NULL, 1, &device, NULL, NULL, &status);
+  restore_env("OCL_TILING", saved_tiling);
+  restore_env("OCL_CPU_TILING", saved_cpu_tiling);
+  OCL_ASSERT(status == CL_SUCCESS);
+  q = clCreateCommandQueue(c, device, 0, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  memset(&format, 0, sizeof(format));
+  memset(&desc, 0, sizeof(desc));
+  format.image_channel_order = order;
+  format.image_channel_data_type = type;
+  desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+  desc.image_width = w;
+  desc.image_height = h;
+  image = clCreateImage(c, CL_MEM_READ_WRITE, &format, &desc, NULL, &status);
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  /* Whole image, then a region not aligned on any tile border */
+  fill_random(mirror, w * h * bpp);
+  OCL_CALL (clEnqueueWriteImage, q, image, CL_TRUE, zero, full, 0, 0, mirror, 0, NULL, NULL);
+  fill_random(sub, wr_pitch * wr_region[1]);
+  OCL_CALL (clEnqueueWriteImage, q, image, CL_TRUE, wr_origin, wr_region, wr_pitch, 0, sub, 0, NULL, NULL);
+  for (size_t y = 0; y < wr_region[1]; y++)
+    memcpy(mirror + ((wr_origin[1] + y) * w + wr_origin[0]) * bpp, sub + y * wr_pitch, wr_region[0] * bpp);
+
+  OCL_CALL (clEnqueueReadImage, q, image, CL_TRUE, rd_origin, rd_region, rd_pitch, 0, out, 0, NULL, NULL);
+  for (size_t y = 0; y < rd_region[1]; y++)
+    OCL_ASSERT(memcmp(out + y * rd_pitch, mirror + ((rd_origin[1] + y) * w + rd_origin[0]) * bpp,
+                      rd_region[0] * bpp) == 0);
+
+  /* The GPU sees the same texels */
+  if (bpp == 4) {
+    char *ker_path = cl_do_kiss_path("runtime_read_write_image_tiled.cl", device);
+    cl_file_map_t *fm = cl_file_map_new();
+    OCL_ASSERT(cl_file_map_open(fm, ker_path) == CL_FILE_MAP_SUCCESS);
+    const char *src = cl_file_map_begin(fm);
+    cl_program p = clCreateProgramWithSource(c, 1, &src, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    free(ker_path);
+    cl_file_map_delete(fm);
+    OCL_CALL (clBuildProgram, p, 1, &device, NULL, NULL, NULL);
+    cl_kernel k = clCreateKernel(p, "runtime_read_write_image_tiled", &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    cl_mem dst = clCreateBuffer(c, CL_MEM_READ_WRITE, w * h * 4, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    int iw = w;
+    size_t gws[2] = {w, h};
+
+    OCL_CALL (clSetKernelArg, k, 0, sizeof(cl_mem), &image);
+    OCL_CALL (clSetKernelArg, k, 1, sizeof(cl_mem), &dst);
+    OCL_CALL (clSetKernelArg, k, 2, sizeof(int), &iw);
+    OCL_CALL (clEnqueueNDRangeKernel, q, k, 2, NULL, gws, NULL, 0, NULL, NULL);
+    uint32_t *texels = (uint32_t *)clEnqueueMapBuffer(q, dst, CL_TRUE, CL_MAP_READ, 0, w * h * 4,
+                                                      0, NULL, NULL, &status);
+    OCL_ASSERT(status == CL_SUCCESS);
+    OCL_ASSERT(memcmp(texels, mirror, w * h * 4) == 0);
+    OCL_CALL (clEnqueueUnmapMemObject, q, dst, texels, 0, NULL, NULL);
+    OCL_CALL (clFinish, q);
+    clReleaseMemObject(dst);
+    clReleaseKernel(k);
+    clReleaseProgram(p);
+  }
+
+  clReleaseMemObject(image);
+  clReleaseCommandQueue(q);
+  clReleaseContext(c);
+  free(mirror);
+  free(sub);
+  free(out);
+}
+
+static void runtime_read_write_image_tiled(void)
+{
+  const char *tilings[] = {"1", "2"};
+  const char *cpu_tilings[] = {"1", "0"};
+
+  for (int t = 0; t < 2; t++)
+    for (int c = 0; c < 2; c++) {
+      read_write_image_tiled(tilings[t], cpu_tilings[c], CL_R, CL_UNSIGNED_INT8, 1);
+      read_write_image_tiled(tilings[t], cpu_tilings[c], CL_RGBA, CL_UNSIGNED_INT8, 4);
+      read_write_image_tiled(tilings[t], cpu_tilings[c], CL_RGBA, CL_UNSIGNED_INT32, 16);
+    }
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_read_write_image_tiled);
@@ -0,0 +1,83 @@
+#include "utest_helper.hpp"
+#include "utest_file_map.hpp"
+#include <stdlib.h>
+
+/* Many small buffers, carved out of shared slabs when OCL_SLAB_ALLOC=1.
+ * Each one must keep its own data through kernels, reads and maps */
+
+static cl_kernel small_buffers_kernel(cl_context c)
+{
+  cl_int err;
+  char *ker_path = cl_do_kiss_path("test_copy_buffer.cl", device);
+  cl_file_map_t *fm = cl_file_map_new();
+  OCL_ASSERT(cl_file_map_open(fm, ker_path) == CL_FILE_MAP_SUCCESS);
+  const char *src = cl_file_map_begin(fm);
+
+  cl_program program = clCreateProgramWithSource(c, 1, &src, NULL, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  OCL_CALL (clBuildProgram, program, 1, &device, NULL, NULL, NULL);
+  cl_kernel kernel = clCreateKernel(program, "test_copy_buffer", &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  clReleaseProgram(program);
+  free(ker_path);
+  cl_file_map_delete(fm);
+  return kernel;
+}
+
+static void runtime_small_buffers(void)
+{
+  const int buf_n = 128;
+  cl_mem src[buf_n], dst[buf_n];
+  float data[1024];
+  cl_int err;
+
+  /* The slabs of a context are enabled when its first buffer is created */
+  setenv("OCL_SLAB_ALLOC", "1", 1);
+  cl_context c = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  cl_command_queue q = clCreateCommandQueue(c, device, 0, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  cl_kernel kernel = small_buffers_kernel(c);
+
+  for (int i = 0; i < buf_n; ++i) {
+    const size_t n = 4 + (i * 37) % 1000;
+    for (size_t j = 0; j < n; ++j)
+      data[j] = i * 1000 + j;
+    src[i] = clCreateBuffer(c, CL_MEM_COPY_HOST_PTR, n * sizeof(float), data, NULL);
+    dst[i] = clCreateBuffer(c, 0, n * sizeof(float), NULL, NULL);
+    OCL_ASSERT(src[i] != NULL && dst[i] != NULL);
+  }
+
+  for (int i = 0; i < buf_n; ++i) {
+    size_t global = 4 + (i * 37) % 1000, local = 1;
+    OCL_CALL (clSetKernelArg, kernel, 0, sizeof(cl_mem), &src[i]);
+    OCL_CALL (clSetKernelArg, kernel, 1, sizeof(cl_mem), &dst[i]);
+    OCL_CALL (clEnqueueNDRangeKernel, q, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+  }
+
+  for (int i = 0; i < buf_n; ++i) {
+    const size_t n = 4 + (i * 37) % 1000;
+    OCL_CALL(clEnqueueReadBuffer, q, dst[i], CL_TRUE, 0, n * sizeof(float), data, 0, NULL, NULL);
+    for (size_t j = 0; j < n; ++j)
+      OCL_ASSERT(data[j] == i * 1000 + j);
+
+    float *p = (float *)clEnqueueMapBuffer(q, src[i], CL_TRUE, CL_MAP_READ, 0,
+                                           n * sizeof(float), 0, NULL, NULL, NULL);
+    OCL_ASSERT(p != NULL);
+    for (size_t j = 0; j < n; ++j)
+      OCL_ASSERT(p[j] == i * 1000 + j);
+    OCL_CALL(clEnqueueUnmapMemObject, q, src[i], p, 0, NULL, NULL);
+  }
+  OCL_CALL (clFinish, q);
+
+  for (int i = 0; i < buf_n; ++i) {
+    clReleaseMemObject(src[i]);
+    clReleaseMemObject(dst[i]);
+  }
+  clReleaseKernel(kernel);
+  clReleaseCommandQueue(q);
+  clReleaseContext(c);
+  unsetenv("OCL_SLAB_ALLOC");
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_small_buffers);
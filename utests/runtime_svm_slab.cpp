@@ -0,0 +1,122 @@
+#include "utest_helper.hpp"
+#include "utest_file_map.hpp"
+#include <stdlib.h>
+
+/* Small SVM allocations, carved out of 2MB soft-pinned arenas when
+ * OCL_SVM_SLAB_ALLOC=1. Each one must keep its own data through kernels, and
+ * the arenas must be released and created again as they empty and fill */
+
+static cl_kernel svm_slab_kernel(cl_context c)
+{
+  cl_int err;
+  char *ker_path = cl_do_kiss_path("runtime_svm_slab.cl", device);
+  cl_file_map_t *fm = cl_file_map_new();
+  OCL_ASSERT(cl_file_map_open(fm, ker_path) == CL_FILE_MAP_SUCCESS);
+  const char *src = cl_file_map_begin(fm);
+
+  cl_program program = clCreateProgramWithSource(c, 1, &src, NULL, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  OCL_CALL (clBuildProgram, program, 1, &device, "-cl-std=CL2.0", NULL, NULL);
+  cl_kernel kernel = clCreateKernel(program, "runtime_svm_slab", &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  clReleaseProgram(program);
+  free(ker_path);
+  cl_file_map_delete(fm);
+  return kernel;
+}
+
+/* Fill, add the index on the GPU through the SVM pointer and check */
+static void svm_slab_check(cl_command_queue q, cl_kernel kernel, int *p, int n, int seed)
+{
+  size_t global = ((n + 15) / 16) * 16, local = 16;
+
+  OCL_CALL (clEnqueueSVMMap, q, CL_TRUE, CL_MAP_WRITE, p, n * sizeof(int), 0, NULL, NULL);
+  for (int j = 0; j < n; ++j)
+    p[j] = seed + j;
+  OCL_CALL (clEnqueueSVMUnmap, q, p, 0, NULL, NULL);
+
+  OCL_CALL (clSetKernelArgSVMPointer, kernel, 0, p);
+  OCL_CALL (clSetKernelArg, kernel, 1, sizeof(int), &n);
+  OCL_CALL (clEnqueueNDRangeKernel, q, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+  OCL_CALL (clFinish, q);
+
+  OCL_CALL (clEnqueueSVMMap, q, CL_TRUE, CL_MAP_READ, p, n * sizeof(int), 0, NULL, NULL);
+  for (int j = 0; j < n; ++j)
+    OCL_ASSERT(p[j] == seed + 2 * j);
+  OCL_CALL (clEnqueueSVMUnmap, q, p, 0, NULL, NULL);
+}
+
+static void runtime_svm_slab(void)
+{
+  if (!cl_check_ocl20(false))
+    return;
+
+  const int alloc_n = 512;
+  const int arena_n = 40;           /* 64KB slots, more than one 2MB arena */
+  int *ptrs[alloc_n];
+  cl_int err;
+
+  setenv("OCL_SVM_SLAB_ALLOC", "1", 1);
+  cl_context c = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  cl_command_queue q = clCreateCommandQueue(c, device, 0, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  cl_kernel kernel = svm_slab_kernel(c);
+
+  /* Two tiny allocations are neighbour slots of the same arena */
+  char *a = (char *)clSVMAlloc(c, CL_MEM_READ_WRITE, 4, 0);
+  char *b = (char *)clSVMAlloc(c, CL_MEM_READ_WRITE, 4, 0);
+  OCL_ASSERT(a != NULL && b == a + 128);
+  clSVMFree(c, a);
+  clSVMFree(c, b);
+
+  /* Many small allocations of several classes */
+  for (int i = 0; i < alloc_n; ++i) {
+    const int n = 1 + (i * 37) % 1000;
+    ptrs[i] = (int *)clSVMAlloc(c, CL_MEM_READ_WRITE, n * sizeof(int), 0);
+    OCL_ASSERT(ptrs[i] != NULL);
+  }
+  for (int i = 0; i < alloc_n; ++i)
+    svm_slab_check(q, kernel, ptrs[i], 1 + (i * 37) % 1000, i * 1000);
+
+  /* Free every other one, take the slots again and check the others kept
+   * their data */
+  for (int i = 0; i < alloc_n; i += 2)
+    clSVMFree(c, ptrs[i]);
+  for (int i = 0; i < alloc_n; i += 2) {
+    const int n = 1 + (i * 37) % 1000;
+    ptrs[i] = (int *)clSVMAlloc(c, CL_MEM_READ_WRITE, n * sizeof(int), 0);
+    OCL_ASSERT(ptrs[i] != NULL);
+    svm_slab_check(q, kernel, ptrs[i], n, i * 2000);
+  }
+  for (int i = 1; i < alloc_n; i += 2) {
+    const int n = 1 + (i * 37) % 1000;
+    OCL_CALL (clEnqueueSVMMap, q, CL_TRUE, CL_MAP_READ, ptrs[i], n * sizeof(int), 0, NULL, NULL);
+    for (int j = 0; j < n; ++j)
+      OCL_ASSERT(ptrs[i][j] == i * 1000 + 2 * j);
+    OCL_CALL (clEnqueueSVMUnmap, q, ptrs[i], 0, NULL, NULL);
+  }
+  for (int i = 0; i < alloc_n; ++i)
+    clSVMFree(c, ptrs[i]);
+
+  /* Fill two arenas of the largest class and empty them, which releases the
+   * arena that is not allocated from. Then fill them again */
+  for (int round = 0; round < 2; ++round) {
+    for (int i = 0; i < arena_n; ++i) {
+      ptrs[i] = (int *)clSVMAlloc(c, CL_MEM_READ_WRITE, 64 * 1024, 0);
+      OCL_ASSERT(ptrs[i] != NULL);
+      OCL_ASSERT(((uintptr_t)ptrs[i] & (64 * 1024 - 1)) == 0);
+    }
+    for (int i = 0; i < arena_n; ++i)
+      svm_slab_check(q, kernel, ptrs[i], 16 * 1024, round * 100000 + i);
+    for (int i = arena_n - 1; i >= 0; --i)
+      clSVMFree(c, ptrs[i]);
+  }
+
+  clReleaseKernel(kernel);
+  clReleaseCommandQueue(q);
+  clReleaseContext(c);
+  unsetenv("OCL_SVM_SLAB_ALLOC");
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_svm_slab);
@@ -0,0 +1,123 @@
+#include "utest_helper.hpp"
+#include <stdlib.h>
+#include <string.h>
+
+/* Force each of the tuned buffer copy and fill kernels with OCL_COPY_KERNEL
+ * and OCL_FILL_KERNEL, index -1 being the default table, and check the
+ * bytes across sizes and alignments. Transfers the kernel does not fit go to
+ * the fixed kernels and must be right as well */
+
+#define TUNED_COPY_KERNEL_N 10
+#define TUNED_FILL_KERNEL_N 6
+
+static const size_t tuned_sizes[] = {4160, 65600, 300032, 1048576 + 64};
+static const size_t tuned_aligns[] = {1, 4, 16, 32, 64};
+static const size_t tuned_buf_sz = 1048576 + 64 + 4 * 64;
+
+static void tuned_open(const char *env, int index, cl_context *c, cl_command_queue *q)
+{
+  char value[16];
+  cl_int err;
+
+  sprintf(value, "%d", index);
+  setenv(env, value, 1);
+  *c = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  *q = clCreateCommandQueue(*c, device, 0, &err);
+  OCL_ASSERT(err == CL_SUCCESS);
+  unsetenv(env);
+}
+
+static void tuned_close(cl_context c, cl_command_queue q, cl_mem *mems, int mem_n)
+{
+  for (int i = 0; i < mem_n; ++i)
+    clReleaseMemObject(mems[i]);
+  clReleaseCommandQueue(q);
+  clReleaseContext(c);
+}
+
+static void runtime_tuned_copy(void)
+{
+  char *src = (char *)malloc(tuned_buf_sz);
+  char *dst = (char *)malloc(tuned_buf_sz);
+  char *res = (char *)malloc(tuned_buf_sz);
+  cl_context c;
+  cl_command_queue q;
+  cl_mem mems[2];
+  cl_int err;
+
+  for (size_t i = 0; i < tuned_buf_sz; ++i)
+    src[i] = (char)rand();
+
+  for (int k = -1; k < TUNED_COPY_KERNEL_N; ++k) {
+    tuned_open("OCL_COPY_KERNEL", k, &c, &q);
+    mems[0] = clCreateBuffer(c, CL_MEM_COPY_HOST_PTR, tuned_buf_sz, src, &err);
+    OCL_ASSERT(err == CL_SUCCESS);
+    mems[1] = clCreateBuffer(c, 0, tuned_buf_sz, NULL, &err);
+    OCL_ASSERT(err == CL_SUCCESS);
+
+    for (size_t s = 0; s < sizeof(tuned_sizes) / sizeof(tuned_sizes[0]); ++s)
+      for (size_t a = 0; a < sizeof(tuned_aligns) / sizeof(tuned_aligns[0]); ++a) {
+        const size_t align = tuned_aligns[a];
+        const size_t src_off = align, dst_off = 3 * align;
+        const size_t size = tuned_sizes[s] - (align == 1 ? 3 : 0);
+
+        memset(dst, 0, tuned_buf_sz);
+        OCL_CALL (clEnqueueWriteBuffer, q, mems[1], CL_TRUE, 0, tuned_buf_sz, dst, 0, NULL, NULL);
+        OCL_CALL (clEnqueueCopyBuffer, q, mems[0], mems[1], src_off, dst_off, size, 0, NULL, NULL);
+        OCL_CALL (clEnqueueReadBuffer, q, mems[1], CL_TRUE, 0, tuned_buf_sz, res, 0, NULL, NULL);
+        memcpy(dst + dst_off, src + src_off, size);
+        OCL_ASSERT(memcmp(res, dst, tuned_buf_sz) == 0);
+      }
+    tuned_close(c, q, mems, 2);
+  }
+
+  free(src);
+  free(dst);
+  free(res);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_tuned_copy);
+
+static void runtime_tuned_fill(void)
+{
+  static const size_t pattern_sizes[] = {1, 2, 4, 8, 16};
+  char *dst = (char *)malloc(tuned_buf_sz);
+  char *res = (char *)malloc(tuned_buf_sz);
+  char pattern[16];
+  cl_context c;
+  cl_command_queue q;
+  cl_mem mem;
+  cl_int err;
+
+  for (int k = -1; k < TUNED_FILL_KERNEL_N; ++k) {
+    tuned_open("OCL_FILL_KERNEL", k, &c, &q);
+    mem = clCreateBuffer(c, 0, tuned_buf_sz, NULL, &err);
+    OCL_ASSERT(err == CL_SUCCESS);
+
+    for (size_t p = 0; p < sizeof(pattern_sizes) / sizeof(pattern_sizes[0]); ++p)
+      for (size_t s = 0; s < sizeof(tuned_sizes) / sizeof(tuned_sizes[0]); ++s)
+        for (size_t a = 0; a < sizeof(tuned_aligns) / sizeof(tuned_aligns[0]); ++a) {
+          const size_t pattern_sz = pattern_sizes[p];
+          const size_t align = tuned_aligns[a] > pattern_sz ? tuned_aligns[a] : pattern_sz;
+          const size_t offset = align;
+          const size_t size = tuned_sizes[s] - (tuned_aligns[a] == 1 ? pattern_sz : 0);
+
+          for (size_t i = 0; i < pattern_sz; ++i)
+            pattern[i] = (char)rand();
+          memset(dst, 0, tuned_buf_sz);
+          OCL_CALL (clEnqueueWriteBuffer, q, mem, CL_TRUE, 0, tuned_buf_sz, dst, 0, NULL, NULL);
+          OCL_CALL (clEnqueueFillBuffer, q, mem, pattern, pattern_sz, offset, size, 0, NULL, NULL);
+          OCL_CALL (clEnqueueReadBuffer, q, mem, CL_TRUE, 0, tuned_buf_sz, res, 0, NULL, NULL);
+          for (size_t i = 0; i < size; ++i)
+            dst[offset + i] = pattern[i % pattern_sz];
+          OCL_ASSERT(memcmp(res, dst, tuned_buf_sz) == 0);
+        }
+    tuned_close(c, q, &mem, 1);
+  }
+
+  free(dst);
+  free(res);
+}
+
+MAKE_UTEST_FROM_FUNCTION(runtime_tuned_fill);
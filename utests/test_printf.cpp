@@ -1,4 +1,7 @@
 #include "utest_helper.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 void test_printf(void)
 {
@@ -70,3 +73,75 @@ void test_printf_4(void)
 }
 
 MAKE_UTEST_FROM_FUNCTION(test_printf_4);
+
+/* Run test_printf_overflow with stdout and stderr in temporary files, and
+ * return the number of lines printed and the bytes reported lost */
+static void run_printf_overflow(cl_command_queue q, size_t n, int *lines, unsigned *lost)
+{
+  FILE *out = tmpfile(), *err = tmpfile();
+  int saved_out, saved_err;
+  char line[256];
+
+  OCL_ASSERT(out && err);
+  fflush(stdout);
+  fflush(stderr);
+  saved_out = dup(fileno(stdout));
+  saved_err = dup(fileno(stderr));
+  dup2(fileno(out), fileno(stdout));
+  dup2(fileno(err), fileno(stderr));
+
+  globals[0] = n;
+  locals[0] = 16;
+  OCL_CALL (clEnqueueNDRangeKernel, q, kernel, 1, NULL, globals, locals, 0, NULL, NULL);
+  OCL_CALL (clFinish, q);
+
+  fflush(stdout);
+  fflush(stderr);
+  dup2(saved_out, fileno(stdout));
+  dup2(saved_err, fileno(stderr));
+  close(saved_out);
+  close(saved_err);
+
+  *lines = 0;
+  rewind(out);
+  while (fgets(line, sizeof(line), out))
+    (*lines)++;
+  *lost = 0;
+  rewind(err);
+  while (fgets(line, sizeof(line), err))
+    sscanf(line, "Beignet: printf buffer overflow, %u bytes", lost);
+  fclose(out);
+  fclose(err);
+}
+
+void test_printf_overflow(void)
+{
+  const size_t n = 1024;
+  cl_command_queue q;
+  cl_int status;
+  int lines;
+  unsigned lost;
+
+  OCL_CREATE_KERNEL_FROM_FILE("test_printf", "test_printf_overflow");
+
+  /* The queue reads the size when it is created, 4KB holds a quarter of the
+   * 16 byte logs */
+  setenv("OCL_PRINTF_BUFFER_SIZE", "4096", 1);
+  q = clCreateCommandQueue(ctx, device, 0, &status);
+  unsetenv("OCL_PRINTF_BUFFER_SIZE");
+  OCL_ASSERT(status == CL_SUCCESS);
+
+  /* The logs not printed are the bytes reported lost */
+  run_printf_overflow(q, n, &lines, &lost);
+  OCL_ASSERT(lines > 0 && (size_t)lines < n);
+  OCL_ASSERT(lost > 0 && lost % (n - lines) == 0);
+
+  /* The next launch gets a buffer large enough for everything */
+  run_printf_overflow(q, n, &lines, &lost);
+  OCL_ASSERT((size_t)lines == n);
+  OCL_ASSERT(lost == 0);
+
+  clReleaseCommandQueue(q);
+}
+
+MAKE_UTEST_FROM_FUNCTION(test_printf_overflow);